@@ -0,0 +1,256 @@
+/*
+    AutoTune.h
+
+    Render settings that change speed but never the image: rows per band
+    handed to a render thread, the size of a TilePool task and the number of
+    TilePool threads. The best values depend on the machine, so on a new
+    machine or plugin version a background job started at GlobalSetup times a
+    few candidates and saves the fastest to a small file in the user's
+    preferences folder. Later sessions read it back at GlobalSetup, and
+    time the candidates again once the saved tuning is TUNING_LIFETIME old.
+
+    Auto tuning is on unless the file holds the line "autotune|off". The
+    file is then only read, so a tuning written there by hand stays.
+*/
+
+#pragma once
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef AE_OS_WIN
+    #include <intrin.h>
+#elif defined(__APPLE__)
+    #include <sys/sysctl.h>
+#endif
+
+struct RenderTuning {
+    int bandRows;           // rows per band handed to a render thread
+    int poolTileSpan;       // render tiles along each side of a TilePool task
+    int poolThreads;        // TilePool concurrency, the calling thread included
+
+    bool operator==(const RenderTuning& o) const {
+        return bandRows == o.bandRows && poolTileSpan == o.poolTileSpan && poolThreads == o.poolThreads;
+    }
+};
+
+// Until a machine is calibrated: bands small enough that a frame splits into
+// several per thread so the edge rows do not land on one of them, single
+// tiles for pool tasks and a pool thread per core
+inline RenderTuning defaultTuning() {
+    RenderTuning tuning;
+    tuning.bandRows = 16;
+    tuning.poolTileSpan = 1;
+    tuning.poolThreads = (int)std::thread::hardware_concurrency();
+    if (tuning.poolThreads < 1) tuning.poolThreads = 1;
+    return tuning;
+}
+
+// Seconds a saved tuning serves before the machine is timed again, since
+// drivers, OS updates and background load change what is fastest
+#define TUNING_LIFETIME     (30.0 * 24 * 60 * 60)
+
+// CPU brand string and core count; a saved tuning only applies on a match
+inline std::string cpuModel() {
+    std::string model;
+#if defined(AE_OS_WIN) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4];
+    char brand[49] = { 0 };
+    __cpuid(regs, 0x80000000);
+    if ((unsigned)regs[0] >= 0x80000004u) {
+        for (int i = 0; i < 3; i++) {
+            __cpuid(regs, 0x80000002 + i);
+            memcpy(brand + i * 16, regs, 16);
+        }
+        model = brand;
+    }
+#elif defined(__APPLE__)
+    char brand[256] = { 0 };
+    size_t size = sizeof(brand) - 1;
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0) model = brand;
+#else
+    if (FILE* f = fopen("/proc/cpuinfo", "r")) {
+        char line[512];
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "model name", 10) == 0) {
+                const char* colon = strchr(line, ':');
+                if (colon) model = colon + 1;
+                break;
+            }
+        }
+        fclose(f);
+    }
+#endif
+    // Keep the key on one line and free of the field separator
+    std::string clean;
+    for (size_t i = 0; i < model.size(); i++) {
+        char c = model[i];
+        if (c == '|' || c == '\n' || c == '\r') continue;
+        if (c == ' ' && (clean.empty() || clean[clean.size() - 1] == ' ')) continue;
+        clean += c;
+    }
+    while (!clean.empty() && clean[clean.size() - 1] == ' ') clean.erase(clean.size() - 1);
+    if (clean.empty()) clean = "unknown";
+
+    char cores[32];
+    snprintf(cores, sizeof(cores), " x%u", std::thread::hardware_concurrency());
+    return clean + cores;
+}
+
+// One line per machine and version: "cpu|version|bandRows poolTileSpan poolThreads savedAt",
+// savedAt in seconds since the epoch. Lines for other machines are kept, so a
+// roaming profile serves them all.
+class TuningFile {
+public:
+    TuningFile(const std::string& cpu, const std::string& version) : cpu(cpu), version(version) {}
+
+    // The saved tuning for this machine and version. expired is set when it
+    // is older than TUNING_LIFETIME or carries no time.
+    bool read(RenderTuning& tuning, bool& expired) const {
+        std::string prefix = cpu + "|" + version + "|";
+        std::vector<std::string> lines = readLines();
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].compare(0, prefix.size(), prefix) != 0) continue;
+            RenderTuning t;
+            long long savedAt = 0;
+            int fields = sscanf(lines[i].c_str() + prefix.size(), "%d %d %d %lld",
+                &t.bandRows, &t.poolTileSpan, &t.poolThreads, &savedAt);
+            if (fields >= 3 && t.bandRows > 0 && t.poolTileSpan > 0 && t.poolThreads > 0) {
+                tuning = t;
+                double age = difftime(time(nullptr), (time_t)savedAt);
+                expired = fields < 4 || age < 0 || age > TUNING_LIFETIME;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // False when the user turned auto tuning off
+    bool autoTune() const {
+        std::vector<std::string> lines = readLines();
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i] == "autotune|off") return false;
+        }
+        return true;
+    }
+
+    void write(const RenderTuning& tuning) const {
+        std::string file = path();
+        if (file.empty()) return;
+
+        std::string prefix = cpu + "|" + version + "|";
+        std::vector<std::string> lines = readLines();
+        FILE* f = fopen(file.c_str(), "w");
+        if (!f) return;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].empty() || lines[i][0] == '#' || lines[i].compare(0, prefix.size(), prefix) == 0) continue;
+            fprintf(f, "%s\n", lines[i].c_str());
+        }
+        fprintf(f, "%s%d %d %d %lld\n", prefix.c_str(), tuning.bandRows, tuning.poolTileSpan, tuning.poolThreads,
+            (long long)time(nullptr));
+        fclose(f);
+    }
+
+private:
+    // The preferences folder itself, so there is no directory to create
+    static std::string path() {
+#ifdef AE_OS_WIN
+        const char* dir = getenv("APPDATA");
+        return dir ? std::string(dir) + "\\Torn Paper Tuning.txt" : std::string();
+#elif defined(__APPLE__)
+        const char* dir = getenv("HOME");
+        return dir ? std::string(dir) + "/Library/Preferences/Torn Paper Tuning.txt" : std::string();
+#else
+        const char* dir = getenv("HOME");
+        return dir ? std::string(dir) + "/.torn-paper-tuning" : std::string();
+#endif
+    }
+
+    std::vector<std::string> readLines() const {
+        std::vector<std::string> lines;
+        std::string file = path();
+        FILE* f = file.empty() ? nullptr : fopen(file.c_str(), "r");
+        if (!f) return lines;
+        char line[1024];
+        while (fgets(line, sizeof(line), f)) {
+            size_t n = strlen(line);
+            while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = 0;
+            lines.push_back(line);
+        }
+        fclose(f);
+        return lines;
+    }
+
+    std::string cpu, version;
+};
+
+// The tuning in effect. Renders read it with every job; a GlobalSetup that
+// finds no saved tuning, or an expired one, claims the calibration unless
+// auto tuning is off.
+class RenderTuner {
+public:
+    static RenderTuner& instance() {
+        static RenderTuner tuner;
+        return tuner;
+    }
+
+    int bandRows() const { return bands.load(std::memory_order_relaxed); }
+    int poolTileSpan() const { return span.load(std::memory_order_relaxed); }
+
+    void set(const RenderTuning& t) {
+        bands.store(t.bandRows, std::memory_order_relaxed);
+        span.store(t.poolTileSpan, std::memory_order_relaxed);
+    }
+
+    // Called at GlobalSetup. Returns the saved tuning when there is one, even
+    // an expired one, which serves until the calibration replaces it.
+    bool load(const std::string& version, RenderTuning& tuning) {
+        std::lock_guard<std::mutex> lock(mutex);
+        file.reset(new TuningFile(cpuModel(), version));
+        bool expired = true;
+        bool saved = file->read(tuning, expired);
+        claimed = (saved && !expired) || !file->autoTune();
+        return saved;
+    }
+
+    // True for exactly one caller while no current tuning is saved
+    bool claimCalibration() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (claimed || !file) return false;
+        claimed = true;
+        return true;
+    }
+
+    // Lets a later GlobalSetup calibrate after this one gave up
+    void releaseCalibration() {
+        std::lock_guard<std::mutex> lock(mutex);
+        claimed = false;
+    }
+
+    void save(const RenderTuning& tuning) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file) file->write(tuning);
+    }
+
+private:
+    RenderTuner() : claimed(false) { set(defaultTuning()); }
+
+    std::atomic<int> bands;
+    std::atomic<int> span;
+    std::mutex mutex;
+    std::unique_ptr<TuningFile> file;
+    bool claimed;
+};
+
+#endif // AUTOTUNE_H
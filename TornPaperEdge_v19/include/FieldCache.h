@@ -0,0 +1,383 @@
+/*
+    FieldCache.h
+
+    Cache for procedural fields that depend only on coordinates, seeds and
+    parameters, never on the input pixels. Fields are shared across frames and
+    effect instances; a field is found again by the key it was built with.
+*/
+
+#pragma once
+
+#ifndef FIELDCACHE_H
+#define FIELDCACHE_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Identifies a field: its kind followed by every value it was built from
+class FieldKey {
+public:
+    explicit FieldKey(int kind) { values.push_back((double)kind); }
+
+    FieldKey& add(double v) { values.push_back(v); return *this; }
+
+    bool operator==(const FieldKey& other) const {
+        return values.size() == other.values.size() &&
+            memcmp(values.data(), other.values.data(), values.size() * sizeof(double)) == 0;
+    }
+
+private:
+    std::vector<double> values;
+};
+
+// Where a cached field's bytes are counted, from insertion to eviction
+class FieldLedger {
+public:
+    virtual ~FieldLedger() {}
+
+    // Adds bytes, negative when freed; true when that passed the budget
+    virtual bool charge(ptrdiff_t bytes) = 0;
+
+    // Evicts fields until the total is back within the budget
+    virtual void trim() = 0;
+};
+
+// Anything the cache can hold. A field that allocates after insertion, as a
+// lazily filled plane does, charges the ledger as it goes, so the budget
+// holds for what the fields really use rather than their size at insertion.
+class CachedField {
+public:
+    CachedField() : ledger(nullptr) {}
+    virtual ~CachedField() {}
+    virtual size_t bytes() const = 0;
+
+    // Called by the cache as the field is inserted and evicted
+    void attach(FieldLedger* cache) {
+        std::lock_guard<std::mutex> lock(ledgerMutex);
+        ledger = cache;
+        ledger->charge((ptrdiff_t)bytes());
+    }
+
+    void detach() {
+        std::lock_guard<std::mutex> lock(ledgerMutex);
+        if (ledger) ledger->charge(-(ptrdiff_t)bytes());
+        ledger = nullptr;
+    }
+
+protected:
+    // Runs change, which moves bytes() by delta, and charges delta to the
+    // cache holding the field, trimming the cache if it is now over budget
+    template<typename Change>
+    void resize(ptrdiff_t delta, Change change) {
+        FieldLedger* over = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(ledgerMutex);
+            change();
+            if (ledger && ledger->charge(delta)) over = ledger;
+        }
+        if (over) over->trim();     // evicting takes this field's lock again
+    }
+
+private:
+    std::mutex ledgerMutex;
+    FieldLedger* ledger;
+};
+
+// Float plane split into tiles that are generated the first time they are read.
+// Tiles are published with a compare-and-swap, so concurrent readers may both
+// generate a tile but only one copy is kept.
+//
+// A variable-rate plane splits its field into a slowly varying part and the
+// rest. The smooth part is sampled on an 8, 4 or 2 pixel grid per tile and
+// interpolated, then handed to the detail generator at every pixel.
+//
+// A tile generator fills a whole tile at once, for fields that are cheaper to
+// build an area at a time than a pixel at a time.
+class FieldPlane : public CachedField {
+public:
+    typedef std::function<float(int x, int y)> Generator;
+    typedef std::function<float(int x, int y, float smooth)> DetailGenerator;
+    // Writes [x0, x1) x [y0, y1) of a zeroed tile whose rows are stride apart
+    typedef std::function<void(int x0, int y0, int x1, int y1, float* tile, int stride)> TileGenerator;
+
+    FieldPlane(int w, int h, Generator gen)
+        : width(w), height(h), generator(gen), tolerance(0), allocatedTiles(0)
+    {
+        init();
+    }
+
+    // tolerance is the largest interpolation error allowed in the smooth part
+    FieldPlane(int w, int h, Generator smooth, DetailGenerator detail, float tol)
+        : width(w), height(h), generator(smooth), detailGenerator(detail), tolerance(tol), allocatedTiles(0)
+    {
+        init();
+    }
+
+    FieldPlane(int w, int h, TileGenerator gen)
+        : width(w), height(h), tileGenerator(gen), tolerance(0), allocatedTiles(0)
+    {
+        init();
+    }
+
+    ~FieldPlane() {
+        for (int i = 0; i < tilesX * tilesY; i++) delete[] tiles[i].load();
+    }
+
+    float at(int x, int y) {
+        int tx = x / kTileSize;
+        int ty = y / kTileSize;
+        std::atomic<float*>& slot = tiles[ty * tilesX + tx];
+        float* tile = slot.load(std::memory_order_acquire);
+        if (!tile) tile = fillTile(slot, tx, ty);
+        return tile[(y - ty * kTileSize) * kTileSize + (x - tx * kTileSize)];
+    }
+
+    size_t bytes() const {
+        return allocatedTiles.load() * kTileBytes;
+    }
+
+    // Generates every missing tile in row ty of tileRows(), for filling a
+    // plane before any render reads it
+    int tileRows() const { return tilesY; }
+
+    void fillTileRow(int ty) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            std::atomic<float*>& slot = tiles[ty * tilesX + tx];
+            if (!slot.load(std::memory_order_acquire)) fillTile(slot, tx, ty);
+        }
+    }
+
+    // An empty plane with the same generators, for a render that wants tiles
+    // of its own it can free as it goes
+    std::shared_ptr<FieldPlane> blankCopy() const {
+        std::shared_ptr<FieldPlane> copy(new FieldPlane(width, height, generator, detailGenerator, tolerance));
+        copy->tileGenerator = tileGenerator;
+        return copy;
+    }
+
+    // Frees the tiles lying wholly above row y; they are generated again if
+    // read. Only for planes no other thread is reading, such as a blankCopy().
+    void releaseRowsAbove(int y) {
+        int tyEnd = y / kTileSize;
+        if (tyEnd > tilesY) tyEnd = tilesY;
+        for (int i = 0; i < tyEnd * tilesX; i++) {
+            float* tile = tiles[i].exchange(nullptr);
+            if (tile) {
+                delete[] tile;
+                resize(-(ptrdiff_t)kTileBytes, [&]() { allocatedTiles--; });
+            }
+        }
+    }
+
+private:
+    enum { kTileSize = 64 };
+    static const size_t kTileBytes = kTileSize * kTileSize * sizeof(float);
+
+    int width, height;
+    int tilesX, tilesY;
+    Generator generator;
+    DetailGenerator detailGenerator;
+    TileGenerator tileGenerator;
+    float tolerance;
+    std::unique_ptr<std::atomic<float*>[]> tiles;
+    std::atomic<size_t> allocatedTiles;
+
+    void init() {
+        tilesX = (width + kTileSize - 1) / kTileSize;
+        tilesY = (height + kTileSize - 1) / kTileSize;
+        tiles.reset(new std::atomic<float*>[(size_t)tilesX * tilesY]);
+        for (int i = 0; i < tilesX * tilesY; i++) tiles[i].store(nullptr);
+    }
+
+    float* fillTile(std::atomic<float*>& slot, int tx, int ty) {
+        float* tile = new float[kTileSize * kTileSize];
+        int x0 = tx * kTileSize;
+        int y0 = ty * kTileSize;
+        if (tileGenerator) {
+            memset(tile, 0, kTileSize * kTileSize * sizeof(float));
+            int x1 = x0 + kTileSize < width ? x0 + kTileSize : width;
+            int y1 = y0 + kTileSize < height ? y0 + kTileSize : height;
+            tileGenerator(x0, y0, x1, y1, tile, kTileSize);
+        } else if (detailGenerator) {
+            fillVariableRate(tile, x0, y0);
+        } else {
+            for (int j = 0; j < kTileSize; j++) {
+                int y = y0 + j;
+                for (int i = 0; i < kTileSize; i++) {
+                    int x = x0 + i;
+                    tile[j * kTileSize + i] = (x < width && y < height) ? generator(x, y) : 0.0f;
+                }
+            }
+        }
+
+        float* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, tile, std::memory_order_acq_rel)) {
+            resize((ptrdiff_t)kTileBytes, [&]() { allocatedTiles++; });
+            return tile;
+        }
+        delete[] tile;
+        return expected;
+    }
+
+    // Samples the smooth part on a step-spaced grid covering the tile
+    void sampleGrid(float* grid, int x0, int y0, int step) {
+        int n = kTileSize / step + 1;
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                grid[j * n + i] = generator(x0 + i * step, y0 + j * step);
+            }
+        }
+    }
+
+    // Bilinear error shrinks with the square of the grid step, so the error
+    // measured at the centres of the 8 pixel cells predicts the finer grids
+    void fillVariableRate(float* tile, int x0, int y0) {
+        enum { kMaxStep = 8, kMaxGrid = kTileSize + 1 };
+        float grid[kMaxGrid * kMaxGrid];
+
+        sampleGrid(grid, x0, y0, kMaxStep);
+        int n = kTileSize / kMaxStep + 1;
+        float error = 0;
+        for (int j = 0; j + 1 < n; j++) {
+            for (int i = 0; i + 1 < n; i++) {
+                float mid = 0.25f * (grid[j * n + i] + grid[j * n + i + 1] +
+                    grid[(j + 1) * n + i] + grid[(j + 1) * n + i + 1]);
+                float actual = generator(x0 + i * kMaxStep + kMaxStep / 2, y0 + j * kMaxStep + kMaxStep / 2);
+                float d = std::fabs(actual - mid);
+                if (d > error) error = d;
+            }
+        }
+
+        int step = kMaxStep;
+        while (step > 1 && error * (step * step) / (kMaxStep * kMaxStep) > tolerance) step /= 2;
+        if (step > 1 && step < kMaxStep) sampleGrid(grid, x0, y0, step);
+        n = kTileSize / step + 1;
+
+        for (int j = 0; j < kTileSize; j++) {
+            int y = y0 + j;
+            int gy = j / step;
+            float fy = (float)(j - gy * step) / step;
+            for (int i = 0; i < kTileSize; i++) {
+                int x = x0 + i;
+                float& out = tile[j * kTileSize + i];
+                if (x >= width || y >= height) {
+                    out = 0.0f;
+                    continue;
+                }
+                float smooth;
+                if (step == 1) {
+                    smooth = generator(x, y);
+                } else {
+                    int gx = i / step;
+                    float fx = (float)(i - gx * step) / step;
+                    const float* g = grid + gy * n + gx;
+                    float top = g[0] + (g[1] - g[0]) * fx;
+                    float bottom = g[n] + (g[n + 1] - g[n]) * fx;
+                    smooth = top + (bottom - top) * fy;
+                }
+                out = detailGenerator(x, y, smooth);
+            }
+        }
+    }
+};
+
+// Process-wide cache of fields, least recently used first out once the memory
+// budget is exceeded. Evicted fields stay alive while a render still holds them
+// but no longer count against the budget. A field bigger than the whole budget
+// is evicted as soon as it grows past it, so the cache never holds more.
+class FieldCache : public FieldLedger {
+public:
+    static FieldCache& instance() {
+        static FieldCache cache;
+        return cache;
+    }
+
+    // Returns the cached field for key, building it with make() when missing
+    template<typename T, typename Factory>
+    std::shared_ptr<T> find(const FieldKey& key, Factory make) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->key == key) {
+                    entries.splice(entries.begin(), entries, it);
+                    return std::static_pointer_cast<T>(it->field);
+                }
+            }
+        }
+
+        // Build outside the lock so other renders are not held up
+        std::shared_ptr<T> field = make();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->key == key) return std::static_pointer_cast<T>(it->field);
+        }
+        entries.push_front(Entry(key, field));
+        field->attach(this);
+        trimLocked();
+        return field;
+    }
+
+    std::shared_ptr<FieldPlane> plane(const FieldKey& key, int w, int h, FieldPlane::Generator gen) {
+        return find<FieldPlane>(key, [&]() { return std::make_shared<FieldPlane>(w, h, gen); });
+    }
+
+    std::shared_ptr<FieldPlane> plane(const FieldKey& key, int w, int h, FieldPlane::Generator smooth,
+        FieldPlane::DetailGenerator detail, float tolerance)
+    {
+        return find<FieldPlane>(key, [&]() { return std::make_shared<FieldPlane>(w, h, smooth, detail, tolerance); });
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end(); ++it) it->field->detach();
+        entries.clear();
+    }
+
+    // Whether fields of this many bytes in total can stay cached
+    bool fits(size_t bytes) const { return bytes <= budgetBytes; }
+
+    // Bytes the cached fields hold right now
+    size_t bytes() const { return (size_t)totalBytes.load(); }
+
+    bool charge(ptrdiff_t bytes) {
+        int64_t total = totalBytes += bytes;
+        return bytes > 0 && total > (int64_t)budgetBytes;
+    }
+
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex);
+        trimLocked();
+    }
+
+private:
+    struct Entry {
+        Entry(const FieldKey& k, std::shared_ptr<CachedField> f) : key(k), field(f) {}
+        FieldKey key;
+        std::shared_ptr<CachedField> field;
+    };
+
+    void trimLocked() {
+        while (totalBytes.load() > (int64_t)budgetBytes && !entries.empty()) {
+            entries.back().field->detach();
+            entries.pop_back();
+        }
+    }
+
+    FieldCache() : totalBytes(0), budgetBytes((size_t)512 * 1024 * 1024) {}
+
+    std::mutex mutex;
+    std::list<Entry> entries;
+    std::atomic<int64_t> totalBytes;    // charged by the fields as they grow
+    size_t budgetBytes;
+};
+
+#endif // FIELDCACHE_H
@@ -0,0 +1,95 @@
+/*
+    FixedBlend.h
+
+    Q15 fixed-point blending for 8-bit renders. Values 0..32767 stand for
+    0.0..1.0 and a lerp is one rounding multiply-high per lane (pmulhrsw on
+    x86, vqrdmulh on ARM). The scalar fallback rounds the same way, so every
+    path gives identical pixels.
+*/
+
+#pragma once
+
+#ifndef FIXEDBLEND_H
+#define FIXEDBLEND_H
+
+#include <cstdint>
+
+#if defined(__SSSE3__) || defined(__AVX__) || defined(_M_X64)
+    #include <tmmintrin.h>
+    #define FIXEDBLEND_SSSE3 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define FIXEDBLEND_NEON 1
+#endif
+
+#define Q15_ONE     32767
+
+// Rounded (a * b) >> 15
+inline int16_t mulQ15(int16_t a, int16_t b) {
+    return (int16_t)(((int32_t)a * b + 0x4000) >> 15);
+}
+
+inline int16_t toQ15(float v) {
+    return (int16_t)(v * (float)Q15_ONE + 0.5f);
+}
+
+// out = a + (b - a) * t, with a, b and t in 0..Q15_ONE. out may alias a or b.
+inline void lerpQ15Span(const int16_t* a, const int16_t* b, const int16_t* t, int16_t* out, int n) {
+    int x = 0;
+#if defined(FIXEDBLEND_SSSE3)
+    for (; x + 8 <= n; x += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+        __m128i vt = _mm_loadu_si128((const __m128i*)(t + x));
+        __m128i d = _mm_mulhrs_epi16(_mm_sub_epi16(vb, va), vt);
+        _mm_storeu_si128((__m128i*)(out + x), _mm_add_epi16(va, d));
+    }
+#elif defined(FIXEDBLEND_NEON)
+    for (; x + 8 <= n; x += 8) {
+        int16x8_t va = vld1q_s16(a + x);
+        int16x8_t vb = vld1q_s16(b + x);
+        int16x8_t vt = vld1q_s16(t + x);
+        int16x8_t d = vqrdmulhq_s16(vsubq_s16(vb, va), vt);
+        vst1q_s16(out + x, vaddq_s16(va, d));
+    }
+#endif
+    for (; x < n; x++) {
+        out[x] = (int16_t)(a[x] + mulQ15((int16_t)(b[x] - a[x]), t[x]));
+    }
+}
+
+// dst = dst + (color - dst) * t, blending a flat colour in by coverage t
+inline void lerpQ15SpanToConst(int16_t* dst, int16_t color, const int16_t* t, int n) {
+    int x = 0;
+#if defined(FIXEDBLEND_SSSE3)
+    __m128i vc = _mm_set1_epi16(color);
+    for (; x + 8 <= n; x += 8) {
+        __m128i vd = _mm_loadu_si128((const __m128i*)(dst + x));
+        __m128i vt = _mm_loadu_si128((const __m128i*)(t + x));
+        __m128i d = _mm_mulhrs_epi16(_mm_sub_epi16(vc, vd), vt);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_add_epi16(vd, d));
+    }
+#elif defined(FIXEDBLEND_NEON)
+    int16x8_t vc = vdupq_n_s16(color);
+    for (; x + 8 <= n; x += 8) {
+        int16x8_t vd = vld1q_s16(dst + x);
+        int16x8_t vt = vld1q_s16(t + x);
+        int16x8_t d = vqrdmulhq_s16(vsubq_s16(vc, vd), vt);
+        vst1q_s16(dst + x, vaddq_s16(vd, d));
+    }
+#endif
+    for (; x < n; x++) {
+        dst[x] = (int16_t)(dst[x] + mulQ15((int16_t)(color - dst[x]), t[x]));
+    }
+}
+
+// Q15 <-> 8-bit channel, rounded to nearest
+inline int16_t q15From8(uint8_t c) {
+    return (int16_t)((c * Q15_ONE + 127) / 255);
+}
+
+inline uint8_t q15To8(int16_t v) {
+    return (uint8_t)((v * 255 + Q15_ONE / 2) / Q15_ONE);
+}
+
+#endif // FIXEDBLEND_H
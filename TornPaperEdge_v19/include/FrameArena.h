@@ -0,0 +1,166 @@
+/*
+    FrameArena.h
+
+    Scratch memory for one render. A render borrows an arena from the pool,
+    carves its distance planes and scratch rows out of it with a bump
+    allocator and hands it back when the frame is done. The arena keeps its
+    block, so the next render on any thread reuses memory that is already
+    mapped instead of going through the heap and faulting in fresh pages.
+    Renders running in parallel under multi-frame rendering each hold their
+    own arena and never contend on it.
+*/
+
+#pragma once
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+class FrameArena {
+public:
+    enum {
+        kAlign = 64,                    // cache line, and enough for any SIMD load
+        kMinBlock = 4 * 1024 * 1024
+    };
+
+    FrameArena() : used(0), highWater(0) {}
+    ~FrameArena() { releaseBlocks(); }
+
+    // bytes of uninitialised memory aligned to kAlign, valid until reset().
+    // Safe to call from several threads of the same render.
+    void* allocate(size_t bytes) {
+        bytes = (bytes + kAlign - 1) & ~(size_t)(kAlign - 1);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (blocks.empty() || blocks.back().size - blocks.back().offset < bytes) {
+            size_t size = bytes > kMinBlock ? bytes : (size_t)kMinBlock;
+            blocks.push_back(Block(size));
+        }
+        Block& block = blocks.back();
+        void* p = block.data + block.offset;
+        block.offset += bytes;
+        used += bytes;
+        return p;
+    }
+
+    template<typename T>
+    T* allocArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    // Constructs a T in the arena. T's destructor is never run, so T must only
+    // own arena memory.
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Forgets every allocation. A frame that needed several blocks leaves one
+    // block big enough for all of them, so the next frame bumps through a
+    // single block.
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (used > highWater) highWater = used;
+        if (blocks.size() > 1 || (!blocks.empty() && blocks.back().size < highWater)) {
+            releaseBlocks();
+            blocks.push_back(Block(highWater));
+        }
+        for (size_t i = 0; i < blocks.size(); i++) blocks[i].offset = 0;
+        used = 0;
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (size_t i = 0; i < blocks.size(); i++) total += blocks[i].size;
+        return total;
+    }
+
+private:
+    struct Block {
+        explicit Block(size_t bytes)
+            : data(static_cast<char*>(::operator new(bytes, std::align_val_t(kAlign)))), size(bytes), offset(0) {}
+        char* data;
+        size_t size;
+        size_t offset;
+    };
+
+    void releaseBlocks() {
+        for (size_t i = 0; i < blocks.size(); i++) ::operator delete(blocks[i].data, std::align_val_t(kAlign));
+        blocks.clear();
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    std::mutex mutex;
+    std::vector<Block> blocks;
+    size_t used;
+    size_t highWater;
+};
+
+// Idle arenas waiting for the next render. Arenas handed back while the idle
+// ones already hold the budget are freed instead of kept.
+class ArenaPool {
+public:
+    static ArenaPool& instance() {
+        static ArenaPool pool;
+        return pool;
+    }
+
+    std::unique_ptr<FrameArena> acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.empty()) return std::unique_ptr<FrameArena>(new FrameArena());
+        std::unique_ptr<FrameArena> arena = std::move(idle.back());
+        idle.pop_back();
+        idleBytes -= arena->capacity();
+        return arena;
+    }
+
+    void release(std::unique_ptr<FrameArena> arena) {
+        arena->reset();
+        size_t bytes = arena->capacity();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idleBytes + bytes > budgetBytes) return;
+        idleBytes += bytes;
+        idle.push_back(std::move(arena));
+    }
+
+    // Frees every idle arena. Arenas lent out to renders are unaffected.
+    void purge() {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.clear();
+        idleBytes = 0;
+    }
+
+private:
+    ArenaPool() : idleBytes(0), budgetBytes((size_t)256 * 1024 * 1024) {}
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<FrameArena>> idle;
+    size_t idleBytes;
+    size_t budgetBytes;
+};
+
+// Borrows an arena for the lifetime of a render
+class ScopedArena {
+public:
+    ScopedArena() : arena(ArenaPool::instance().acquire()) {}
+    ~ScopedArena() { ArenaPool::instance().release(std::move(arena)); }
+
+    FrameArena& operator*() const { return *arena; }
+    FrameArena* operator->() const { return arena.get(); }
+
+private:
+    ScopedArena(const ScopedArena&) = delete;
+    ScopedArena& operator=(const ScopedArena&) = delete;
+
+    std::unique_ptr<FrameArena> arena;
+};
+
+#endif // FRAMEARENA_H
@@ -0,0 +1,94 @@
+/*
+    Prefetcher.h
+
+    A background thread that builds fields ahead of the render. Dragging a
+    slider sends a stream of changes and only the newest values are worth
+    building, so a job still waiting to start is replaced by the next one, and
+    a running job checks overtaken() between pieces of work and gives up as
+    soon as a newer job arrives.
+*/
+
+#pragma once
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+class Prefetcher {
+public:
+    typedef std::function<void()> Job;
+
+    static Prefetcher& instance() {
+        static Prefetcher prefetcher;
+        return prefetcher;
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (worker.joinable()) return;
+        quitting = false;
+        worker = std::thread(&Prefetcher::workerLoop, this);
+    }
+
+    // Drops the waiting job and waits for the running one to give up
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!worker.joinable()) return;
+            quitting = true;
+            next = nullptr;
+            pending = false;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    // Replaces any job that has not started yet. Jobs submitted while the
+    // thread is stopped are dropped.
+    void submit(Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!worker.joinable() || quitting) return;
+            next = std::move(job);
+            pending = true;
+        }
+        wake.notify_all();
+    }
+
+    // True once a newer job is waiting or the thread is shutting down
+    bool overtaken() const { return pending.load() || quitting.load(); }
+
+private:
+    Prefetcher() : pending(false), quitting(false) {}
+    ~Prefetcher() { stop(); }
+
+    void workerLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return quitting.load() || pending.load(); });
+                if (quitting) return;
+                job = std::move(next);
+                next = nullptr;
+                pending = false;
+            }
+            job();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    Job next;
+    std::atomic<bool> pending;
+    std::atomic<bool> quitting;
+};
+
+#endif // PREFETCHER_H
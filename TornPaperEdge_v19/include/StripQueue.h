@@ -0,0 +1,81 @@
+/*
+    StripQueue.h
+
+    Bounded single-producer, single-consumer queue linking two stages of the
+    strip pipeline. One thread only pushes and one thread only pops, so a pair
+    of indices with acquire/release ordering is all the synchronisation needed.
+    The bound keeps the producer at most Capacity strips ahead, which caps the
+    memory held by strips in flight.
+*/
+
+#pragma once
+
+#ifndef STRIPQUEUE_H
+#define STRIPQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+template<typename T, size_t Capacity>
+class StripQueue {
+public:
+    StripQueue() : head(0), tail(0) {}
+
+    // False when the queue is full
+    bool tryPush(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        slots[t % Capacity] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // False when the queue is empty
+    bool tryPop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return false;
+        item = slots[h % Capacity];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocking forms: spin briefly, then back off so a stalled stage does not
+    // take a core from the render threads
+    void push(const T& item) {
+        for (int spins = 0; !tryPush(item); spins++) backOff(spins);
+    }
+
+    T pop() {
+        T item;
+        for (int spins = 0; !tryPop(item); spins++) backOff(spins);
+        return item;
+    }
+
+    // pop() calling idle() between attempts, for a consumer with other
+    // duties while it waits
+    template<typename Fn>
+    T pop(Fn idle) {
+        T item;
+        for (int spins = 0; !tryPop(item); spins++) {
+            idle();
+            backOff(spins);
+        }
+        return item;
+    }
+
+private:
+    static void backOff(int spins) {
+        if (spins < 64) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    T slots[Capacity];
+
+    // Each index on its own cache line so the two threads do not share one
+    alignas(64) std::atomic<size_t> head;   // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail;   // next slot to push, written by the producer
+};
+
+#endif // STRIPQUEUE_H
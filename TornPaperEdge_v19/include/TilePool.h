@@ -0,0 +1,247 @@
+/*
+    TilePool.h
+
+    Plugin-owned worker threads for hosts that do not hand out their own
+    render threads. Each job is split into contiguous runs of tasks, one run
+    per thread, so a thread walks neighbouring tiles; a thread that finishes
+    its run steals from the far end of another thread's run. Expensive tiles
+    along the torn edge therefore spread over every thread instead of stalling
+    the one that owns them.
+
+    Only one job uses the workers at a time. Under multi-frame rendering the
+    host is already running a frame per core, so a render that finds the
+    workers busy runs its job on its own thread rather than adding more.
+
+    A job can be held to fewer threads than the pool has, so a calibration
+    can time smaller thread counts without stopping any worker.
+*/
+
+#pragma once
+
+#ifndef TILEPOOL_H
+#define TILEPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Interleaves the bits of x and y so that tiles close in the order are close
+// on screen
+inline uint32_t mortonCode(uint32_t x, uint32_t y) {
+    uint32_t code = 0;
+    for (int bit = 0; bit < 16; bit++) {
+        code |= ((x >> bit) & 1u) << (2 * bit);
+        code |= ((y >> bit) & 1u) << (2 * bit + 1);
+    }
+    return code;
+}
+
+// Tile indices (ty * tilesX + tx) of a tilesX by tilesY grid in Morton order
+inline std::vector<int> mortonOrder(int tilesX, int tilesY) {
+    std::vector<std::pair<uint32_t, int>> keyed;
+    keyed.reserve((size_t)tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            keyed.push_back(std::make_pair(mortonCode((uint32_t)tx, (uint32_t)ty), ty * tilesX + tx));
+        }
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    std::vector<int> order;
+    order.reserve(keyed.size());
+    for (size_t i = 0; i < keyed.size(); i++) order.push_back(keyed[i].second);
+    return order;
+}
+
+class TilePool {
+public:
+    typedef void (*TaskFn)(void* refcon, int task, int thread);
+
+    static TilePool& instance() {
+        static TilePool pool;
+        return pool;
+    }
+
+    // threads is the total concurrency, the calling thread included
+    void start(int threads) {
+        stop();
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+        int workerCount = threads - 1;
+        if (workerCount < 0) workerCount = 0;
+        if (workerCount > kMaxWorkers) workerCount = kMaxWorkers;
+
+        queues.clear();
+        for (int i = 0; i <= workerCount; i++) queues.emplace_back(new TaskQueue());
+        jobThreads = workerCount + 1;
+        quitting = false;
+        for (int i = 0; i < workerCount; i++) workers.emplace_back(&TilePool::workerLoop, this, i, generation);
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+        workers.clear();
+        queues.clear();
+    }
+
+    // Thread indices passed to tasks are below this
+    int threadCount() {
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+        return (int)workers.size() + 1;
+    }
+
+    // Jobs started from now on use at most threads, the caller included,
+    // until the next start()
+    void limit(int threads) { jobThreads = threads < 1 ? 1 : threads; }
+
+    // Calls fn(task, thread) once for each task in [0, taskCount) and returns
+    // when all have finished. Tasks with nearby indices go to the same thread.
+    template<typename Fn>
+    void run(int taskCount, Fn fn) {
+        struct Thunk {
+            static void call(void* refcon, int task, int thread) { (*static_cast<Fn*>(refcon))(task, thread); }
+        };
+        runTasks(taskCount, &fn, &Thunk::call);
+    }
+
+private:
+    enum { kMaxWorkers = 63 };
+
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    TilePool() : jobThreads(1), quitting(false), generation(0), jobWorkers(0), jobFn(nullptr), jobRefcon(nullptr),
+        remaining(0), busyWorkers(0) {}
+    ~TilePool() { stop(); }
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<TaskQueue>> queues;     // one per worker, the caller's last
+    std::mutex jobMutex;                                // held by the job using the workers
+    std::atomic<int> jobThreads;                        // concurrency of the next job
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool quitting;
+    uint64_t generation;
+
+    int jobWorkers;                                     // workers taking part in the job
+    TaskFn jobFn;
+    void* jobRefcon;
+    std::atomic<int> remaining;
+    std::atomic<int> busyWorkers;
+    std::mutex doneMutex;
+    std::condition_variable done;
+
+    void runTasks(int taskCount, void* refcon, TaskFn fn) {
+        if (taskCount <= 0) return;
+
+        // The workers may be restarting while another job holds them, so a
+        // job that runs alone never looks at them
+        std::unique_lock<std::mutex> jobLock(jobMutex, std::try_to_lock);
+        if (!jobLock.owns_lock()) {
+            for (int task = 0; task < taskCount; task++) fn(refcon, task, 0);
+            return;
+        }
+        int callerIndex = (int)workers.size();
+        int helpers = std::min((int)workers.size(), jobThreads.load() - 1);
+        if (helpers <= 0 || taskCount == 1) {
+            for (int task = 0; task < taskCount; task++) fn(refcon, task, callerIndex);
+            return;
+        }
+
+        // Contiguous runs for the first helpers workers, the caller taking the last one
+        int participants = helpers + 1;
+        for (int p = 0; p < participants; p++) {
+            int begin = (int)((int64_t)taskCount * p / participants);
+            int end = (int)((int64_t)taskCount * (p + 1) / participants);
+            TaskQueue& queue = *queues[p < helpers ? p : callerIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (int task = begin; task < end; task++) queue.tasks.push_back(task);
+        }
+        jobWorkers = helpers;
+        jobFn = fn;
+        jobRefcon = refcon;
+        remaining = taskCount;
+        busyWorkers = (int)workers.size();
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            generation++;
+        }
+        wake.notify_all();
+
+        work(callerIndex);
+
+        // Workers may still be scanning the queues after the last task ends
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&]() { return remaining.load() == 0 && busyWorkers.load() == 0; });
+        jobFn = nullptr;
+        jobRefcon = nullptr;
+    }
+
+    // The owner takes from the front of its run, thieves from the back of another
+    bool take(int self, int& task) {
+        {
+            TaskQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        int participants = (int)queues.size();
+        for (int i = 1; i < participants; i++) {
+            TaskQueue& victim = *queues[(self + i) % participants];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int self) {
+        int task;
+        while (take(self, task)) {
+            jobFn(jobRefcon, task, self);
+            if (--remaining == 0) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(int self, uint64_t seen) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [&]() { return quitting || generation != seen; });
+                if (quitting) return;
+                seen = generation;
+            }
+            if (self < jobWorkers) work(self);
+            if (--busyWorkers == 0) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                done.notify_all();
+            }
+        }
+    }
+};
+
+#endif // TILEPOOL_H
@@ -40,6 +40,10 @@
 // Buffer expansion for fibers extending beyond original alpha
 #define MAX_EXPAND_PIXELS   100
 
+// Fold lines per instance (Fold Point 1/2 plus the Additional Folds group)
+#define MAX_FOLDS           6
+
+// Param indices, in the order ParamsSetup adds them to the Effect Controls
 enum {
     PARAM_INPUT = 0,
     
@@ -48,7 +52,11 @@ enum {
     PARAM_MASTER_SCALE,
     PARAM_GAP_WIDTH,
     PARAM_RANDOM_SEED,
+    PARAM_BOIL,
+    PARAM_BOIL_HOLD,
     PARAM_EDGE_SOFTNESS,
+    PARAM_ADAPTIVE_SHADING,
+    PARAM_EDGE_ENGINE,
     PARAM_TOPIC_BASIC_END,
     
     // Edge Settings (contains Outer, Inner, Middle edges)
@@ -122,6 +130,26 @@ enum {
     PARAM_FOLD_AMOUNT,
     PARAM_FOLD_POINT1,
     PARAM_FOLD_POINT2,
+    PARAM_FOLD_LAYOUT,
+    
+    // Additional Folds (nested in Fold)
+    PARAM_TOPIC_FOLD_EXTRA,
+    PARAM_FOLD2_AMOUNT,
+    PARAM_FOLD2_START,
+    PARAM_FOLD2_END,
+    PARAM_FOLD3_AMOUNT,
+    PARAM_FOLD3_START,
+    PARAM_FOLD3_END,
+    PARAM_FOLD4_AMOUNT,
+    PARAM_FOLD4_START,
+    PARAM_FOLD4_END,
+    PARAM_FOLD5_AMOUNT,
+    PARAM_FOLD5_START,
+    PARAM_FOLD5_END,
+    PARAM_FOLD6_AMOUNT,
+    PARAM_FOLD6_START,
+    PARAM_FOLD6_END,
+    PARAM_TOPIC_FOLD_EXTRA_END,
     
     // Advanced Settings (nested in Fold)
     PARAM_TOPIC_FOLD_ADVANCED,
@@ -176,6 +204,177 @@ enum {
     PARAM_NUM_PARAMS
 };
 
+// Param disk IDs, which projects save values and keyframes under. These
+// never change: a version 18 param keeps the ID it shipped with and a param
+// added since is appended, wherever it sits in the UI.
+enum {
+    // Basic Settings
+    TOPIC_BASIC_DISK_ID = 1,
+    MASTER_SCALE_DISK_ID,
+    GAP_WIDTH_DISK_ID,
+    RANDOM_SEED_DISK_ID,
+    EDGE_SOFTNESS_DISK_ID,
+    TOPIC_BASIC_END_DISK_ID,
+    
+    // Edge Settings (contains Outer, Inner, Middle edges)
+    TOPIC_EDGE_SETTINGS_DISK_ID,
+    
+    // Outer Edge
+    TOPIC_OUTER_DISK_ID,
+    OUTER_ROUGHNESS_DISK_ID,
+    OUTER_ROUGH_SCALE_DISK_ID,
+    OUTER_JAGGEDNESS_DISK_ID,
+    OUTER_NOTCH_DISK_ID,
+    TOPIC_OUTER_END_DISK_ID,
+    
+    // Inner Edge
+    TOPIC_INNER_DISK_ID,
+    INNER_ROUGHNESS_DISK_ID,
+    INNER_ROUGH_SCALE_DISK_ID,
+    INNER_JAGGEDNESS_DISK_ID,
+    INNER_NOTCH_DISK_ID,
+    INNER_EXPANSION_DISK_ID,
+    TOPIC_INNER_END_DISK_ID,
+    
+    // Middle Edge 1
+    TOPIC_MIDDLE1_DISK_ID,
+    MIDDLE1_AMOUNT_DISK_ID,
+    MIDDLE1_POSITION_DISK_ID,
+    MIDDLE1_ROUGHNESS_DISK_ID,
+    MIDDLE1_SHADOW_DISK_ID,
+    MIDDLE1_FIBER_DENSITY_DISK_ID,
+    TOPIC_MIDDLE1_END_DISK_ID,
+    
+    // Middle Edge 2
+    TOPIC_MIDDLE2_DISK_ID,
+    MIDDLE2_AMOUNT_DISK_ID,
+    MIDDLE2_POSITION_DISK_ID,
+    MIDDLE2_ROUGHNESS_DISK_ID,
+    MIDDLE2_SHADOW_DISK_ID,
+    MIDDLE2_FIBER_DENSITY_DISK_ID,
+    TOPIC_MIDDLE2_END_DISK_ID,
+    
+    TOPIC_EDGE_SETTINGS_END_DISK_ID,
+    
+    // Paper Appearance (includes Fibers)
+    TOPIC_PAPER_DISK_ID,
+    PAPER_TEXTURE_DISK_ID,
+    SHADOW_AMOUNT_DISK_ID,
+    SHADOW_WIDTH_DISK_ID,
+    PAPER_COLOR_DISK_ID,
+    FIBER_COLOR_DISK_ID,
+    CONTENT_SHADOW_AMOUNT_DISK_ID,
+    CONTENT_SHADOW_WIDTH_DISK_ID,
+    
+    // Fibers (nested in Paper)
+    TOPIC_FIBERS_DISK_ID,
+    FIBER_DENSITY_DISK_ID,
+    FIBER_LENGTH_DISK_ID,
+    FIBER_THICKNESS_DISK_ID,
+    FIBER_SPREAD_DISK_ID,
+    FIBER_SOFTNESS_DISK_ID,
+    FIBER_FEATHER_DISK_ID,
+    FIBER_RANGE_DISK_ID,
+    FIBER_SHADOW_DISK_ID,
+    FIBER_OPACITY_DISK_ID,
+    FIBER_BLUR_DISK_ID,
+    TOPIC_FIBERS_END_DISK_ID,
+    
+    TOPIC_PAPER_END_DISK_ID,
+    
+    // Fold Mark
+    TOPIC_FOLD_DISK_ID,
+    FOLD_AMOUNT_DISK_ID,
+    FOLD_POINT1_DISK_ID,
+    FOLD_POINT2_DISK_ID,
+    
+    // Advanced Settings (nested in Fold)
+    TOPIC_FOLD_ADVANCED_DISK_ID,
+    FOLD_LINE_ROUGHNESS_DISK_ID,
+    FOLD_LINE_ROUGH_SCALE_DISK_ID,
+    FOLD_LINE_WIDTH_DISK_ID,
+    FOLD_SIDE_A_WIDTH_DISK_ID,
+    FOLD_SIDE_A_ROUGHNESS_DISK_ID,
+    FOLD_SIDE_A_ROUGH_SCALE_DISK_ID,
+    FOLD_SIDE_A_JAGGEDNESS_DISK_ID,
+    FOLD_SIDE_B_WIDTH_DISK_ID,
+    FOLD_SIDE_B_ROUGHNESS_DISK_ID,
+    FOLD_SIDE_B_ROUGH_SCALE_DISK_ID,
+    FOLD_SIDE_B_JAGGEDNESS_DISK_ID,
+    FOLD_CRACK_AMOUNT_DISK_ID,
+    FOLD_CRACK_LENGTH_DISK_ID,
+    FOLD_CRACK_LENGTH_VAR_DISK_ID,
+    FOLD_CRACK_DENSITY_DISK_ID,
+    FOLD_CRACK_BRANCHING_DISK_ID,
+    FOLD_CRACK_ANGLE_DISK_ID,
+    FOLD_CRACK_ANGLE_VAR_DISK_ID,
+    FOLD_SHADOW_A_OPACITY_DISK_ID,
+    FOLD_SHADOW_A_LENGTH_DISK_ID,
+    FOLD_SHADOW_A_VARIABILITY_DISK_ID,
+    FOLD_SHADOW_A_COLOR_DISK_ID,
+    FOLD_SHADOW_B_OPACITY_DISK_ID,
+    FOLD_SHADOW_B_LENGTH_DISK_ID,
+    FOLD_SHADOW_B_VARIABILITY_DISK_ID,
+    FOLD_SHADOW_B_COLOR_DISK_ID,
+    TOPIC_FOLD_ADVANCED_END_DISK_ID,
+    
+    TOPIC_FOLD_END_DISK_ID,
+    
+    // Grunge
+    TOPIC_GRUNGE_DISK_ID,
+    DIRT_AMOUNT_DISK_ID,
+    DIRT_SIZE_DISK_ID,
+    DIRT_OPACITY_DISK_ID,
+    DIRT_SEED_DISK_ID,
+    DIRT_COLOR_DISK_ID,
+    SMUDGE_AMOUNT_DISK_ID,
+    SMUDGE_SIZE_DISK_ID,
+    SMUDGE_OPACITY_DISK_ID,
+    SMUDGE_SEED_DISK_ID,
+    SMUDGE_COLOR_DISK_ID,
+    DUST_AMOUNT_DISK_ID,
+    DUST_SIZE_DISK_ID,
+    DUST_SEED_DISK_ID,
+    DUST_COLOR_DISK_ID,
+    TOPIC_GRUNGE_END_DISK_ID,
+    
+    // Added after version 18
+    BOIL_DISK_ID,
+    BOIL_HOLD_DISK_ID,
+    ADAPTIVE_SHADING_DISK_ID,
+    EDGE_ENGINE_DISK_ID,
+    FOLD_LAYOUT_DISK_ID,
+    TOPIC_FOLD_EXTRA_DISK_ID,
+    FOLD2_AMOUNT_DISK_ID,
+    FOLD2_START_DISK_ID,
+    FOLD2_END_DISK_ID,
+    FOLD3_AMOUNT_DISK_ID,
+    FOLD3_START_DISK_ID,
+    FOLD3_END_DISK_ID,
+    FOLD4_AMOUNT_DISK_ID,
+    FOLD4_START_DISK_ID,
+    FOLD4_END_DISK_ID,
+    FOLD5_AMOUNT_DISK_ID,
+    FOLD5_START_DISK_ID,
+    FOLD5_END_DISK_ID,
+    FOLD6_AMOUNT_DISK_ID,
+    FOLD6_START_DISK_ID,
+    FOLD6_END_DISK_ID,
+    TOPIC_FOLD_EXTRA_END_DISK_ID
+};
+
+// Edge Engine popup
+enum {
+    EDGE_ENGINE_DISTANCE = 1,   // per-pixel distance field
+    EDGE_ENGINE_VECTOR          // displaced contour polygons
+};
+
+// Fold Layout popup
+enum {
+    FOLD_LAYOUT_SEPARATE = 1,   // each fold has its own start and end point
+    FOLD_LAYOUT_POLYLINE        // each fold starts where the previous one ends
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -198,6 +397,9 @@ PF_Err About(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
 PF_Err GlobalSetup(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
 PF_Err ParamsSetup(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
 PF_Err GlobalSetdown(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
+PF_Err QueryDynamicFlags(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
+PF_Err UserChangedParam(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
+PF_Err UpdateParamsUI(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
 
 // Legacy render (fallback)
 PF_Err Render(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*);
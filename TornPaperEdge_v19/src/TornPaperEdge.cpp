@@ -15,10 +15,24 @@
 
 #include "TornPaperEdge.h"
 #include "NoiseUtils.h"
+#include "FieldCache.h"
+#include "FixedBlend.h"
+#include "TilePool.h"
+#include "StripQueue.h"
+#include "FrameArena.h"
+#include "Prefetcher.h"
+#include "AutoTune.h"
 #include "AEFX_SuiteHelper.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <vector>
+#include <array>
+#include <utility>
+#include <type_traits>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
 
 #ifdef min
 #undef min
@@ -34,6 +48,7 @@ template<typename T>
 inline T safeMax(T a, T b) { return (a > b) ? a : b; }
 
 inline double clamp01(double x) { return safeMax(0.0, safeMin(1.0, x)); }
+inline float clamp01f(float x) { return safeMax(0.0f, safeMin(1.0f, x)); }
 inline double clamp(double x, double lo, double hi) { return safeMax(lo, safeMin(hi, x)); }
 
 inline double smoothstep(double edge0, double edge1, double x) {
@@ -68,9 +83,18 @@ PF_Err EffectMain(
             case PF_Cmd_GLOBAL_SETDOWN:
                 err = GlobalSetdown(in_data, out_data, params, output);
                 break;
+            case PF_Cmd_QUERY_DYNAMIC_FLAGS:
+                err = QueryDynamicFlags(in_data, out_data, params, output);
+                break;
             case PF_Cmd_PARAMS_SETUP:
                 err = ParamsSetup(in_data, out_data, params, output);
                 break;
+            case PF_Cmd_USER_CHANGED_PARAM:
+                err = UserChangedParam(in_data, out_data, params, output);
+                break;
+            case PF_Cmd_UPDATE_PARAMS_UI:
+                err = UpdateParamsUI(in_data, out_data, params, output);
+                break;
             case PF_Cmd_RENDER:
                 err = Render(in_data, out_data, params, output);
                 break;
@@ -106,6 +130,9 @@ PF_Err About(
     return PF_Err_NONE;
 }
 
+// Times the render tunings in the background (see AUTO TUNING)
+inline void calibrateInBackground(PF_InData* in_data);
+
 PF_Err GlobalSetup(
     PF_InData       *in_data,
     PF_OutData      *out_data,
@@ -116,10 +143,26 @@ PF_Err GlobalSetup(
     
     // Flags from AE_Effect.h:
     // PF_OutFlag_DEEP_COLOR_AWARE (1<<25) | PF_OutFlag_I_EXPAND_BUFFER (1<<9) | PF_OutFlag_PIX_INDEPENDENT (1<<10)
-    out_data->out_flags = 33555968;  // 0x02000600
+    // | PF_OutFlag_NON_PARAM_VARY (1<<2, cleared by QueryDynamicFlags unless Boil is on)
+    // | PF_OutFlag_SEND_UPDATE_PARAMS_UI (1<<26)
+    out_data->out_flags = 100664836;  // 0x06000604
     
     // PF_OutFlag2_SUPPORTS_SMART_RENDER (1<<10) | PF_OutFlag2_FLOAT_COLOR_AWARE (1<<12) | PF_OutFlag2_SUPPORTS_THREADED_RENDERING (1<<27)
-    out_data->out_flags2 = 134222848;  // 0x08001400
+    // | PF_OutFlag2_SUPPORTS_QUERY_DYNAMIC_FLAGS (1<<0)
+    out_data->out_flags2 = 134222849;  // 0x08001401
+    
+    // Saved tuning for this machine, or the defaults until the calibration
+    // started below has timed the candidates
+    char version[32];
+    snprintf(version, sizeof(version), "%d.%d.%d.%d", MAJOR_VERSION, MINOR_VERSION, BUG_VERSION, BUILD_VERSION);
+    RenderTuning tuning = defaultTuning();
+    RenderTuner::instance().load(version, tuning);
+    RenderTuner::instance().set(tuning);
+    
+    // Worker threads for hosts without iterate_generic
+    TilePool::instance().start(tuning.poolThreads);
+    Prefetcher::instance().start();
+    calibrateInBackground(in_data);
     
     return PF_Err_NONE;
 }
@@ -130,9 +173,38 @@ PF_Err GlobalSetdown(
     PF_ParamDef     *params[],
     PF_LayerDef     *output)
 {
+    Prefetcher::instance().stop();
+    TilePool::instance().stop();
+    ArenaPool::instance().purge();
+    FieldCache::instance().clear();
     return PF_Err_NONE;
 }
 
+PF_Err QueryDynamicFlags(
+    PF_InData       *in_data,
+    PF_OutData      *out_data,
+    PF_ParamDef     *params[],
+    PF_LayerDef     *output)
+{
+    PF_Err err = PF_Err_NONE;
+    PF_ParamDef param;
+    
+    // A boiling edge changes with time alone; otherwise output only follows the params
+    AEFX_CLR_STRUCT(param);
+    ERR(PF_CHECKOUT_PARAM(in_data, PARAM_BOIL, in_data->current_time,
+                          in_data->time_step, in_data->time_scale, &param));
+    if (!err) {
+        if (param.u.bd.value) {
+            out_data->out_flags |= PF_OutFlag_NON_PARAM_VARY;
+        } else {
+            out_data->out_flags &= ~PF_OutFlag_NON_PARAM_VARY;
+        }
+        ERR(PF_CHECKIN_PARAM(in_data, &param));
+    }
+    
+    return err;
+}
+
 PF_Err ParamsSetup(
     PF_InData       *in_data,
     PF_OutData      *out_data,
@@ -142,513 +214,864 @@ PF_Err ParamsSetup(
     PF_Err err = PF_Err_NONE;
     PF_ParamDef def;
     
+    // Params the procedural fields or the output size depend on are supervised,
+    // so changing one starts building the new fields (see UserChangedParam)
+    
     // ==================== BASIC SETTINGS ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Basic Settings", PARAM_TOPIC_BASIC);
+    PF_ADD_TOPIC("Basic Settings", TOPIC_BASIC_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Master Scale", 10.0, 500.0, 10.0, 500.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MASTER_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, MASTER_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Gap Width", -200.0, 500.0, -200.0, 300.0, -50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_GAP_WIDTH);
+        PF_Precision_TENTHS, 0, 0, GAP_WIDTH_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_SLIDER("Random Seed", 0, 30000, 0, 30000, 12345, RANDOM_SEED_DISK_ID);
+    
+    // Boil: re-seed every N frames for a stop-motion look
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_CHECKBOXX("Boil", FALSE, PF_ParamFlag_SUPERVISE, BOIL_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_SLIDER("Random Seed", 0, 30000, 0, 30000, 12345, PARAM_RANDOM_SEED);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_SLIDER("Boil Hold Frames", 1, 30, 1, 12, 2, BOIL_HOLD_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Edge Softness", 0.0, 10.0, 0.0, 10.0, 2.2,
-        PF_Precision_TENTHS, 0, 0, PARAM_EDGE_SOFTNESS);
+        PF_Precision_TENTHS, 0, 0, EDGE_SOFTNESS_DISK_ID);
     
+    // Adaptive Shading: interpolate slowly varying noise from a coarser grid
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_BASIC_END);
+    PF_ADD_CHECKBOXX("Adaptive Shading", FALSE, PF_ParamFlag_SUPERVISE, ADAPTIVE_SHADING_DISK_ID);
+    
+    // Edge Engine: vector polygons skip the distance field for very large stills
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POPUP("Edge Engine", 2, EDGE_ENGINE_DISTANCE, "Distance Field|Vector Polygons", EDGE_ENGINE_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_END_TOPIC(TOPIC_BASIC_END_DISK_ID);
     
     // ==================== EDGE SETTINGS (wrapper) ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Edge Settings", PARAM_TOPIC_EDGE_SETTINGS);
+    PF_ADD_TOPIC("Edge Settings", TOPIC_EDGE_SETTINGS_DISK_ID);
     
     // ==================== OUTER EDGE ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Outer Edge", PARAM_TOPIC_OUTER);
+    PF_ADD_TOPIC("Outer Edge", TOPIC_OUTER_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Outer Roughness", 0.0, 100.0, 0.0, 100.0, 59.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_OUTER_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, OUTER_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Outer Roughness Scale", 5.0, 300.0, 5.0, 300.0, 189.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_OUTER_ROUGH_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, OUTER_ROUGH_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Outer Jaggedness", 0.0, 100.0, 0.0, 100.0, 8.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_OUTER_JAGGEDNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, OUTER_JAGGEDNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Outer Notch Depth", 0.0, 50.0, 0.0, 50.0, 2.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_OUTER_NOTCH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, OUTER_NOTCH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_OUTER_END);
+    PF_END_TOPIC(TOPIC_OUTER_END_DISK_ID);
     
     // ==================== INNER EDGE ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Inner Edge", PARAM_TOPIC_INNER);
+    PF_ADD_TOPIC("Inner Edge", TOPIC_INNER_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Inner Roughness", 0.0, 100.0, 0.0, 100.0, 59.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_INNER_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, INNER_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Inner Roughness Scale", 5.0, 300.0, 5.0, 300.0, 189.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_INNER_ROUGH_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, INNER_ROUGH_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Inner Jaggedness", 0.0, 100.0, 0.0, 100.0, 8.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_INNER_JAGGEDNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, INNER_JAGGEDNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Inner Notch Depth", 0.0, 50.0, 0.0, 50.0, 2.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_INNER_NOTCH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, INNER_NOTCH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Inner Edge Expansion", 1.0, 500.0, 1.0, 500.0, 150.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_INNER_EXPANSION);
+        PF_Precision_TENTHS, 0, 0, INNER_EXPANSION_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_INNER_END);
+    PF_END_TOPIC(TOPIC_INNER_END_DISK_ID);
     
     // ==================== MIDDLE EDGE 1 ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Middle Edge 1", PARAM_TOPIC_MIDDLE1);
+    PF_ADD_TOPIC("Middle Edge 1", TOPIC_MIDDLE1_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 1 Amount", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE1_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, MIDDLE1_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 1 Position", 0.0, 100.0, 0.0, 100.0, 15.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE1_POSITION);
+        PF_Precision_TENTHS, 0, 0, MIDDLE1_POSITION_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 1 Roughness", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE1_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, MIDDLE1_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 1 Shadow", 0.0, 100.0, 0.0, 100.0, 40.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE1_SHADOW);
+        PF_Precision_TENTHS, 0, 0, MIDDLE1_SHADOW_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 1 Fiber Density", 0.0, 100.0, 0.0, 100.0, 40.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE1_FIBER_DENSITY);
+        PF_Precision_TENTHS, 0, 0, MIDDLE1_FIBER_DENSITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_MIDDLE1_END);
+    PF_END_TOPIC(TOPIC_MIDDLE1_END_DISK_ID);
     
     // ==================== MIDDLE EDGE 2 ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Middle Edge 2", PARAM_TOPIC_MIDDLE2);
+    PF_ADD_TOPIC("Middle Edge 2", TOPIC_MIDDLE2_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 2 Amount", 0.0, 100.0, 0.0, 100.0, 48.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE2_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, MIDDLE2_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 2 Position", 0.0, 100.0, 0.0, 100.0, 25.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE2_POSITION);
+        PF_Precision_TENTHS, 0, 0, MIDDLE2_POSITION_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 2 Roughness", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE2_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, MIDDLE2_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 2 Shadow", 0.0, 100.0, 0.0, 100.0, 30.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE2_SHADOW);
+        PF_Precision_TENTHS, 0, 0, MIDDLE2_SHADOW_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Middle 2 Fiber Density", 0.0, 100.0, 0.0, 100.0, 40.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_MIDDLE2_FIBER_DENSITY);
+        PF_Precision_TENTHS, 0, 0, MIDDLE2_FIBER_DENSITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_MIDDLE2_END);
+    PF_END_TOPIC(TOPIC_MIDDLE2_END_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_EDGE_SETTINGS_END);
+    PF_END_TOPIC(TOPIC_EDGE_SETTINGS_END_DISK_ID);
     
     // ==================== PAPER APPEARANCE ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Paper Appearance", PARAM_TOPIC_PAPER);
+    PF_ADD_TOPIC("Paper Appearance", TOPIC_PAPER_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Paper Texture", 0.0, 100.0, 0.0, 100.0, 85.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_PAPER_TEXTURE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, PAPER_TEXTURE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow Amount", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_SHADOW_AMOUNT);
+        PF_Precision_TENTHS, 0, 0, SHADOW_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow Width", 1.0, 50.0, 1.0, 50.0, 28.9,
-        PF_Precision_TENTHS, 0, 0, PARAM_SHADOW_WIDTH);
+        PF_Precision_TENTHS, 0, 0, SHADOW_WIDTH_DISK_ID);
     
     // Paper Color - #efe6d9
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Paper Color", 239, 230, 217, PARAM_PAPER_COLOR);
+    PF_ADD_COLOR("Paper Color", 239, 230, 217, PAPER_COLOR_DISK_ID);
     
     // Fiber Color - #89837a
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Fiber Color", 137, 131, 122, PARAM_FIBER_COLOR);
+    PF_ADD_COLOR("Fiber Color", 137, 131, 122, FIBER_COLOR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Content Shadow Amount", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_CONTENT_SHADOW_AMOUNT);
+        PF_Precision_TENTHS, 0, 0, CONTENT_SHADOW_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Content Shadow Width", 1.0, 50.0, 1.0, 50.0, 15.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_CONTENT_SHADOW_WIDTH);
+        PF_Precision_TENTHS, 0, 0, CONTENT_SHADOW_WIDTH_DISK_ID);
     
     // ==================== FIBERS (nested in Paper) ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Fibers", PARAM_TOPIC_FIBERS);
+    PF_ADD_TOPIC("Fibers", TOPIC_FIBERS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Density", 0.0, 100.0, 0.0, 100.0, 28.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_DENSITY);
+        PF_Precision_TENTHS, 0, 0, FIBER_DENSITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Length", 1.0, 80.0, 1.0, 80.0, 18.8,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_LENGTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FIBER_LENGTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Thickness", 0.1, 5.0, 0.1, 5.0, 0.6,
-        PF_Precision_HUNDREDTHS, 0, 0, PARAM_FIBER_THICKNESS);
+        PF_Precision_HUNDREDTHS, 0, 0, FIBER_THICKNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Spread", 0.0, 90.0, 0.0, 90.0, 60.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_SPREAD);
+        PF_Precision_TENTHS, 0, 0, FIBER_SPREAD_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Softness", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_SOFTNESS);
+        PF_Precision_TENTHS, 0, 0, FIBER_SOFTNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Feather", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_FEATHER);
+        PF_Precision_TENTHS, 0, 0, FIBER_FEATHER_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Range", -100.0, 100.0, -100.0, 100.0, -100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_RANGE);
+        PF_Precision_TENTHS, 0, 0, FIBER_RANGE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Shadow", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_SHADOW);
+        PF_Precision_TENTHS, 0, 0, FIBER_SHADOW_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Opacity", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_OPACITY);
+        PF_Precision_TENTHS, 0, 0, FIBER_OPACITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fiber Blur", 0.0, 20.0, 0.0, 20.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FIBER_BLUR);
+        PF_Precision_TENTHS, 0, 0, FIBER_BLUR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_FIBERS_END);
+    PF_END_TOPIC(TOPIC_FIBERS_END_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_PAPER_END);
+    PF_END_TOPIC(TOPIC_PAPER_END_DISK_ID);
     
     // ==================== FOLD MARK ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Fold Mark", PARAM_TOPIC_FOLD);
+    PF_ADD_TOPIC("Fold Mark", TOPIC_FOLD_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fold Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_AMOUNT_DISK_ID);
     
     // Fold Point 1
     AEFX_CLR_STRUCT(def);
-    PF_ADD_POINT("Fold Point 1", 50, 50, 0, PARAM_FOLD_POINT1);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold Point 1", 50, 50, 0, FOLD_POINT1_DISK_ID);
     
     // Fold Point 2
     AEFX_CLR_STRUCT(def);
-    PF_ADD_POINT("Fold Point 2", 50, 50, 0, PARAM_FOLD_POINT2);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold Point 2", 50, 50, 0, FOLD_POINT2_DISK_ID);
+    
+    // Separate lines, or a polyline continuing from Fold Point 2
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POPUP("Fold Layout", 2, FOLD_LAYOUT_SEPARATE, "Separate Lines|Connected Polyline", FOLD_LAYOUT_DISK_ID);
+    
+    // ==================== ADDITIONAL FOLDS (nested in Fold) ====================
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_TOPIC("Additional Folds", TOPIC_FOLD_EXTRA_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX("Fold 2 Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD2_AMOUNT_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 2 Start", 50, 50, 0, FOLD2_START_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 2 End", 50, 50, 0, FOLD2_END_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX("Fold 3 Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD3_AMOUNT_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 3 Start", 50, 50, 0, FOLD3_START_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 3 End", 50, 50, 0, FOLD3_END_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX("Fold 4 Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD4_AMOUNT_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 4 Start", 50, 50, 0, FOLD4_START_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 4 End", 50, 50, 0, FOLD4_END_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX("Fold 5 Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD5_AMOUNT_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 5 Start", 50, 50, 0, FOLD5_START_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 5 End", 50, 50, 0, FOLD5_END_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX("Fold 6 Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD6_AMOUNT_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 6 Start", 50, 50, 0, FOLD6_START_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_POINT("Fold 6 End", 50, 50, 0, FOLD6_END_DISK_ID);
+    
+    AEFX_CLR_STRUCT(def);
+    PF_END_TOPIC(TOPIC_FOLD_EXTRA_END_DISK_ID);
     
     // ==================== ADVANCED SETTINGS (nested in Fold) ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Advanced Settings", PARAM_TOPIC_FOLD_ADVANCED);
+    PF_ADD_TOPIC("Advanced Settings", TOPIC_FOLD_ADVANCED_DISK_ID);
     
     // Main fold line controls
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fold Line Roughness", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_LINE_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_LINE_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fold Line Rough Scale", 5.0, 200.0, 5.0, 200.0, 85.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_LINE_ROUGH_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_LINE_ROUGH_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Fold Line Width", 0.5, 10.0, 0.5, 10.0, 0.5,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_LINE_WIDTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_LINE_WIDTH_DISK_ID);
     
     // Side A controls
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side A Width", 1.0, 50.0, 1.0, 50.0, 1.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_A_WIDTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_A_WIDTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side A Roughness", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_A_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_A_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side A Rough Scale", 5.0, 200.0, 5.0, 200.0, 200.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_A_ROUGH_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_A_ROUGH_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side A Jaggedness", 0.0, 100.0, 0.0, 100.0, 20.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_A_JAGGEDNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_A_JAGGEDNESS_DISK_ID);
     
     // Side B controls
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side B Width", 1.0, 50.0, 1.0, 50.0, 1.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_B_WIDTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_B_WIDTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side B Roughness", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_B_ROUGHNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_B_ROUGHNESS_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side B Rough Scale", 5.0, 200.0, 5.0, 200.0, 40.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_B_ROUGH_SCALE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_B_ROUGH_SCALE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Side B Jaggedness", 0.0, 100.0, 0.0, 100.0, 20.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SIDE_B_JAGGEDNESS);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SIDE_B_JAGGEDNESS_DISK_ID);
     
     // Perpendicular crack lines
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Amount", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Length", 5.0, 800.0, 5.0, 800.0, 200.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_LENGTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_LENGTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Length Variability", 0.0, 100.0, 0.0, 100.0, 100.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_LENGTH_VAR);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_LENGTH_VAR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Density", 0.0, 100.0, 0.0, 100.0, 5.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_DENSITY);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_DENSITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Branching", 0.0, 100.0, 0.0, 100.0, 22.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_BRANCHING);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_BRANCHING_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Angle", 0.0, 90.0, 0.0, 90.0, 90.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_ANGLE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_ANGLE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Crack Angle Variability", 0.0, 90.0, 0.0, 90.0, 20.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_CRACK_ANGLE_VAR);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_CRACK_ANGLE_VAR_DISK_ID);
     
     // Shadow A controls (side A - typically highlight/white)
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow A Opacity", 0.0, 100.0, 0.0, 100.0, 10.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_A_OPACITY);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_A_OPACITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow A Length", 5.0, 300.0, 5.0, 300.0, 250.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_A_LENGTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_A_LENGTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow A Variability", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_A_VARIABILITY);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_A_VARIABILITY_DISK_ID);
     
     // Shadow A Color - black
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Shadow A Color", 0, 0, 0, PARAM_FOLD_SHADOW_A_COLOR);
+    PF_ADD_COLOR("Shadow A Color", 0, 0, 0, FOLD_SHADOW_A_COLOR_DISK_ID);
     
     // Shadow B controls (side B - typically shadow/black)
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow B Opacity", 0.0, 100.0, 0.0, 100.0, 10.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_B_OPACITY);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_B_OPACITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow B Length", 5.0, 300.0, 5.0, 300.0, 250.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_B_LENGTH);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_B_LENGTH_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Shadow B Variability", 0.0, 100.0, 0.0, 100.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_FOLD_SHADOW_B_VARIABILITY);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, FOLD_SHADOW_B_VARIABILITY_DISK_ID);
     
     // Shadow B Color - black (shadow)
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Shadow B Color", 0, 0, 0, PARAM_FOLD_SHADOW_B_COLOR);
+    PF_ADD_COLOR("Shadow B Color", 0, 0, 0, FOLD_SHADOW_B_COLOR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_FOLD_ADVANCED_END);
+    PF_END_TOPIC(TOPIC_FOLD_ADVANCED_END_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_FOLD_END);
+    PF_END_TOPIC(TOPIC_FOLD_END_DISK_ID);
     
     // ==================== GRUNGE ====================
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_TOPIC("Grunge Effects", PARAM_TOPIC_GRUNGE);
+    PF_ADD_TOPIC("Grunge Effects", TOPIC_GRUNGE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Dirt Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_DIRT_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, DIRT_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Dirt Size", 1.0, 50.0, 1.0, 50.0, 10.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_DIRT_SIZE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, DIRT_SIZE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Dirt Opacity", 0.0, 100.0, 0.0, 100.0, 40.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_DIRT_OPACITY);
+        PF_Precision_TENTHS, 0, 0, DIRT_OPACITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_SLIDER("Dirt Seed", 0, 30000, 0, 30000, 5000, PARAM_DIRT_SEED);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_SLIDER("Dirt Seed", 0, 30000, 0, 30000, 5000, DIRT_SEED_DISK_ID);
     
     // Dirt Color - brownish
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Dirt Color", 80, 60, 40, PARAM_DIRT_COLOR);
+    PF_ADD_COLOR("Dirt Color", 80, 60, 40, DIRT_COLOR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Smudge Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_SMUDGE_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, SMUDGE_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Smudge Size", 10.0, 200.0, 10.0, 200.0, 50.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_SMUDGE_SIZE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, SMUDGE_SIZE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Smudge Opacity", 0.0, 100.0, 0.0, 100.0, 20.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_SMUDGE_OPACITY);
+        PF_Precision_TENTHS, 0, 0, SMUDGE_OPACITY_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_SLIDER("Smudge Seed", 0, 30000, 0, 30000, 8000, PARAM_SMUDGE_SEED);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_SLIDER("Smudge Seed", 0, 30000, 0, 30000, 8000, SMUDGE_SEED_DISK_ID);
     
     // Smudge Color - grayish
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Smudge Color", 100, 95, 85, PARAM_SMUDGE_COLOR);
+    PF_ADD_COLOR("Smudge Color", 100, 95, 85, SMUDGE_COLOR_DISK_ID);
     
     // Dust particles
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Dust Amount", 0.0, 100.0, 0.0, 100.0, 0.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_DUST_AMOUNT);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, DUST_AMOUNT_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
     PF_ADD_FLOAT_SLIDERX("Dust Size", 0.5, 10.0, 0.5, 10.0, 2.0,
-        PF_Precision_TENTHS, 0, 0, PARAM_DUST_SIZE);
+        PF_Precision_TENTHS, 0, PF_ParamFlag_SUPERVISE, DUST_SIZE_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_ADD_SLIDER("Dust Seed", 0, 30000, 0, 30000, 9999, PARAM_DUST_SEED);
+    def.flags = PF_ParamFlag_SUPERVISE;
+    PF_ADD_SLIDER("Dust Seed", 0, 30000, 0, 30000, 9999, DUST_SEED_DISK_ID);
     
     // Dust Color - white
     AEFX_CLR_STRUCT(def);
-    PF_ADD_COLOR("Dust Color", 255, 255, 255, PARAM_DUST_COLOR);
+    PF_ADD_COLOR("Dust Color", 255, 255, 255, DUST_COLOR_DISK_ID);
     
     AEFX_CLR_STRUCT(def);
-    PF_END_TOPIC(PARAM_TOPIC_GRUNGE_END);
+    PF_END_TOPIC(TOPIC_GRUNGE_END_DISK_ID);
     
     out_data->num_params = PARAM_NUM_PARAMS;
     
     return err;
 }
 
+// ============================================================
+// PIXEL FORMATS
+// ============================================================
+
+// Channel type and normalisation for each world format. Channels are read as
+// 0.0-1.0 floats; 16-bit AE pixels top out at 32768, not 65535.
+template<typename PixelT>
+struct PixelTraits;
+
+template<>
+struct PixelTraits<PF_Pixel8> {
+    typedef A_u_char Channel;
+    static float toUnit(A_u_char c) { return c / 255.0f; }
+    static A_u_char fromUnit(float v) { return (A_u_char)(v * 255.0f); }
+};
+
+template<>
+struct PixelTraits<PF_Pixel16> {
+    typedef A_u_short Channel;
+    static float toUnit(A_u_short c) { return c / 32768.0f; }
+    static A_u_short fromUnit(float v) { return (A_u_short)(v * 32768.0f); }
+};
+
+template<>
+struct PixelTraits<PF_PixelFloat> {
+    typedef PF_FpShort Channel;
+    static float toUnit(PF_FpShort c) { return c; }
+    static PF_FpShort fromUnit(float v) { return v; }
+};
+
+template<typename PixelT>
+inline PixelT* worldRow(PF_EffectWorld* world, int y) {
+    return (PixelT*)((char*)world->data + y * world->rowbytes);
+}
+
+// ============================================================
+// ABORT AND PROGRESS
+// ============================================================
+
+// Shortest gap between two calls to the host's abort or progress callback
+#define RENDER_POLL_MICROSECONDS    2000
+
+// Work done in a render, in pixels, and whether the host still wants it.
+// Any render thread may check, but only the thread that started the render
+// asks the host, and at most every RENDER_POLL_MICROSECONDS: AE's callbacks
+// are not safe from TilePool workers or the strip producer. The others only
+// count their pixels and read the last answer, so once the host cancels every
+// check fails at once and bands already running stop after their current band.
+class RenderProgress {
+public:
+    // Renders not reporting progress still poll PF_ABORT
+    RenderProgress(PF_InData* in_data, bool reportProgress)
+        : in_data(in_data), report(reportProgress), hostThread(std::this_thread::get_id()),
+          total(1), done(0), lastPoll(0), hostErr(PF_Err_NONE) {}
+
+    void setTotal(int64_t pixels) { total = safeMax((int64_t)1, pixels); }
+
+    // False once the render has been cancelled
+    bool alive() { return advance(0); }
+
+    // Counts pixels finished; false once the render has been cancelled
+    bool advance(int64_t pixels) {
+        if (pixels) done += pixels;
+        if (hostErr.load(std::memory_order_relaxed) != PF_Err_NONE) return false;
+        if (std::this_thread::get_id() != hostThread) return true;
+
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (now - lastPoll < RENDER_POLL_MICROSECONDS) return true;
+        lastPoll = now;
+
+        // PF_PROGRESS reports a cancel just as PF_ABORT does
+        PF_Err err = report ?
+            PF_PROGRESS(in_data, (A_long)(safeMin(done.load(), total) * 1000 / total), 1000) :
+            PF_ABORT(in_data);
+        if (err != PF_Err_NONE) {
+            hostErr = err;
+            return false;
+        }
+        return true;
+    }
+
+    // PF_Interrupt_CANCEL or the host's error once cancelled
+    PF_Err result() const { return hostErr.load(); }
+
+private:
+    PF_InData* in_data;
+    bool report;
+    std::thread::id hostThread;
+    int64_t total;
+    std::atomic<int64_t> done;
+    int64_t lastPoll;                   // only touched by the host thread
+    std::atomic<PF_Err> hostErr;
+};
+
+// ============================================================
+// ROW BANDS
+// ============================================================
+
+template<typename Fn>
+struct BandJob {
+    Fn* fn;
+
+    static PF_Err run(void* refcon, A_long threadIndex, A_long band, A_long /*bandCount*/) {
+        (*static_cast<BandJob*>(refcon)->fn)((int)band, (int)threadIndex);
+        return PF_Err_NONE;
+    }
+};
+
+// The host's iterate suite when it offers iterate_generic, otherwise null.
+// Renders off the host's threads carry no suites.
+inline PF_Iterate8Suite2* hostIterateSuite(PF_InData* in_data) {
+    if (!in_data || !in_data->pica_basicP) return nullptr;
+    PF_Iterate8Suite2* iterateSuite = nullptr;
+    try {
+        AEGP_SuiteHandler suites(in_data->pica_basicP);
+        iterateSuite = suites.Iterate8Suite2();
+    } catch (A_Err&) {
+        iterateSuite = nullptr;
+    }
+    return (iterateSuite && iterateSuite->iterate_generic) ? iterateSuite : nullptr;
+}
+
+// Set on a thread whose renders hand their bands to the TilePool threads one
+// at a time, whichever is free taking the next, as iterate_generic does. The
+// calibration runs off the host's threads and times bandRows this way.
+inline bool& emulateIterateGeneric() {
+    static thread_local bool emulate = false;
+    return emulate;
+}
+
+// Whether forEachBand spreads bands as iterate_generic does
+inline bool genericBands(PF_InData* in_data) {
+    return emulateIterateGeneric() || hostIterateSuite(in_data) != nullptr;
+}
+
+// Calls fn(band, thread) once for every band in [0, bandCount), spread over
+// AE's worker threads with iterate_generic, or over the plugin's own TilePool
+// when the host has no iterate suite. Bands must only write what they own;
+// thread tells apart the threads running at once, for per-thread scratch.
+// Without in_data the bands run in order on the calling thread.
+template<typename Fn>
+PF_Err forEachBand(PF_InData* in_data, int bandCount, Fn fn) {
+    if (bandCount <= 0) return PF_Err_NONE;
+    
+    if (!in_data) {
+        for (int band = 0; band < bandCount; band++) fn(band, 0);
+        return PF_Err_NONE;
+    }
+
+    PF_Iterate8Suite2* iterateSuite = bandCount > 1 ? hostIterateSuite(in_data) : nullptr;
+    if (iterateSuite) {
+        BandJob<Fn> job = { &fn };
+        return iterateSuite->iterate_generic(bandCount, &job, BandJob<Fn>::run);
+    }
+
+    if (emulateIterateGeneric()) {
+        // One task per thread, each taking bands until none are left
+        std::atomic<int> next(0);
+        TilePool::instance().run(TilePool::instance().threadCount(), [&](int, int thread) {
+            for (int band = next++; band < bandCount; band = next++) fn(band, thread);
+        });
+        return PF_Err_NONE;
+    }
+
+    TilePool::instance().run(bandCount, fn);
+    return PF_Err_NONE;
+}
+
+// Splits rows [yStart, yEnd) into bands of the tuned height and calls
+// fn(y0, y1, thread) for each
+template<typename Fn>
+PF_Err forEachRowBand(PF_InData* in_data, int yStart, int yEnd, Fn fn) {
+    int bandRows = RenderTuner::instance().bandRows();
+    int bandCount = (yEnd - yStart + bandRows - 1) / bandRows;
+    return forEachBand(in_data, bandCount, [&](int band, int thread) {
+        int y0 = yStart + band * bandRows;
+        fn(y0, safeMin(yEnd, y0 + bandRows), thread);
+    });
+}
+
 // ============================================================
 // DISTANCE FIELD
 // ============================================================
 
+// Signed chamfer distance to the alpha edge for a w by h layer. A field may
+// hold only rows [top, top + rows) of the layer; rows outside it read as
+// infinitely far. A window is exact for every pixel closer to the edge than
+// its distance to the window border, since no shorter path leaves the window.
+//
+// The planes live in the render's arena and start uninitialised; building
+// the field writes every pixel of the window.
 class DistanceField {
 public:
-    std::vector<float> distances;
-    std::vector<float> gradX, gradY;
+    float* distances;
+    float* gradX;
+    float* gradY;
     int width, height;
+    int top, rows;
+    int capacityRows;
+    
+    DistanceField(FrameArena& arena, int w, int h) : width(w), height(h), top(0), rows(h), capacityRows(h) {
+        allocate(arena);
+    }
+    
+    // Room for windows of up to windowRows rows, placed with setWindow()
+    DistanceField(FrameArena& arena, int w, int h, int windowRows)
+        : width(w), height(h), top(0), rows(windowRows), capacityRows(windowRows)
+    {
+        allocate(arena);
+    }
     
-    DistanceField(int w, int h) : width(w), height(h), 
-        distances(w * h, 1e10f), gradX(w * h, 0.0f), gradY(w * h, 0.0f) {}
+    void setWindow(int windowTop, int windowRows) {
+        top = windowTop;
+        rows = safeMin(windowRows, capacityRows);
+    }
     
     float getDist(int x, int y) const {
-        if (x < 0 || x >= width || y < 0 || y >= height) return 1e10f;
-        return distances[y * width + x];
+        if (x < 0 || x >= width || y < top || y >= top + rows) return 1e10f;
+        return distances[(size_t)(y - top) * width + x];
     }
     
     void setDist(int x, int y, float d) {
-        if (x >= 0 && x < width && y >= 0 && y < height)
-            distances[y * width + x] = d;
+        if (x >= 0 && x < width && y >= top && y < top + rows)
+            distances[(size_t)(y - top) * width + x] = d;
     }
     
     void getGradient(int x, int y, float& gx, float& gy) const {
-        if (x < 0 || x >= width || y < 0 || y >= height) { gx = 0; gy = 0; return; }
-        gx = gradX[y * width + x];
-        gy = gradY[y * width + x];
+        if (x < 0 || x >= width || y < top || y >= top + rows) { gx = 0; gy = 0; return; }
+        gx = gradX[(size_t)(y - top) * width + x];
+        gy = gradY[(size_t)(y - top) * width + x];
     }
     
-    // Helper to get alpha value normalized to 0.0-1.0 regardless of bit depth
-    inline double getAlpha(PF_EffectWorld* layer, int x, int y, A_long pixelBytes) {
+    // Columns [x0, x1) of rows [y0, y1)
+    struct Region {
+        int x0, y0, x1, y1;
+    };
+    
+    // Helper to get alpha value normalized to 0.0-1.0
+    template<typename PixelT>
+    static double getAlpha(PF_EffectWorld* layer, int x, int y) {
         if (x < 0 || x >= layer->width || y < 0 || y >= layer->height) return 0.0;
-        
-        if (pixelBytes >= 16) {
-            // 32-bit float
-            PF_PixelFloat* row = (PF_PixelFloat*)((char*)layer->data + y * layer->rowbytes);
-            return row[x].alpha;
-        } else if (pixelBytes >= 8) {
-            // 16-bit
-            PF_Pixel16* row = (PF_Pixel16*)((char*)layer->data + y * layer->rowbytes);
-            return row[x].alpha / 32768.0;
-        } else {
-            // 8-bit
-            PF_Pixel8* row = (PF_Pixel8*)((char*)layer->data + y * layer->rowbytes);
-            return row[x].alpha / 255.0;
-        }
+        return PixelTraits<PixelT>::toUnit(worldRow<PixelT>(layer, y)[x].alpha);
     }
     
-    void buildFromLayerGeneric(PF_EffectWorld* layer, A_long pixelBytes) {
+    // Seeding and gradients only touch their own rows and run in bands; the
+    // two chamfer sweeps carry distances across rows and stay sequential. A
+    // cancelled build stops part way, so check progress before reading it.
+    template<typename PixelT>
+    void buildFromPixels(PF_InData* in_data, PF_EffectWorld* layer, RenderProgress& progress) {
+        Region window = { 0, top, width, top + rows };
+        forEachRowBand(in_data, top, top + rows, [&](int y0, int y1, int) {
+            if (progress.alive()) seedRows<PixelT>(layer, window, y0, y1);
+        });
+        if (!progress.alive()) return;
+        sweep(window, progress);
+        forEachRowBand(in_data, top, top + rows, [&](int y0, int y1, int) {
+            if (!progress.alive()) return;
+            gradientRows(window, y0, y1);
+            progress.advance((int64_t)width * (y1 - y0));
+        });
+    }
+    
+    // Builds only the given regions of the window, which must not overlap.
+    // Seeding and gradients still run in row bands, and the sweeps of
+    // different regions run side by side. Pixels outside every region are
+    // left unset and must not be read.
+    template<typename PixelT>
+    void buildRegions(PF_InData* in_data, PF_EffectWorld* layer, const std::vector<Region>& regions,
+        RenderProgress& progress)
+    {
+        forEachRowBand(in_data, top, top + rows, [&](int y0, int y1, int) {
+            if (!progress.alive()) return;
+            for (const Region& region : regions) {
+                int r0 = safeMax(y0, region.y0), r1 = safeMin(y1, region.y1);
+                if (r0 < r1) seedRows<PixelT>(layer, region, r0, r1);
+            }
+        });
+        forEachBand(in_data, (int)regions.size(), [&](int i, int) {
+            if (progress.alive()) sweep(regions[i], progress);
+        });
+        forEachRowBand(in_data, top, top + rows, [&](int y0, int y1, int) {
+            if (!progress.alive()) return;
+            for (const Region& region : regions) {
+                int r0 = safeMax(y0, region.y0), r1 = safeMin(y1, region.y1);
+                if (r0 >= r1) continue;
+                gradientRows(region, r0, r1);
+                progress.advance((int64_t)(region.x1 - region.x0) * (r1 - r0));
+            }
+        });
+    }
+    
+    // Edge pixels start at zero, everything else at +/- infinity
+    template<typename PixelT>
+    void seedRows(PF_EffectWorld* layer, const Region& region, int yStart, int yEnd) {
         double threshold = 0.5;  // Alpha threshold for inside/outside
         
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                bool inside = getAlpha(layer, x, y, pixelBytes) > threshold;
+        for (int y = yStart; y < yEnd; y++) {
+            for (int x = region.x0; x < region.x1; x++) {
+                bool inside = getAlpha<PixelT>(layer, x, y) > threshold;
                 bool isEdge = false;
                 
-                if (x > 0 && (getAlpha(layer, x-1, y, pixelBytes) > threshold) != inside) isEdge = true;
-                if (x < width-1 && (getAlpha(layer, x+1, y, pixelBytes) > threshold) != inside) isEdge = true;
-                if (y > 0 && (getAlpha(layer, x, y-1, pixelBytes) > threshold) != inside) isEdge = true;
-                if (y < height-1 && (getAlpha(layer, x, y+1, pixelBytes) > threshold) != inside) isEdge = true;
+                if (x > 0 && (getAlpha<PixelT>(layer, x-1, y) > threshold) != inside) isEdge = true;
+                if (x < width-1 && (getAlpha<PixelT>(layer, x+1, y) > threshold) != inside) isEdge = true;
+                if (y > 0 && (getAlpha<PixelT>(layer, x, y-1) > threshold) != inside) isEdge = true;
+                if (y < height-1 && (getAlpha<PixelT>(layer, x, y+1) > threshold) != inside) isEdge = true;
                 
                 setDist(x, y, isEdge ? 0.0f : (inside ? 1e10f : -1e10f));
             }
         }
-        
+    }
+    
+    enum { kSweepPollRows = 32 };
+    
+    // Chamfer paths stay inside the region, so no pixel outside it is read
+    void sweep(const Region& r, RenderProgress& progress) {
         // Forward pass
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
+        for (int y = r.y0; y < r.y1; y++) {
+            if ((y - r.y0) % kSweepPollRows == 0 && !progress.alive()) return;
+            for (int x = r.x0; x < r.x1; x++) {
                 float current = getDist(x, y);
                 float sign = current >= 0 ? 1.0f : -1.0f;
                 float absCurrent = fabs(current);
                 
-                if (x > 0 && fabs(getDist(x-1, y)) + 1.0f < absCurrent) 
+                if (x > r.x0 && fabs(getDist(x-1, y)) + 1.0f < absCurrent) 
                     absCurrent = fabs(getDist(x-1, y)) + 1.0f;
-                if (y > 0 && fabs(getDist(x, y-1)) + 1.0f < absCurrent) 
+                if (y > r.y0 && fabs(getDist(x, y-1)) + 1.0f < absCurrent) 
                     absCurrent = fabs(getDist(x, y-1)) + 1.0f;
-                if (x > 0 && y > 0 && fabs(getDist(x-1, y-1)) + 1.414f < absCurrent)
+                if (x > r.x0 && y > r.y0 && fabs(getDist(x-1, y-1)) + 1.414f < absCurrent)
                     absCurrent = fabs(getDist(x-1, y-1)) + 1.414f;
-                if (x < width-1 && y > 0 && fabs(getDist(x+1, y-1)) + 1.414f < absCurrent)
+                if (x < r.x1-1 && y > r.y0 && fabs(getDist(x+1, y-1)) + 1.414f < absCurrent)
                     absCurrent = fabs(getDist(x+1, y-1)) + 1.414f;
                 
                 setDist(x, y, absCurrent * sign);
@@ -656,41 +1079,59 @@ public:
         }
         
         // Backward pass
-        for (int y = height - 1; y >= 0; y--) {
-            for (int x = width - 1; x >= 0; x--) {
+        for (int y = r.y1 - 1; y >= r.y0; y--) {
+            if ((y - r.y0) % kSweepPollRows == 0 && !progress.alive()) return;
+            for (int x = r.x1 - 1; x >= r.x0; x--) {
                 float current = getDist(x, y);
                 float sign = current >= 0 ? 1.0f : -1.0f;
                 float absCurrent = fabs(current);
                 
-                if (x < width-1 && fabs(getDist(x+1, y)) + 1.0f < absCurrent)
+                if (x < r.x1-1 && fabs(getDist(x+1, y)) + 1.0f < absCurrent)
                     absCurrent = fabs(getDist(x+1, y)) + 1.0f;
-                if (y < height-1 && fabs(getDist(x, y+1)) + 1.0f < absCurrent)
+                if (y < r.y1-1 && fabs(getDist(x, y+1)) + 1.0f < absCurrent)
                     absCurrent = fabs(getDist(x, y+1)) + 1.0f;
-                if (x < width-1 && y < height-1 && fabs(getDist(x+1, y+1)) + 1.414f < absCurrent)
+                if (x < r.x1-1 && y < r.y1-1 && fabs(getDist(x+1, y+1)) + 1.414f < absCurrent)
                     absCurrent = fabs(getDist(x+1, y+1)) + 1.414f;
-                if (x > 0 && y < height-1 && fabs(getDist(x-1, y+1)) + 1.414f < absCurrent)
+                if (x > r.x0 && y < r.y1-1 && fabs(getDist(x-1, y+1)) + 1.414f < absCurrent)
                     absCurrent = fabs(getDist(x-1, y+1)) + 1.414f;
                 
                 setDist(x, y, absCurrent * sign);
             }
         }
         
-        // Compute gradients
-        for (int y = 1; y < height - 1; y++) {
-            for (int x = 1; x < width - 1; x++) {
+    }
+    
+    // Pixels on the region border have no central difference and get a zero gradient
+    void gradientRows(const Region& r, int yStart, int yEnd) {
+        int n = r.x1 - r.x0;
+        for (int y = yStart; y < yEnd; y++) {
+            float* rowX = gradX + (size_t)(y - top) * width + r.x0;
+            float* rowY = gradY + (size_t)(y - top) * width + r.x0;
+            if (y == r.y0 || y == r.y1 - 1 || n < 3) {
+                memset(rowX, 0, n * sizeof(float));
+                memset(rowY, 0, n * sizeof(float));
+                continue;
+            }
+            rowX[0] = rowY[0] = 0.0f;
+            rowX[n - 1] = rowY[n - 1] = 0.0f;
+            for (int i = 1; i < n - 1; i++) {
+                int x = r.x0 + i;
                 float gx = getDist(x+1, y) - getDist(x-1, y);
                 float gy = getDist(x, y+1) - getDist(x, y-1);
                 float len = sqrt(gx*gx + gy*gy);
                 if (len > 0.001f) { gx /= len; gy /= len; }
-                gradX[y * width + x] = gx;
-                gradY[y * width + x] = gy;
+                rowX[i] = gx;
+                rowY[i] = gy;
             }
         }
     }
     
-    void buildFromLayer(PF_EffectWorld* layer) {
-        // Default to 8-bit behavior for legacy Render function
-        buildFromLayerGeneric(layer, 4);
+private:
+    void allocate(FrameArena& arena) {
+        size_t n = (size_t)width * capacityRows;
+        distances = arena.allocArray<float>(n);
+        gradX = arena.allocArray<float>(n);
+        gradY = arena.allocArray<float>(n);
     }
 };
 
@@ -734,17 +1175,18 @@ inline double ridgedMultifractal(double x, double y, int seed, int octaves) {
     return sum;
 }
 
-inline double calcEdgeDisplacement(double px, double py, int seed,
-    double roughness, double roughScale, double jaggedness, double notchDepth, double scale)
-{
-    double disp = 0;
+// Large-scale roughness, the slowly varying part of the edge displacement
+inline double edgeRoughness(double px, double py, int seed, double roughness, double roughScale, double scale) {
+    if (roughness <= 0) return 0;
     double scaledRoughScale = roughScale * scale;
-    
-    if (roughness > 0) {
-        double n = fbm2D(px / scaledRoughScale, py / scaledRoughScale, seed, 4, 0.5);
-        disp += n * roughness * scale;
-    }
-    
+    double n = fbm2D(px / scaledRoughScale, py / scaledRoughScale, seed, 4, 0.5);
+    return n * roughness * scale;
+}
+
+// Adds the jaggedness and notches to a roughness displacement
+inline double edgeDetail(double px, double py, int seed, double jaggedness, double notchDepth, double scale,
+    double disp)
+{
     if (jaggedness > 0) {
         double jag = ridgedMultifractal(px / (20.0 * scale), py / (20.0 * scale), seed + 100, 4);
         disp += (jag - 0.5) * jaggedness * 0.8 * scale;
@@ -763,6 +1205,33 @@ inline double calcEdgeDisplacement(double px, double py, int seed,
     return disp;
 }
 
+inline double calcEdgeDisplacement(double px, double py, int seed,
+    double roughness, double roughScale, double jaggedness, double notchDepth, double scale)
+{
+    return edgeDetail(px, py, seed, jaggedness, notchDepth, scale,
+        edgeRoughness(px, py, seed, roughness, roughScale, scale));
+}
+
+// Range calcEdgeDisplacement can take anywhere, from the ranges of its terms:
+// fbm in [-1, 1], ridged multifractal in [0, 1.875], spike in [0, 0.9] and
+// notch in [0, 0.3]
+inline void edgeDisplacementBounds(double roughness, double jaggedness, double notchDepth, double scale,
+    double& lo, double& hi)
+{
+    lo = hi = 0;
+    if (roughness > 0) {
+        lo -= roughness * scale;
+        hi += roughness * scale;
+    }
+    if (jaggedness > 0) {
+        lo -= 0.5 * jaggedness * 0.8 * scale;
+        hi += 1.375 * jaggedness * 0.8 * scale + 0.9 * jaggedness * 0.5 * scale;
+    }
+    if (notchDepth > 0) {
+        hi += 0.3 * notchDepth * scale;
+    }
+}
+
 // ============================================================
 // FOLD MARK FUNCTIONS
 // ============================================================
@@ -986,82 +1455,220 @@ inline double perpendicularCracks(double px, double py, int seed,
     return crackStrength;
 }
 
+// Fold parameters shared by every crease (raw slider values, unscaled)
+struct FoldSettings {
+    double lineRoughness, lineRoughScale, lineWidth;
+    double sideAWidth, sideARoughness, sideARoughScale, sideAJagged, sideASoftness;
+    double sideBWidth, sideBRoughness, sideBRoughScale, sideBJagged, sideBSoftness;
+    double crackAmount, crackLength, crackLengthVar, crackDensity, crackBranching;
+    double crackAngle, crackAngleVar;
+    double shadowAOpacity, shadowALength, shadowAVariability;
+    double shadowBOpacity, shadowBLength, shadowBVariability;
+    double scale;
+    
+    void addToKey(FieldKey& key) const {
+        key.add(lineRoughness).add(lineRoughScale).add(lineWidth);
+        key.add(sideAWidth).add(sideARoughness).add(sideARoughScale).add(sideAJagged).add(sideASoftness);
+        key.add(sideBWidth).add(sideBRoughness).add(sideBRoughScale).add(sideBJagged).add(sideBSoftness);
+        key.add(crackAmount).add(crackLength).add(crackLengthVar).add(crackDensity).add(crackBranching);
+        key.add(crackAngle).add(crackAngleVar);
+        key.add(shadowAOpacity).add(shadowALength).add(shadowAVariability);
+        key.add(shadowBOpacity).add(shadowBLength).add(shadowBVariability);
+        key.add(scale);
+    }
+};
+
+// Per-render fold geometry. Everything in the crease that depends only on the
+// position along the line (wobble, side edge displacement, shadow variability)
+// is baked into 1D tables here, and the region the fold can touch is reduced to
+// an oriented box so pixels outside it skip the crease entirely.
+struct FoldProfile {
+    bool active;
+    int seed;
+    FoldSettings s;
+    
+    // Line frame
+    double x1, y1, x2, y2;
+    double ndx, ndy, lineLen;
+    
+    // Oriented bounding box in line space (alongLine units and pixels across)
+    double alongMin, alongMax, perpReach;
+    // Axis-aligned bounds of that box for a cheap first reject
+    double minX, minY, maxX, maxY;
+    
+    // 1D lookup tables sampled along the line
+    double lutStart, lutInvStep;
+    int lutSize;
+    std::vector<float> wobble;      // main line wobble
+    std::vector<float> lineVar;     // main line intensity variation
+    std::vector<float> edgeA, edgeB;        // side edge displacement
+    std::vector<float> shadowVarA, shadowVarB;  // shadow length multiplier
+    
+    FoldProfile() : active(false), seed(0), lutSize(0) {}
+    
+    void build(int foldSeed, double fx1, double fy1, double fx2, double fy2, const FoldSettings& settings) {
+        active = false;
+        seed = foldSeed;
+        s = settings;
+        x1 = fx1; y1 = fy1; x2 = fx2; y2 = fy2;
+        
+        double dx = x2 - x1;
+        double dy = y2 - y1;
+        lineLen = sqrt(dx*dx + dy*dy);
+        if (lineLen < 1.0) return;
+        
+        ndx = dx / lineLen;
+        ndy = dy / lineLen;
+        
+        // End fade is zero outside [-0.1, 1.1], so nothing beyond it is visible
+        alongMin = -0.1;
+        alongMax = 1.1;
+        
+        // Two samples per pixel of fold length
+        double step = 0.5 / lineLen;
+        lutStart = alongMin;
+        lutInvStep = 1.0 / step;
+        lutSize = (int)ceil((alongMax - alongMin) / step) + 2;
+        
+        wobble.resize(lutSize);
+        lineVar.resize(lutSize);
+        edgeA.resize(lutSize);
+        edgeB.resize(lutSize);
+        shadowVarA.resize(lutSize);
+        shadowVarB.resize(lutSize);
+        
+        double scale = s.scale;
+        double maxWobble = 0;
+        
+        for (int i = 0; i < lutSize; i++) {
+            double alongLine = lutStart + i * step;
+            double coord = alongLine * lineLen;
+            
+            // Add imperfections to the fold line itself - erratic wobble
+            double lineWobble = 0;
+            if (s.lineRoughness > 0) {
+                double scaledLineRoughScale = s.lineRoughScale * scale;
+                lineWobble = fbm2D(coord / scaledLineRoughScale, seed * 0.01, seed + 1000, 3, 0.6);
+                lineWobble += valueNoise2D(coord / (scaledLineRoughScale * 0.3), seed * 0.01, seed + 1100) * 0.4;
+                double sharpTurn = valueNoise2D(coord / (scaledLineRoughScale * 0.5), seed * 0.02, seed + 1200);
+                sharpTurn = sharpTurn > 0.7 ? (sharpTurn - 0.7) * 3.0 : (sharpTurn < 0.3 ? (0.3 - sharpTurn) * -3.0 : 0);
+                lineWobble += sharpTurn * 0.3;
+                lineWobble *= s.lineRoughness * scale * 0.06;
+            }
+            wobble[i] = (float)lineWobble;
+            maxWobble = safeMax(maxWobble, fabs(lineWobble));
+            
+            double lv = fbm2D(alongLine * 20.0, seed * 0.1, seed + 1500, 2, 0.5);
+            lineVar[i] = (float)(lv * 0.4 + 0.6);
+            
+            edgeA[i] = (float)foldEdgeDisplacement(alongLine, lineLen, seed + 2000,
+                s.sideARoughness, s.sideARoughScale, s.sideAJagged, scale);
+            edgeB[i] = (float)foldEdgeDisplacement(alongLine, lineLen, seed + 3000,
+                s.sideBRoughness, s.sideBRoughScale, s.sideBJagged, scale);
+            
+            double varA = 1.0;
+            if (s.shadowAVariability > 0) {
+                double varNoise = fbm2D(alongLine * 8.0, seed * 0.1, seed + 6000, 2, 0.5);
+                varNoise = varNoise * 0.5 + 0.5;
+                varA = 1.0 - s.shadowAVariability * (1.0 - varNoise);
+            }
+            shadowVarA[i] = (float)varA;
+            
+            double varB = 1.0;
+            if (s.shadowBVariability > 0) {
+                double varNoise = fbm2D(alongLine * 8.0, seed * 0.1, seed + 7000, 2, 0.5);
+                varNoise = varNoise * 0.5 + 0.5;
+                varB = 1.0 - s.shadowBVariability * (1.0 - varNoise);
+            }
+            shadowVarB[i] = (float)varB;
+        }
+        
+        // The crease, its side cracks, shadows and perpendicular cracks are all cut
+        // off at maxDist from the wobbling line, which also caps the crack length
+        double maxDist = safeMax(s.sideAWidth + s.shadowALength, s.sideBWidth + s.shadowBLength) * scale * 1.2;
+        perpReach = maxDist + maxWobble + 1.0;
+        
+        double ax = x1 + dx * alongMin, ay = y1 + dy * alongMin;
+        double bx = x1 + dx * alongMax, by = y1 + dy * alongMax;
+        double ox = fabs(ndy) * perpReach, oy = fabs(ndx) * perpReach;
+        minX = safeMin(ax, bx) - ox;
+        maxX = safeMax(ax, bx) + ox;
+        minY = safeMin(ay, by) - oy;
+        maxY = safeMax(ay, by) + oy;
+        
+        active = true;
+    }
+    
+    inline double lookup(const std::vector<float>& table, double alongLine) const {
+        double f = (alongLine - lutStart) * lutInvStep;
+        if (f <= 0) return table[0];
+        int i = (int)f;
+        if (i >= lutSize - 1) return table[lutSize - 1];
+        double t = f - i;
+        return table[i] + (table[i + 1] - table[i]) * t;
+    }
+    
+    // True if the point can receive any crease, crack or shadow
+    inline bool contains(double px, double py) const {
+        if (!active) return false;
+        if (px < minX || px > maxX || py < minY || py > maxY) return false;
+        double toPx = px - x1;
+        double toPy = py - y1;
+        double alongLine = (toPx * ndx + toPy * ndy) / lineLen;
+        if (alongLine <= alongMin || alongLine >= alongMax) return false;
+        double perpDist = toPx * (-ndy) + toPy * ndx;
+        return fabs(perpDist) <= perpReach;
+    }
+};
+
 // Generate fold crease effect with thin erratic lines and perpendicular cracks
-inline void foldCrease(double px, double py, int seed,
-    double x1, double y1, double x2, double y2,
-    double lineRoughness, double lineRoughScale, double lineWidth,
-    double sideAWidth, double sideARoughness, double sideARoughScale, double sideAJagged, double sideASoftness,
-    double sideBWidth, double sideBRoughness, double sideBRoughScale, double sideBJagged, double sideBSoftness,
-    double crackAmount, double crackLength, double crackLengthVar, double crackDensity, double crackBranching,
-    double crackAngle, double crackAngleVar,
-    double shadowAOpacity, double shadowALength, double shadowAVariability,
-    double shadowBOpacity, double shadowBLength, double shadowBVariability,
-    double scale,
+inline void foldCrease(double px, double py, const FoldProfile& fold,
     double& crackStrength, double& shadowAStrength, double& shadowBStrength)
 {
     crackStrength = 0;
     shadowAStrength = 0;
     shadowBStrength = 0;
     
-    // Line vector
-    double dx = x2 - x1;
-    double dy = y2 - y1;
-    double lineLen = sqrt(dx*dx + dy*dy);
-    if (lineLen < 1.0) return;
+    if (!fold.contains(px, py)) return;
     
-    // Normalize
-    double ndx = dx / lineLen;
-    double ndy = dy / lineLen;
+    const FoldSettings& s = fold.s;
+    double scale = s.scale;
+    int seed = fold.seed;
+    double lineLen = fold.lineLen;
     
     // Vector from p1 to current point
-    double toPx = px - x1;
-    double toPy = py - y1;
+    double toPx = px - fold.x1;
+    double toPy = py - fold.y1;
     
     // Project onto line to get position along line (0 to 1)
-    double alongLine = (toPx * ndx + toPy * ndy) / lineLen;
+    double alongLine = (toPx * fold.ndx + toPy * fold.ndy) / lineLen;
     
     // Perpendicular distance (positive = side A, negative = side B)
-    double perpDist = toPx * (-ndy) + toPy * ndx;
-    
-    // Add imperfections to the fold line itself - erratic wobble
-    double lineWobble = 0;
-    if (lineRoughness > 0) {
-        double scaledLineRoughScale = lineRoughScale * scale;
-        double coord = alongLine * lineLen;
-        lineWobble = fbm2D(coord / scaledLineRoughScale, seed * 0.01, seed + 1000, 3, 0.6);
-        lineWobble += valueNoise2D(coord / (scaledLineRoughScale * 0.3), seed * 0.01, seed + 1100) * 0.4;
-        double sharpTurn = valueNoise2D(coord / (scaledLineRoughScale * 0.5), seed * 0.02, seed + 1200);
-        sharpTurn = sharpTurn > 0.7 ? (sharpTurn - 0.7) * 3.0 : (sharpTurn < 0.3 ? (0.3 - sharpTurn) * -3.0 : 0);
-        lineWobble += sharpTurn * 0.3;
-        lineWobble *= lineRoughness * scale * 0.06;
-    }
-    double adjustedPerpDist = perpDist - lineWobble;
+    double perpDist = toPx * (-fold.ndy) + toPy * fold.ndx;
+    
+    double adjustedPerpDist = perpDist - fold.lookup(fold.wobble, alongLine);
     
     // Determine which side we're on
     bool isSideA = adjustedPerpDist > 0;
     double absDist = fabs(adjustedPerpDist);
     
     // Get parameters for current side
-    double sideWidth, sideRoughness, sideRoughScale, sideJagged, sideSoftness;
+    double sideWidth, sideSoftness, edgeDisp;
     int sideSeed;
     if (isSideA) {
-        sideWidth = sideAWidth * scale;
-        sideRoughness = sideARoughness;
-        sideRoughScale = sideARoughScale;
-        sideJagged = sideAJagged;
-        sideSoftness = sideASoftness;
+        sideWidth = s.sideAWidth * scale;
+        sideSoftness = s.sideASoftness;
         sideSeed = seed + 2000;
+        edgeDisp = fold.lookup(fold.edgeA, alongLine);
     } else {
-        sideWidth = sideBWidth * scale;
-        sideRoughness = sideBRoughness;
-        sideRoughScale = sideBRoughScale;
-        sideJagged = sideBJagged;
-        sideSoftness = sideBSoftness;
+        sideWidth = s.sideBWidth * scale;
+        sideSoftness = s.sideBSoftness;
         sideSeed = seed + 3000;
+        edgeDisp = fold.lookup(fold.edgeB, alongLine);
     }
     
     // Early exit if too far from fold
-    double maxDist = safeMax(sideAWidth + shadowALength, sideBWidth + shadowBLength) * scale * 1.2;
+    double maxDist = safeMax(s.sideAWidth + s.shadowALength, s.sideBWidth + s.shadowBLength) * scale * 1.2;
     if (absDist > maxDist) return;
     
     // Fade out at ends of fold line
@@ -1073,18 +1680,15 @@ inline void foldCrease(double px, double py, int seed,
     }
     
     // === MAIN FOLD LINE (thin, erratic) ===
-    double scaledLineWidth = lineWidth * scale;
+    double scaledLineWidth = s.lineWidth * scale;
     double mainLineDist = fabs(adjustedPerpDist);
     double mainLineStrength = 0;
     if (mainLineDist < scaledLineWidth) {
         mainLineStrength = 1.0 - smoothstep(scaledLineWidth * 0.2, scaledLineWidth, mainLineDist);
-        double lineVar = fbm2D(alongLine * 20.0, seed * 0.1, seed + 1500, 2, 0.5);
-        lineVar = lineVar * 0.4 + 0.6;
-        mainLineStrength *= lineVar;
+        mainLineStrength *= fold.lookup(fold.lineVar, alongLine);
     }
     
     // === SIDE EDGE CRACKING ===
-    double edgeDisp = foldEdgeDisplacement(alongLine, lineLen, sideSeed, sideRoughness, sideRoughScale, sideJagged, scale);
     double edgePos = sideWidth + edgeDisp;
     double distFromEdge = edgePos - absDist;
     
@@ -1099,77 +1703,237 @@ inline void foldCrease(double px, double py, int seed,
     
     // === PERPENDICULAR CRACKS ===
     double perpCrackStrength = 0;
-    if (crackAmount > 0 && crackDensity > 0) {
-        perpCrackStrength = perpendicularCracks(px, py, seed + 4000, x1, y1, x2, y2,
-            alongLine, adjustedPerpDist, lineLen, crackLength, crackLengthVar, crackDensity, crackBranching,
-            crackAngle, crackAngleVar, scale);
-        perpCrackStrength *= crackAmount;
+    if (s.crackAmount > 0 && s.crackDensity > 0) {
+        perpCrackStrength = perpendicularCracks(px, py, seed + 4000, fold.x1, fold.y1, fold.x2, fold.y2,
+            alongLine, adjustedPerpDist, lineLen, s.crackLength, s.crackLengthVar, s.crackDensity, s.crackBranching,
+            s.crackAngle, s.crackAngleVar, scale);
+        perpCrackStrength *= s.crackAmount;
     }
     
     // Combine all crack elements
     crackStrength = safeMax(mainLineStrength, safeMax(edgeCrackStrength, perpCrackStrength));
     crackStrength *= endFade;
     
-    // === SHADOW A (outside edge of side A) ===
-    if (shadowAOpacity > 0 && isSideA) {
-        double sideAEdgePos = sideAWidth * scale + foldEdgeDisplacement(alongLine, lineLen, seed + 2000, 
-            sideARoughness, sideARoughScale, sideAJagged, scale);
-        double distOutsideSideA = absDist - sideAEdgePos;
+    // === SHADOW A / B (outside the side edge, same displacement as the side crack) ===
+    double shadowOpacity = isSideA ? s.shadowAOpacity : s.shadowBOpacity;
+    if (shadowOpacity > 0) {
+        double distOutsideSide = absDist - edgePos;
         
-        if (distOutsideSideA > 0) {
-            double shadowVar = 1.0;
-            if (shadowAVariability > 0) {
-                double varNoise = fbm2D(alongLine * 8.0, seed * 0.1, seed + 6000, 2, 0.5);
-                varNoise = varNoise * 0.5 + 0.5;
-                shadowVar = 1.0 - shadowAVariability * (1.0 - varNoise);
-            }
+        if (distOutsideSide > 0) {
+            double shadowLength = isSideA ? s.shadowALength : s.shadowBLength;
+            double shadowVar = fold.lookup(isSideA ? fold.shadowVarA : fold.shadowVarB, alongLine);
+            double effectiveShadowLen = shadowLength * scale * shadowVar;
             
-            double effectiveShadowLen = shadowALength * scale * shadowVar;
-            
-            if (distOutsideSideA < effectiveShadowLen) {
-                double shadowFalloff = 1.0 - (distOutsideSideA / effectiveShadowLen);
+            if (distOutsideSide < effectiveShadowLen) {
+                double shadowFalloff = 1.0 - (distOutsideSide / effectiveShadowLen);
                 shadowFalloff = shadowFalloff * shadowFalloff;
-                shadowAStrength = shadowFalloff * shadowAOpacity * endFade;
+                double shadowStrength = shadowFalloff * shadowOpacity * endFade;
+                if (isSideA) shadowAStrength = shadowStrength;
+                else shadowBStrength = shadowStrength;
             }
         }
     }
     
-    // === SHADOW B (outside edge of side B) ===
-    if (shadowBOpacity > 0 && !isSideA) {
-        double sideBEdgePos = sideBWidth * scale + foldEdgeDisplacement(alongLine, lineLen, seed + 3000, 
-            sideBRoughness, sideBRoughScale, sideBJagged, scale);
-        double distOutsideSideB = absDist - sideBEdgePos;
+    crackStrength = clamp01(crackStrength);
+    shadowAStrength = clamp01(shadowAStrength);
+    shadowBStrength = clamp01(shadowBStrength);
+}
+
+// Small bounding volume hierarchy over the fold influence boxes, so a pixel only
+// runs the creases whose region it falls in. Nodes are stored flat, one fold
+// per leaf.
+class FoldBVH {
+public:
+    struct Node {
+        double minX, minY, maxX, maxY;
+        int left, right;    // child nodes, -1 for a leaf
+        int fold;           // fold index for a leaf
+    };
+    
+    std::vector<Node> nodes;
+    
+    void build(const std::vector<FoldProfile>& folds) {
+        nodes.clear();
+        if (folds.empty()) return;
+        std::vector<int> order(folds.size());
+        for (size_t i = 0; i < folds.size(); i++) order[i] = (int)i;
+        buildNode(folds, order, 0, (int)order.size());
+    }
+    
+    // Collects folds whose box contains the point, in ascending fold order
+    int query(double px, double py, int* hits, int maxHits) const {
+        int numHits = 0;
+        if (nodes.empty()) return 0;
         
-        if (distOutsideSideB > 0) {
-            double shadowVar = 1.0;
-            if (shadowBVariability > 0) {
-                double varNoise = fbm2D(alongLine * 8.0, seed * 0.1, seed + 7000, 2, 0.5);
-                varNoise = varNoise * 0.5 + 0.5;
-                shadowVar = 1.0 - shadowBVariability * (1.0 - varNoise);
-            }
-            
-            double effectiveShadowLen = shadowBLength * scale * shadowVar;
+        int stack[2 * MAX_FOLDS];
+        int top = 0;
+        stack[top++] = 0;
+        
+        while (top > 0) {
+            const Node& n = nodes[stack[--top]];
+            if (px < n.minX || px > n.maxX || py < n.minY || py > n.maxY) continue;
             
-            if (distOutsideSideB < effectiveShadowLen) {
-                double shadowFalloff = 1.0 - (distOutsideSideB / effectiveShadowLen);
-                shadowFalloff = shadowFalloff * shadowFalloff;
-                shadowBStrength = shadowFalloff * shadowBOpacity * endFade;
+            if (n.left < 0) {
+                if (numHits < maxHits) {
+                    // Insert sorted so folds always blend in the same order
+                    int i = numHits++;
+                    while (i > 0 && hits[i - 1] > n.fold) { hits[i] = hits[i - 1]; i--; }
+                    hits[i] = n.fold;
+                }
+            } else {
+                stack[top++] = n.left;
+                stack[top++] = n.right;
             }
         }
+        
+        return numHits;
+    }
+    
+private:
+    int buildNode(const std::vector<FoldProfile>& folds, std::vector<int>& order, int begin, int end) {
+        int index = (int)nodes.size();
+        nodes.push_back(Node());
+        
+        Node n;
+        n.minX = n.minY = 1e30;
+        n.maxX = n.maxY = -1e30;
+        for (int i = begin; i < end; i++) {
+            const FoldProfile& f = folds[order[i]];
+            n.minX = safeMin(n.minX, f.minX);
+            n.minY = safeMin(n.minY, f.minY);
+            n.maxX = safeMax(n.maxX, f.maxX);
+            n.maxY = safeMax(n.maxY, f.maxY);
+        }
+        n.left = n.right = -1;
+        n.fold = order[begin];
+        
+        if (end - begin > 1) {
+            // Median split along the longer axis of the box centres
+            bool splitX = (n.maxX - n.minX) >= (n.maxY - n.minY);
+            std::sort(order.begin() + begin, order.begin() + end, [&](int a, int b) {
+                const FoldProfile& fa = folds[a];
+                const FoldProfile& fb = folds[b];
+                return splitX ? (fa.minX + fa.maxX) < (fb.minX + fb.maxX)
+                              : (fa.minY + fa.maxY) < (fb.minY + fb.maxY);
+            });
+            int mid = (begin + end) / 2;
+            n.left = buildNode(folds, order, begin, mid);
+            n.right = buildNode(folds, order, mid, end);
+        }
+        
+        nodes[index] = n;
+        return index;
+    }
+};
+
+// All fold lines for one render
+struct FoldSet : public CachedField {
+    std::vector<FoldProfile> folds;
+    std::vector<double> amounts;
+    FoldBVH bvh;
+    
+    bool active() const { return !folds.empty(); }
+    
+    size_t bytes() const {
+        size_t total = sizeof(FoldSet) + bvh.nodes.size() * sizeof(FoldBVH::Node);
+        for (size_t i = 0; i < folds.size(); i++) {
+            const FoldProfile& f = folds[i];
+            total += sizeof(FoldProfile) + sizeof(float) * (f.wobble.size() + f.lineVar.size() +
+                f.edgeA.size() + f.edgeB.size() + f.shadowVarA.size() + f.shadowVarB.size());
+        }
+        return total;
     }
     
-    crackStrength = clamp01(crackStrength);
-    shadowAStrength = clamp01(shadowAStrength);
-    shadowBStrength = clamp01(shadowBStrength);
+    void add(int foldSeed, double x1, double y1, double x2, double y2, double amount, const FoldSettings& settings) {
+        if (amount <= 0) return;
+        FoldProfile fold;
+        fold.build(foldSeed, x1, y1, x2, y2, settings);
+        if (!fold.active) return;
+        folds.push_back(fold);
+        amounts.push_back(amount);
+    }
+    
+    void finalize() { bvh.build(folds); }
+    
+    // True when any fold's region overlaps the box (noise coordinates)
+    bool touches(double minX, double minY, double maxX, double maxY) const {
+        for (size_t i = 0; i < folds.size(); i++) {
+            const FoldProfile& f = folds[i];
+            if (maxX >= f.minX && minX <= f.maxX && maxY >= f.minY && minY <= f.maxY) return true;
+        }
+        return false;
+    }
+};
+
+// Apply every fold covering the pixel to the content colour
+inline void applyFolds(const FoldSet& foldSet, double px, double py,
+    double backingR, double backingG, double backingB,
+    const PF_Pixel& foldShadowAColor, const PF_Pixel& foldShadowBColor,
+    double& finalR, double& finalG, double& finalB)
+{
+    int hits[MAX_FOLDS];
+    int numHits = foldSet.bvh.query(px, py, hits, MAX_FOLDS);
+    
+    for (int h = 0; h < numHits; h++) {
+        double foldAmount = foldSet.amounts[hits[h]];
+        double crackStrength, foldShadowAStr, foldShadowBStr;
+        foldCrease(px, py, foldSet.folds[hits[h]], crackStrength, foldShadowAStr, foldShadowBStr);
+        
+        // Blend paper through at crack
+        // Apply foldAmount as a multiplier, but ensure 100% fold amount allows full crack visibility
+        crackStrength *= foldAmount;
+        if (crackStrength > 0) {
+            // Use a steeper curve so cracks are more opaque
+            double effectiveCrack = clamp01(crackStrength * 1.5);
+            finalR = finalR * (1.0 - effectiveCrack) + backingR * effectiveCrack;
+            finalG = finalG * (1.0 - effectiveCrack) + backingG * effectiveCrack;
+            finalB = finalB * (1.0 - effectiveCrack) + backingB * effectiveCrack;
+        }
+        
+        // Apply shadow A (highlight - typically white)
+        foldShadowAStr *= foldAmount;
+        if (foldShadowAStr > 0) {
+            double shAR = foldShadowAColor.red / 255.0;
+            double shAG = foldShadowAColor.green / 255.0;
+            double shAB = foldShadowAColor.blue / 255.0;
+            double effectiveShadowA = clamp01(foldShadowAStr);
+            finalR = finalR * (1.0 - effectiveShadowA) + shAR * effectiveShadowA;
+            finalG = finalG * (1.0 - effectiveShadowA) + shAG * effectiveShadowA;
+            finalB = finalB * (1.0 - effectiveShadowA) + shAB * effectiveShadowA;
+        }
+        
+        // Apply shadow B (shadow - typically black)
+        foldShadowBStr *= foldAmount;
+        if (foldShadowBStr > 0) {
+            double shBR = foldShadowBColor.red / 255.0;
+            double shBG = foldShadowBColor.green / 255.0;
+            double shBB = foldShadowBColor.blue / 255.0;
+            double effectiveShadowB = clamp01(foldShadowBStr);
+            finalR = finalR * (1.0 - effectiveShadowB) + shBR * effectiveShadowB;
+            finalG = finalG * (1.0 - effectiveShadowB) + shBG * effectiveShadowB;
+            finalB = finalB * (1.0 - effectiveShadowB) + shBB * effectiveShadowB;
+        }
+    }
 }
 
 // ============================================================
 // GRUNGE FUNCTIONS
 // ============================================================
 
-inline double organicDirt(double x, double y, int seed, double size, double amount, double scale) {
-    if (amount <= 0) return 0.0;
-    
+// Low-frequency mask deciding where dirt may appear, before its threshold
+inline double dirtDistribution(double x, double y, int seed) {
+    return fbm2D(x * 0.002, y * 0.002, seed + 5000, 3, 0.6);
+}
+
+inline double organicDirt(double x, double y, int seed, double size, double amount, double scale,
+    double distribution)
+{
+    if (amount <= 0) return 0.0;
+    
+    double distThreshold = 0.7 - (amount * 0.006);
+    double dist = smoothstep(distThreshold, distThreshold + 0.2, distribution);
+    if (dist <= 0) return 0.0;
+    
     double scaledSize = size * scale;
     
     double w1 = worleyNoise(x / scaledSize, y / scaledSize, seed);
@@ -1184,10 +1948,6 @@ inline double organicDirt(double x, double y, int seed, double size, double amou
     double threshold = 0.75 - (amount * 0.005);
     shape = smoothstep(threshold, threshold + 0.15, shape);
     
-    double dist = fbm2D(x * 0.002, y * 0.002, seed + 5000, 3, 0.6);
-    double distThreshold = 0.7 - (amount * 0.006);
-    dist = smoothstep(distThreshold, distThreshold + 0.2, dist);
-    
     double speckle = worleyNoise(x / (scaledSize * 0.2), y / (scaledSize * 0.2), seed + 8000);
     speckle = speckle < 0.12 ? (0.12 - speckle) / 0.12 : 0.0;
     
@@ -1196,9 +1956,19 @@ inline double organicDirt(double x, double y, int seed, double size, double amou
     return clamp01(dirt);
 }
 
-inline double organicSmudge(double x, double y, int seed, double size, double amount, double scale) {
+inline double smudgeDistribution(double x, double y, int seed) {
+    return fbm2D(x * 0.001, y * 0.001, seed + 23000, 2, 0.7);
+}
+
+inline double organicSmudge(double x, double y, int seed, double size, double amount, double scale,
+    double distribution)
+{
     if (amount <= 0) return 0.0;
     
+    double distThreshold = 0.8 - (amount * 0.007);
+    double dist = smoothstep(distThreshold, distThreshold + 0.15, distribution);
+    if (dist <= 0) return 0.0;
+    
     double scaledSize = size * scale;
     
     double fbm1 = fbm2D(x / scaledSize, y / scaledSize, seed + 20000, 4, 0.5);
@@ -1211,10 +1981,6 @@ inline double organicSmudge(double x, double y, int seed, double size, double am
     double threshold = 0.7 - (amount * 0.006);
     shape = smoothstep(threshold, threshold + 0.2, shape);
     
-    double dist = fbm2D(x * 0.001, y * 0.001, seed + 23000, 2, 0.7);
-    double distThreshold = 0.8 - (amount * 0.007);
-    dist = smoothstep(distThreshold, distThreshold + 0.15, dist);
-    
     double angle = fbm2D(x * 0.005, y * 0.005, seed + 24000, 2, 0.5) * 6.28;
     double streak = sin(x * cos(angle) * 0.05 + y * sin(angle) * 0.05);
     streak = streak * 0.3 + 0.7;
@@ -1224,62 +1990,140 @@ inline double organicSmudge(double x, double y, int seed, double size, double am
     return clamp01(smudge);
 }
 
-// Dust particles - small, irregular, high-contrast specks scattered randomly
-inline double dustParticles(double x, double y, int seed, double size, double amount, double scale) {
-    if (amount <= 0) return 0.0;
+// Outline of one dust particle. The irregularity noise is read along a single
+// row of the value noise lattice, so that row is collapsed to one value per
+// lattice column when the particle is created.
+struct DustOutline {
+    enum { kFirstColumn = -10, kColumns = 21 };     // floor(3 * angle) over [-pi, pi]
+    
+    double column[kColumns];
+    
+    void build(uint32_t particleHash) {
+        double v = particleHash * 0.001;
+        int32_t vi = (int32_t)floor(v);
+        double sv = smoothstep(v - vi);
+        for (int i = 0; i < kColumns; i++) {
+            int32_t ui = kFirstColumn + i;
+            double n0 = (double)(hash2D(ui, vi, particleHash) & 0xFFFF) / 32768.0 - 1.0;
+            double n1 = (double)(hash2D(ui, vi + 1, particleHash) & 0xFFFF) / 32768.0 - 1.0;
+            column[i] = lerp(n0, n1, sv);
+        }
+    }
     
-    double scaledSize = size * scale;
-    double dustStrength = 0;
+    double irregularity(double angle) const {
+        double u = angle * 3.0;
+        int32_t ui = (int32_t)floor(u);
+        int i0 = std::max(0, std::min(kColumns - 1, ui - kFirstColumn));
+        int i1 = std::min(kColumns - 1, i0 + 1);
+        return lerp(column[i0], column[i1], smoothstep(u - ui)) * 0.4;
+    }
+};
+
+// Dust particles - small, irregular, high-contrast specks scattered randomly.
+// Each particle is stamped over its own bounding box, so cost follows the
+// particle count rather than the frame area. The layer is filled a field tile
+// at a time from the particles of the cells around the tile, so only the
+// tiles a render reads are ever built.
+class DustLayer {
+public:
+    // Pixel (x, y) samples dust space at (x / sampleDivisor, y / sampleDivisor)
+    DustLayer(int w, int h, double sampleDivisor, int seed, double size, double amount, double scale)
+        : width(w), height(h), sampleDivisor(sampleDivisor), seed(seed), amount(amount),
+          scaledSize(size * scale), cellSize(15.0 / (amount / 30.0 + 0.5))
+    {
+        // Each pixel only sees particles from its own and the adjacent cells
+        lastCellX = (int)floor(((w - 1) / sampleDivisor) / cellSize) + 1;
+        lastCellY = (int)floor(((h - 1) / sampleDivisor) / cellSize) + 1;
+    }
     
-    // Cell-based dust generation for truly random placement
-    double cellSize = 15.0 / (amount / 30.0 + 0.5);
+    // Coverage of [x0, x1) x [y0, y1) into a zeroed tile
+    void fill(int x0, int y0, int x1, int y1, float* tile, int stride) const {
+        int firstCellX = safeMax(-1, (int)floor(((double)x0 / sampleDivisor) / cellSize) - 1);
+        int firstCellY = safeMax(-1, (int)floor(((double)y0 / sampleDivisor) / cellSize) - 1);
+        int endCellX = safeMin(lastCellX, (int)floor(((double)(x1 - 1) / sampleDivisor) / cellSize) + 1);
+        int endCellY = safeMin(lastCellY, (int)floor(((double)(y1 - 1) / sampleDivisor) / cellSize) + 1);
+        
+        DustOutline outline;
+        TileRect rect = { x0, y0, x1, y1, tile, stride };
+        
+        for (int cy = firstCellY; cy <= endCellY; cy++) {
+            for (int cx = firstCellX; cx <= endCellX; cx++) {
+                uint32_t cellHash = hash2D(cx, cy, seed);
+                
+                // Multiple dust particles per cell based on amount
+                int numParticles = 1 + (int)((cellHash & 0x3) * amount / 100.0);
+                
+                for (int pi = 0; pi < numParticles; pi++) {
+                    uint32_t particleHash = hash(cellHash + pi * 9973);
+                    
+                    // Probability check
+                    double prob = (particleHash & 0xFF) / 255.0;
+                    if (prob > amount / 100.0) continue;
+                    
+                    // Particle position within cell
+                    double px = cx * cellSize + ((particleHash >> 8) & 0xFFFF) / 65536.0 * cellSize;
+                    double py = cy * cellSize + ((particleHash >> 16) & 0xFFFF) / 65536.0 * cellSize;
+                    
+                    // Particle size varies
+                    double thisSize = scaledSize * (0.3 + ((particleHash >> 4) & 0xFF) / 255.0 * 0.7);
+                    
+                    outline.build(particleHash);
+                    stamp(cx, cy, px, py, thisSize, outline, rect);
+                }
+            }
+        }
+    }
     
-    int cellX = (int)floor(x / cellSize);
-    int cellY = (int)floor(y / cellSize);
+private:
+    struct TileRect {
+        int x0, y0, x1, y1;
+        float* tile;
+        int stride;
+    };
     
-    // Check nearby cells
-    for (int cy = cellY - 1; cy <= cellY + 1; cy++) {
-        for (int cx = cellX - 1; cx <= cellX + 1; cx++) {
-            uint32_t cellHash = hash2D(cx, cy, seed);
+    int width, height;
+    double sampleDivisor;
+    int seed;
+    double amount, scaledSize, cellSize;
+    int lastCellX, lastCellY;
+    
+    void stamp(int cx, int cy, double px, double py, double thisSize,
+        const DustOutline& outline, const TileRect& rect) const
+    {
+        int x0 = std::max(rect.x0, (int)floor((px - thisSize) * sampleDivisor) - 1);
+        int y0 = std::max(rect.y0, (int)floor((py - thisSize) * sampleDivisor) - 1);
+        int x1 = std::min(rect.x1 - 1, (int)ceil((px + thisSize) * sampleDivisor) + 1);
+        int y1 = std::min(rect.y1 - 1, (int)ceil((py + thisSize) * sampleDivisor) + 1);
+        
+        for (int iy = y0; iy <= y1; iy++) {
+            double y = (double)iy / sampleDivisor;
+            int cellY = (int)floor(y / cellSize);
+            if (cellY < cy - 1 || cellY > cy + 1) continue;
             
-            // Multiple dust particles per cell based on amount
-            int numParticles = 1 + (int)((cellHash & 0x3) * amount / 100.0);
+            float* row = rect.tile + (size_t)(iy - rect.y0) * rect.stride;
             
-            for (int pi = 0; pi < numParticles; pi++) {
-                uint32_t particleHash = hash(cellHash + pi * 9973);
-                
-                // Probability check
-                double prob = (particleHash & 0xFF) / 255.0;
-                if (prob > amount / 100.0) continue;
-                
-                // Particle position within cell
-                double px = cx * cellSize + ((particleHash >> 8) & 0xFFFF) / 65536.0 * cellSize;
-                double py = cy * cellSize + ((particleHash >> 16) & 0xFFFF) / 65536.0 * cellSize;
+            for (int ix = x0; ix <= x1; ix++) {
+                double x = (double)ix / sampleDivisor;
+                int cellX = (int)floor(x / cellSize);
+                if (cellX < cx - 1 || cellX > cx + 1) continue;
                 
                 // Distance to this particle
                 double dist = sqrt((x - px) * (x - px) + (y - py) * (y - py));
+                if (dist >= thisSize) continue;
                 
-                // Particle size varies
-                double thisSize = scaledSize * (0.3 + ((particleHash >> 4) & 0xFF) / 255.0 * 0.7);
+                // Irregular shape from the particle's outline table
+                double angle = atan2(y - py, x - px);
+                double adjustedSize = thisSize * (1.0 + outline.irregularity(angle));
                 
-                if (dist < thisSize) {
-                    // Irregular shape using noise
-                    double angle = atan2(y - py, x - px);
-                    double irregularity = valueNoise2D(angle * 3.0, particleHash * 0.001, particleHash) * 0.4;
-                    double adjustedSize = thisSize * (1.0 + irregularity);
-                    
-                    if (dist < adjustedSize) {
-                        // Sharp, high-contrast particle
-                        double particleProfile = 1.0 - smoothstep(adjustedSize * 0.5, adjustedSize, dist);
-                        dustStrength = safeMax(dustStrength, particleProfile);
-                    }
+                if (dist < adjustedSize) {
+                    // Sharp, high-contrast particle
+                    double particleProfile = 1.0 - smoothstep(adjustedSize * 0.5, adjustedSize, dist);
+                    row[ix - rect.x0] = std::max(row[ix - rect.x0], (float)clamp01(particleProfile));
                 }
             }
         }
     }
-    
-    return clamp01(dustStrength);
-}
+};
 
 // ============================================================
 // FIBER FUNCTIONS
@@ -1432,526 +2276,2949 @@ inline FiberFieldResult fiberField(
 }
 
 // ============================================================
-// MAIN RENDER
+// CACHED FIELDS
 // ============================================================
 
-PF_Err Render(
-    PF_InData       *in_data,
-    PF_OutData      *out_data,
-    PF_ParamDef     *params[],
-    PF_LayerDef     *output)
+// Fields that never read the input pixels are built through the field cache so
+// they are reused across frames and effect instances. Pixel (x, y) samples a
+// field at (x / sampleDivisor, y / sampleDivisor); the divisor and every value
+// the field depends on make up its key.
+//
+// With adaptive shading the slowly varying part of a field is interpolated from
+// a coarse grid wherever that stays within the field's tolerance.
+enum FieldKind {
+    FIELD_EDGE_DISPLACEMENT = 1,
+    FIELD_PAPER_GRAIN,
+    FIELD_DIRT,
+    FIELD_SMUDGE,
+    FIELD_DUST,
+    FIELD_FOLDS
+};
+
+// Interpolation tolerances: a twentieth of a pixel of displacement, and about a
+// quarter of an 8-bit step after the distribution thresholds and grain strength
+#define ADAPTIVE_DISPLACEMENT_TOLERANCE     0.05f
+#define ADAPTIVE_DIRT_TOLERANCE             0.0005f
+#define ADAPTIVE_SMUDGE_TOLERANCE           0.0004f
+#define ADAPTIVE_GRAIN_TOLERANCE            0.005f
+
+inline std::shared_ptr<FieldPlane> edgeDisplacementField(int width, int height, double sampleDivisor, bool adaptive,
+    double offset, int seed, double roughness, double roughScale, double jaggedness, double notch, double scale)
 {
-    PF_Err err = PF_Err_NONE;
+    FieldKey key(FIELD_EDGE_DISPLACEMENT);
+    key.add(width).add(height).add(sampleDivisor).add(adaptive).add(offset).add(seed);
+    key.add(roughness).add(roughScale).add(jaggedness).add(notch).add(scale);
+    
+    if (adaptive) {
+        return FieldCache::instance().plane(key, width, height,
+            [=](int x, int y) {
+                return (float)edgeRoughness((double)x / sampleDivisor + offset, (double)y / sampleDivisor + offset,
+                    seed, roughness, roughScale, scale);
+            },
+            [=](int x, int y, float rough) {
+                return (float)edgeDetail((double)x / sampleDivisor + offset, (double)y / sampleDivisor + offset,
+                    seed, jaggedness, notch, scale, rough);
+            },
+            ADAPTIVE_DISPLACEMENT_TOLERANCE);
+    }
+    return FieldCache::instance().plane(key, width, height, [=](int x, int y) {
+        double px = (double)x / sampleDivisor;
+        double py = (double)y / sampleDivisor;
+        return (float)calcEdgeDisplacement(px + offset, py + offset, seed,
+            roughness, roughScale, jaggedness, notch, scale);
+    });
+}
+
+// Paper grain mix before Paper Texture is applied
+inline std::shared_ptr<FieldPlane> paperGrainField(int width, int height, double sampleDivisor, bool adaptive,
+    double texScale, int seed)
+{
+    FieldKey key(FIELD_PAPER_GRAIN);
+    key.add(width).add(height).add(sampleDivisor).add(adaptive).add(texScale).add(seed);
+    
+    FieldPlane::Generator grain = [=](int x, int y) {
+        double px = (double)x / sampleDivisor;
+        double py = (double)y / sampleDivisor;
+        double grain1 = fbm2D(px / texScale, py / texScale, seed + 7000, 3, 0.5);
+        double grain2 = valueNoise2D(px / (texScale * 0.5), py / (texScale * 0.5), seed + 8000);
+        double streaks = fbm2D(px / (texScale * 0.67), py / (texScale * 5.0), seed + 9000, 2, 0.6);
+        return (float)(grain1 * 0.5 + grain2 * 0.3 + streaks * 0.2);
+    };
+    
+    // Grain is all one band; only a large Master Scale makes it coarse enough
+    if (adaptive) {
+        return FieldCache::instance().plane(key, width, height, grain,
+            [](int, int, float g) { return g; }, ADAPTIVE_GRAIN_TOLERANCE);
+    }
+    return FieldCache::instance().plane(key, width, height, grain);
+}
+
+inline std::shared_ptr<FieldPlane> dirtField(int width, int height, double sampleDivisor, bool adaptive,
+    int seed, double size, double amount, double scale)
+{
+    FieldKey key(FIELD_DIRT);
+    key.add(width).add(height).add(sampleDivisor).add(adaptive).add(seed).add(size).add(amount).add(scale);
+    
+    if (adaptive) {
+        return FieldCache::instance().plane(key, width, height,
+            [=](int x, int y) {
+                return (float)dirtDistribution((double)x / sampleDivisor, (double)y / sampleDivisor, seed);
+            },
+            [=](int x, int y, float distribution) {
+                return (float)organicDirt((double)x / sampleDivisor, (double)y / sampleDivisor,
+                    seed, size, amount, scale, distribution);
+            },
+            ADAPTIVE_DIRT_TOLERANCE);
+    }
+    return FieldCache::instance().plane(key, width, height, [=](int x, int y) {
+        double px = (double)x / sampleDivisor;
+        double py = (double)y / sampleDivisor;
+        return (float)organicDirt(px, py, seed, size, amount, scale, dirtDistribution(px, py, seed));
+    });
+}
+
+inline std::shared_ptr<FieldPlane> smudgeField(int width, int height, double sampleDivisor, bool adaptive,
+    int seed, double size, double amount, double scale)
+{
+    FieldKey key(FIELD_SMUDGE);
+    key.add(width).add(height).add(sampleDivisor).add(adaptive).add(seed).add(size).add(amount).add(scale);
+    
+    if (adaptive) {
+        return FieldCache::instance().plane(key, width, height,
+            [=](int x, int y) {
+                return (float)smudgeDistribution((double)x / sampleDivisor, (double)y / sampleDivisor, seed);
+            },
+            [=](int x, int y, float distribution) {
+                return (float)organicSmudge((double)x / sampleDivisor, (double)y / sampleDivisor,
+                    seed, size, amount, scale, distribution);
+            },
+            ADAPTIVE_SMUDGE_TOLERANCE);
+    }
+    return FieldCache::instance().plane(key, width, height, [=](int x, int y) {
+        double px = (double)x / sampleDivisor;
+        double py = (double)y / sampleDivisor;
+        return (float)organicSmudge(px, py, seed, size, amount, scale, smudgeDistribution(px, py, seed));
+    });
+}
+
+inline std::shared_ptr<FieldPlane> dustField(int width, int height, double sampleDivisor,
+    int seed, double size, double amount, double scale)
+{
+    FieldKey key(FIELD_DUST);
+    key.add(width).add(height).add(sampleDivisor).add(seed).add(size).add(amount).add(scale);
+    
+    std::shared_ptr<DustLayer> dust = std::make_shared<DustLayer>(width, height, sampleDivisor, seed, size, amount, scale);
+    FieldPlane::TileGenerator fill = [dust](int x0, int y0, int x1, int y1, float* tile, int stride) {
+        dust->fill(x0, y0, x1, y1, tile, stride);
+    };
+    return FieldCache::instance().find<FieldPlane>(key, [&]() {
+        return std::make_shared<FieldPlane>(width, height, fill);
+    });
+}
+
+// Fold points are in layer pixels and divided by sampleDivisor like the other fields
+inline std::shared_ptr<FoldSet> foldField(double sampleDivisor, int seed, const FoldSettings& settings,
+    const double amounts[], const double x1[], const double y1[], const double x2[], const double y2[])
+{
+    FieldKey key(FIELD_FOLDS);
+    key.add(sampleDivisor).add(seed);
+    for (int i = 0; i < MAX_FOLDS; i++) {
+        key.add(amounts[i]).add(x1[i]).add(y1[i]).add(x2[i]).add(y2[i]);
+    }
+    settings.addToKey(key);
+    
+    return FieldCache::instance().find<FoldSet>(key, [&]() {
+        std::shared_ptr<FoldSet> folds = std::make_shared<FoldSet>();
+        for (int i = 0; i < MAX_FOLDS; i++) {
+            folds->add(seed + 50000 + i * 10000,
+                x1[i] / sampleDivisor, y1[i] / sampleDivisor,
+                x2[i] / sampleDivisor, y2[i] / sampleDivisor,
+                amounts[i], settings);
+        }
+        folds->finalize();
+        return folds;
+    });
+}
+
+// Seed offset for the boil key containing the current frame. Every frame held
+// on the same key gets the same seeds, so its fields come straight from the
+// field cache.
+inline int boilSeedOffset(const PF_InData* in_data, bool boil, int holdFrames) {
+    if (!boil || in_data->time_step <= 0) return 0;
+    
+    A_long frame = in_data->current_time / in_data->time_step;
+    A_long hold = safeMax(1, holdFrames);
+    A_long boilKey = (frame >= 0) ? frame / hold : (frame - hold + 1) / hold;
+    
+    return (int)((boilKey % 100000) * 7919);
+}
+
+// ============================================================
+// RENDER PLAN
+// ============================================================
+
+// Stages that can contribute to a render; a kernel is compiled for every mask
+enum {
+    STAGE_FOLD      = 1 << 0,
+    STAGE_GRUNGE    = 1 << 1,
+    STAGE_FIBERS    = 1 << 2,
+    STAGE_MIDDLE    = 1 << 3,
+    STAGE_TEXTURE   = 1 << 4,
+    STAGE_COUNT     = 1 << 5
+};
+
+// The render as a graph of nodes, each reading the outputs of its inputs. A
+// tile asks for the composite and runs only the nodes reached by walking back
+// from it through nodes that have work to do there. Nodes without a stage bit
+// are part of every kernel.
+enum RenderNode {
+    NODE_DISTANCE = 0,      // alpha and distance field
+    NODE_DISPLACEMENT,      // outer and inner edge noise
+    NODE_MIDDLE,            // middle edges
+    NODE_MATTE,             // paper and content alpha
+    NODE_FIBERS,
+    NODE_TEXTURE,           // paper grain
+    NODE_PAPER,             // paper colour and shadows
+    NODE_FOLD,
+    NODE_GRUNGE,
+    NODE_COMPOSITE,
+    NODE_COUNT
+};
+
+inline unsigned nodeBit(int node) { return 1u << node; }
+
+struct RenderGraph {
+    unsigned inputs[NODE_COUNT];    // nodes each node reads
+    unsigned active;                // nodes with work to do in this render
+    
+    RenderGraph() : active(0) {
+        for (int n = 0; n < NODE_COUNT; n++) inputs[n] = 0;
+    }
+    
+    void connect(int node, int input) { inputs[node] |= nodeBit(input); }
+    
+    // Kernel stages for the nodes the composite needs, out of the live ones
+    int resolve(unsigned live) const {
+        static const int nodeStage[NODE_COUNT] = {
+            0, 0, STAGE_MIDDLE, 0, STAGE_FIBERS, STAGE_TEXTURE, 0, STAGE_FOLD, STAGE_GRUNGE, 0
+        };
+        
+        unsigned needed = nodeBit(NODE_COMPOSITE);
+        unsigned added = needed;
+        while (added) {
+            unsigned reads = 0;
+            for (int n = 0; n < NODE_COUNT; n++) {
+                if (added & nodeBit(n)) reads |= inputs[n];
+            }
+            added = reads & live & ~needed;
+            needed |= added;
+        }
+        
+        int stages = 0;
+        for (int n = 0; n < NODE_COUNT; n++) {
+            if (needed & nodeBit(n)) stages |= nodeStage[n];
+        }
+        return stages;
+    }
+};
+
+// Everything the pixel kernel needs, resolved once per render: scaled sizes,
+// derived constants, normalised colours and the cached procedural fields.
+struct RenderPlan {
+    int width, height;
+    RenderGraph graph;
+    int stages;                 // resolved from the graph for the whole frame
+    bool vectorEdges;           // torn polygons instead of the distance field
+    
+    double downsampleFactor;
+    int seed;
+    
+    // Edges
+    double halfGap;
+    double softness;
+    double innerDispShift;      // innerDispMaxEstimate from Inner Expansion
+    double outerDispMin, outerDispMax;  // range of the displacement fields
+    double innerDispMin, innerDispMax;
+    double emptyBelow, contentAbove, solidAbove;    // see setupEdgeBounds
+    
+    // Middle edges
+    double middle1Amount, middle1Position, middle1FiberDensity, middle1Shadow;
+    double middle2Amount, middle2Position, middle2FiberDensity, middle2Shadow;
+    
+    // Paper shadows
+    bool paperShadows;
+    double shadowAmount, shadowWidth;
+    double contentShadowAmount, contentShadowWidth;
+    
+    // Fibers
+    double fiberDensity, fiberLength, fiberThickness, fiberSpread;
+    double fiberSoftness, fiberFeather, fiberRange;
+    double fiberShadow, fiberOpacity, fiberOpacityDivisor, fiberColorVar;
+    double fiberReach;          // no fiber reaches further than this from its edge
+    bool fiberBlur;
+    double fiberBlurFactor;
+    
+    // Paper
+    double paperBaseR, paperBaseG, paperBaseB;
+    double fiberBaseR, fiberBaseG, fiberBaseB;
+    double paperTexture;
     
+    // Folds
+    PF_Pixel foldShadowAColor, foldShadowBColor;
+    
+    // Grunge
+    double dirtOpacity, dirtR, dirtG, dirtB;
+    double smudgeOpacity, smudgeR, smudgeG, smudgeB;
+    double dustR, dustG, dustB;
+    
+    // Procedural fields (shared through the field cache)
+    std::shared_ptr<FieldPlane> outerDispField, innerDispField;
+    std::shared_ptr<FieldPlane> middle1DispField, middle2DispField;
+    std::shared_ptr<FieldPlane> grainField, dirtPlane, smudgePlane, dust;
+    std::shared_ptr<FoldSet> folds;
+};
+
+// Slots of the plan's procedural planes, grain and grunge first since every
+// paper pixel reads them while the displacement is only read near the edges.
+// Slots of stages that are off hold null.
+inline std::vector<std::shared_ptr<FieldPlane>*> planeSlots(RenderPlan& plan) {
+    std::vector<std::shared_ptr<FieldPlane>*> slots = {
+        &plan.grainField, &plan.dirtPlane, &plan.smudgePlane, &plan.dust,
+        &plan.outerDispField, &plan.innerDispField, &plan.middle1DispField, &plan.middle2DispField
+    };
+    return slots;
+}
+
+// Bytes of the plan's planes once every tile has been built
+inline size_t fullPlaneBytes(RenderPlan& plan) {
+    size_t bytes = 0;
+    for (std::shared_ptr<FieldPlane>* slot : planeSlots(plan)) {
+        if (*slot) bytes += (size_t)plan.width * plan.height * sizeof(float);
+    }
+    return bytes;
+}
+
+// Signed distances outside which the edge noise need not be sampled. Below
+// emptyBelow no paper, fiber or content is visible; above contentAbove the
+// content is fully opaque and no fiber reaches. Where the edges come within
+// 2px the kernel pushes them apart, which only moves the outer edge out and
+// the inner edge in, so the bounds allow for that too.
+inline void setupEdgeBounds(RenderPlan& plan) {
+    // Slack for the float rounding of the cached displacement fields
+    const double margin = 0.01;
+    
+    double outerLo = -plan.halfGap + plan.outerDispMin;
+    double outerHi = -plan.halfGap + plan.outerDispMax;
+    double innerLo = plan.halfGap + plan.innerDispMin - plan.innerDispShift;
+    double innerHi = plan.halfGap + plan.innerDispMax - plan.innerDispShift;
+    double outerEdgeLo = safeMin(outerLo, (outerLo + innerLo) / 2.0 - 1.0);
+    double innerEdgeHi = safeMax(innerHi, (outerHi + innerHi) / 2.0 + 1.0);
+    
+    double reach = (plan.stages & STAGE_FIBERS) ? safeMax(plan.softness, plan.fiberReach) : plan.softness;
+    plan.emptyBelow = outerEdgeLo - reach - margin;
+    plan.contentAbove = innerEdgeHi + reach + margin;
+    plan.solidAbove = innerEdgeHi + plan.softness + margin;
+}
+
+// Resolve the plan from parameter values at the current time
+inline void setupRenderPlan(RenderPlan& plan, PF_InData* in_data, PF_ParamDef* params[], int width, int height) {
     // Calculate downsample factor for preview resolution scaling
+    // At full res: num=1, den=1 -> factor=1.0
+    // At half res: num=1, den=2 -> factor=0.5
     double downsampleX = (double)in_data->downsample_x.num / (double)in_data->downsample_x.den;
     double downsampleY = (double)in_data->downsample_y.num / (double)in_data->downsample_y.den;
-    double downsampleFactor = (downsampleX + downsampleY) * 0.5;
+    double downsampleFactor = (downsampleX + downsampleY) * 0.5;  // Average of X and Y
     
-    // Basic settings - DON'T scale masterScale, work in full-res space
+    // DON'T scale masterScale - we work in full-res coordinate space
     double masterScale = params[PARAM_MASTER_SCALE]->u.fs_d.value / 100.0;
     
     double gapWidth = params[PARAM_GAP_WIDTH]->u.fs_d.value * masterScale;
-    int seed = params[PARAM_RANDOM_SEED]->u.sd.value;
+    int boilOffset = boilSeedOffset(in_data, params[PARAM_BOIL]->u.bd.value != 0, params[PARAM_BOIL_HOLD]->u.sd.value);
+    int seed = params[PARAM_RANDOM_SEED]->u.sd.value + boilOffset;
     double edgeSoftness = params[PARAM_EDGE_SOFTNESS]->u.fs_d.value * masterScale;
+    bool adaptive = params[PARAM_ADAPTIVE_SHADING]->u.bd.value != 0;
+    plan.vectorEdges = params[PARAM_EDGE_ENGINE]->u.pd.value == EDGE_ENGINE_VECTOR;
     
-    // Outer edge
     double outerRoughness = params[PARAM_OUTER_ROUGHNESS]->u.fs_d.value;
     double outerRoughScale = params[PARAM_OUTER_ROUGH_SCALE]->u.fs_d.value;
     double outerJaggedness = params[PARAM_OUTER_JAGGEDNESS]->u.fs_d.value;
     double outerNotch = params[PARAM_OUTER_NOTCH]->u.fs_d.value;
     
-    // Inner edge
     double innerRoughness = params[PARAM_INNER_ROUGHNESS]->u.fs_d.value;
     double innerRoughScale = params[PARAM_INNER_ROUGH_SCALE]->u.fs_d.value;
     double innerJaggedness = params[PARAM_INNER_JAGGEDNESS]->u.fs_d.value;
     double innerNotch = params[PARAM_INNER_NOTCH]->u.fs_d.value;
     double innerExpansion = params[PARAM_INNER_EXPANSION]->u.fs_d.value;
     
-    // Middle edges
-    double middle1Amount = params[PARAM_MIDDLE1_AMOUNT]->u.fs_d.value / 100.0;
-    double middle1Position = params[PARAM_MIDDLE1_POSITION]->u.fs_d.value / 100.0;
     double middle1Roughness = params[PARAM_MIDDLE1_ROUGHNESS]->u.fs_d.value;
-    double middle1Shadow = params[PARAM_MIDDLE1_SHADOW]->u.fs_d.value / 100.0;
-    double middle1FiberDensity = params[PARAM_MIDDLE1_FIBER_DENSITY]->u.fs_d.value;
-    
-    double middle2Amount = params[PARAM_MIDDLE2_AMOUNT]->u.fs_d.value / 100.0;
-    double middle2Position = params[PARAM_MIDDLE2_POSITION]->u.fs_d.value / 100.0;
     double middle2Roughness = params[PARAM_MIDDLE2_ROUGHNESS]->u.fs_d.value;
-    double middle2Shadow = params[PARAM_MIDDLE2_SHADOW]->u.fs_d.value / 100.0;
-    double middle2FiberDensity = params[PARAM_MIDDLE2_FIBER_DENSITY]->u.fs_d.value;
     
-    // Paper appearance
-    double paperTexture = params[PARAM_PAPER_TEXTURE]->u.fs_d.value / 100.0;
-    double shadowAmount = params[PARAM_SHADOW_AMOUNT]->u.fs_d.value / 100.0;
-    double shadowWidth = params[PARAM_SHADOW_WIDTH]->u.fs_d.value * masterScale;
+    plan.width = width;
+    plan.height = height;
+    plan.downsampleFactor = downsampleFactor;
+    plan.seed = seed;
+    
+    plan.halfGap = gapWidth / 2.0;
+    plan.softness = safeMax(0.5, edgeSoftness);
+    
+    // Shift inner edge based on expansion control
+    // expansion=100: no shift (innerDisp = innerDispRaw)
+    // expansion=50: current behavior (small shift)
+    // expansion=1: maximum shift inward
+    double expansionFactor = (100.0 - innerExpansion) / 50.0;  // 0 at 100, 1 at 50, ~2 at 1
+    plan.innerDispShift = (innerRoughness + innerJaggedness * 0.5 + innerNotch * 0.3) * masterScale * expansionFactor;
+    edgeDisplacementBounds(outerRoughness, outerJaggedness, outerNotch, masterScale, plan.outerDispMin, plan.outerDispMax);
+    edgeDisplacementBounds(innerRoughness, innerJaggedness, innerNotch, masterScale, plan.innerDispMin, plan.innerDispMax);
+    
+    plan.middle1Amount = params[PARAM_MIDDLE1_AMOUNT]->u.fs_d.value / 100.0;
+    plan.middle1Position = params[PARAM_MIDDLE1_POSITION]->u.fs_d.value / 100.0;
+    plan.middle1FiberDensity = params[PARAM_MIDDLE1_FIBER_DENSITY]->u.fs_d.value;
+    plan.middle2Amount = params[PARAM_MIDDLE2_AMOUNT]->u.fs_d.value / 100.0;
+    plan.middle2Position = params[PARAM_MIDDLE2_POSITION]->u.fs_d.value / 100.0;
+    plan.middle2FiberDensity = params[PARAM_MIDDLE2_FIBER_DENSITY]->u.fs_d.value;
+    plan.middle1Shadow = params[PARAM_MIDDLE1_SHADOW]->u.fs_d.value / 100.0;
+    plan.middle2Shadow = params[PARAM_MIDDLE2_SHADOW]->u.fs_d.value / 100.0;
+    
+    plan.shadowAmount = params[PARAM_SHADOW_AMOUNT]->u.fs_d.value / 100.0;
+    plan.shadowWidth = params[PARAM_SHADOW_WIDTH]->u.fs_d.value * masterScale;
+    plan.contentShadowAmount = params[PARAM_CONTENT_SHADOW_AMOUNT]->u.fs_d.value / 100.0;
+    plan.contentShadowWidth = params[PARAM_CONTENT_SHADOW_WIDTH]->u.fs_d.value * masterScale;
+    plan.paperShadows = plan.shadowAmount > 0 || plan.contentShadowAmount > 0 ||
+        (plan.middle1Amount > 0 && plan.middle1Shadow > 0) || (plan.middle2Amount > 0 && plan.middle2Shadow > 0);
+    
+    plan.paperTexture = params[PARAM_PAPER_TEXTURE]->u.fs_d.value / 100.0;
     
     PF_Pixel paperColor = params[PARAM_PAPER_COLOR]->u.cd.value;
-    double paperBaseR = paperColor.red / 255.0;
-    double paperBaseG = paperColor.green / 255.0;
-    double paperBaseB = paperColor.blue / 255.0;
+    plan.paperBaseR = paperColor.red / 255.0;
+    plan.paperBaseG = paperColor.green / 255.0;
+    plan.paperBaseB = paperColor.blue / 255.0;
     
     PF_Pixel fiberColor = params[PARAM_FIBER_COLOR]->u.cd.value;
-    double fiberBaseR = fiberColor.red / 255.0;
-    double fiberBaseG = fiberColor.green / 255.0;
-    double fiberBaseB = fiberColor.blue / 255.0;
-    
-    double innerShadowAmount = params[PARAM_CONTENT_SHADOW_AMOUNT]->u.fs_d.value / 100.0;
-    double innerShadowWidth = params[PARAM_CONTENT_SHADOW_WIDTH]->u.fs_d.value * masterScale;
-    
-    // Fibers
-    double fiberDensity = params[PARAM_FIBER_DENSITY]->u.fs_d.value;
-    double fiberLength = params[PARAM_FIBER_LENGTH]->u.fs_d.value * masterScale;
-    double fiberThickness = params[PARAM_FIBER_THICKNESS]->u.fs_d.value * masterScale;
-    double fiberSpread = params[PARAM_FIBER_SPREAD]->u.fs_d.value;
-    double fiberSoftness = params[PARAM_FIBER_SOFTNESS]->u.fs_d.value / 100.0;
-    double fiberFeather = params[PARAM_FIBER_FEATHER]->u.fs_d.value / 100.0;
-    double fiberRange = params[PARAM_FIBER_RANGE]->u.fs_d.value;
-    double fiberShadow = params[PARAM_FIBER_SHADOW]->u.fs_d.value / 100.0;
-    double fiberOpacity = params[PARAM_FIBER_OPACITY]->u.fs_d.value / 100.0;
+    plan.fiberBaseR = fiberColor.red / 255.0;
+    plan.fiberBaseG = fiberColor.green / 255.0;
+    plan.fiberBaseB = fiberColor.blue / 255.0;
+    
+    plan.fiberDensity = params[PARAM_FIBER_DENSITY]->u.fs_d.value;
+    plan.fiberLength = params[PARAM_FIBER_LENGTH]->u.fs_d.value * masterScale;
+    plan.fiberThickness = params[PARAM_FIBER_THICKNESS]->u.fs_d.value * masterScale;
+    plan.fiberSpread = params[PARAM_FIBER_SPREAD]->u.fs_d.value;
+    plan.fiberSoftness = params[PARAM_FIBER_SOFTNESS]->u.fs_d.value / 100.0;
+    plan.fiberFeather = params[PARAM_FIBER_FEATHER]->u.fs_d.value / 100.0;
+    plan.fiberRange = params[PARAM_FIBER_RANGE]->u.fs_d.value;
+    plan.fiberShadow = params[PARAM_FIBER_SHADOW]->u.fs_d.value / 100.0;
+    plan.fiberOpacity = params[PARAM_FIBER_OPACITY]->u.fs_d.value / 100.0;
+    plan.fiberOpacityDivisor = safeMax(0.001, plan.fiberOpacity);
+    plan.fiberColorVar = 0.30;  // Hardcoded, control removed
+    plan.fiberReach = plan.fiberLength * safeMax(0.1, 0.5 + plan.fiberRange / 100.0) * 2.5;
     double fiberBlur = params[PARAM_FIBER_BLUR]->u.fs_d.value;
-    double fiberColorVar = 0.30;  // Hardcoded, control removed
-    
-    // Fold mark - point values are in fixed point (16.16 format)
-    double foldAmount = params[PARAM_FOLD_AMOUNT]->u.fs_d.value / 100.0;
-    A_long fold1X = params[PARAM_FOLD_POINT1]->u.td.x_value;
-    A_long fold1Y = params[PARAM_FOLD_POINT1]->u.td.y_value;
-    A_long fold2X = params[PARAM_FOLD_POINT2]->u.td.x_value;
-    A_long fold2Y = params[PARAM_FOLD_POINT2]->u.td.y_value;
-    double foldLineRoughness = params[PARAM_FOLD_LINE_ROUGHNESS]->u.fs_d.value;
-    double foldLineRoughScale = params[PARAM_FOLD_LINE_ROUGH_SCALE]->u.fs_d.value;
-    double foldLineWidth = params[PARAM_FOLD_LINE_WIDTH]->u.fs_d.value;
-    double foldSideAWidth = params[PARAM_FOLD_SIDE_A_WIDTH]->u.fs_d.value;
-    double foldSideARoughness = params[PARAM_FOLD_SIDE_A_ROUGHNESS]->u.fs_d.value;
-    double foldSideARoughScale = params[PARAM_FOLD_SIDE_A_ROUGH_SCALE]->u.fs_d.value;
-    double foldSideAJagged = params[PARAM_FOLD_SIDE_A_JAGGEDNESS]->u.fs_d.value;
-    double foldSideASoftness = 0.0;  // Hardcoded, control removed
-    double foldSideBWidth = params[PARAM_FOLD_SIDE_B_WIDTH]->u.fs_d.value;
-    double foldSideBRoughness = params[PARAM_FOLD_SIDE_B_ROUGHNESS]->u.fs_d.value;
-    double foldSideBRoughScale = params[PARAM_FOLD_SIDE_B_ROUGH_SCALE]->u.fs_d.value;
-    double foldSideBJagged = params[PARAM_FOLD_SIDE_B_JAGGEDNESS]->u.fs_d.value;
-    double foldSideBSoftness = 0.0;  // Hardcoded, control removed
-    double foldCrackAmount = params[PARAM_FOLD_CRACK_AMOUNT]->u.fs_d.value / 100.0;
-    double foldCrackLength = params[PARAM_FOLD_CRACK_LENGTH]->u.fs_d.value;
-    double foldCrackLengthVar = params[PARAM_FOLD_CRACK_LENGTH_VAR]->u.fs_d.value / 100.0;
-    double foldCrackDensity = params[PARAM_FOLD_CRACK_DENSITY]->u.fs_d.value;
-    double foldCrackBranching = params[PARAM_FOLD_CRACK_BRANCHING]->u.fs_d.value / 100.0;
-    double foldCrackAngle = params[PARAM_FOLD_CRACK_ANGLE]->u.fs_d.value;
-    double foldCrackAngleVar = params[PARAM_FOLD_CRACK_ANGLE_VAR]->u.fs_d.value;
-    double foldShadowAOpacity = params[PARAM_FOLD_SHADOW_A_OPACITY]->u.fs_d.value / 100.0;
-    double foldShadowALength = params[PARAM_FOLD_SHADOW_A_LENGTH]->u.fs_d.value;
-    double foldShadowAVariability = params[PARAM_FOLD_SHADOW_A_VARIABILITY]->u.fs_d.value / 100.0;
-    PF_Pixel foldShadowAColor = params[PARAM_FOLD_SHADOW_A_COLOR]->u.cd.value;
-    double foldShadowBOpacity = params[PARAM_FOLD_SHADOW_B_OPACITY]->u.fs_d.value / 100.0;
-    double foldShadowBLength = params[PARAM_FOLD_SHADOW_B_LENGTH]->u.fs_d.value;
-    double foldShadowBVariability = params[PARAM_FOLD_SHADOW_B_VARIABILITY]->u.fs_d.value / 100.0;
-    PF_Pixel foldShadowBColor = params[PARAM_FOLD_SHADOW_B_COLOR]->u.cd.value;
+    plan.fiberBlur = fiberBlur > 0;
+    plan.fiberBlurFactor = 1.0 / (1.0 + fiberBlur * 0.2);
+    
+    // Fold lines: Fold Point 1/2 plus the additional folds (amount, start, end per fold)
+    // Points are in full-resolution layer coordinates, divided by downsampleFactor with the other fields
+    int foldLayout = params[PARAM_FOLD_LAYOUT]->u.pd.value;
+    double foldAmounts[MAX_FOLDS], foldX1[MAX_FOLDS], foldY1[MAX_FOLDS], foldX2[MAX_FOLDS], foldY2[MAX_FOLDS];
+    foldAmounts[0] = params[PARAM_FOLD_AMOUNT]->u.fs_d.value / 100.0;
+    foldX1[0] = (double)params[PARAM_FOLD_POINT1]->u.td.x_value / 65536.0;
+    foldY1[0] = (double)params[PARAM_FOLD_POINT1]->u.td.y_value / 65536.0;
+    foldX2[0] = (double)params[PARAM_FOLD_POINT2]->u.td.x_value / 65536.0;
+    foldY2[0] = (double)params[PARAM_FOLD_POINT2]->u.td.y_value / 65536.0;
+    for (int i = 1; i < MAX_FOLDS; i++) {
+        int base = PARAM_FOLD2_AMOUNT + (i - 1) * 3;
+        foldAmounts[i] = params[base]->u.fs_d.value / 100.0;
+        foldX1[i] = (double)params[base + 1]->u.td.x_value / 65536.0;
+        foldY1[i] = (double)params[base + 1]->u.td.y_value / 65536.0;
+        foldX2[i] = (double)params[base + 2]->u.td.x_value / 65536.0;
+        foldY2[i] = (double)params[base + 2]->u.td.y_value / 65536.0;
+        if (foldLayout == FOLD_LAYOUT_POLYLINE) {
+            foldX1[i] = foldX2[i - 1];
+            foldY1[i] = foldY2[i - 1];
+        }
+    }
+    
+    // These pixel values are used in noise-coordinate space (full resolution)
+    FoldSettings foldSettings;
+    foldSettings.lineRoughness = params[PARAM_FOLD_LINE_ROUGHNESS]->u.fs_d.value;
+    foldSettings.lineRoughScale = params[PARAM_FOLD_LINE_ROUGH_SCALE]->u.fs_d.value;
+    foldSettings.lineWidth = params[PARAM_FOLD_LINE_WIDTH]->u.fs_d.value;
+    foldSettings.sideAWidth = params[PARAM_FOLD_SIDE_A_WIDTH]->u.fs_d.value;
+    foldSettings.sideARoughness = params[PARAM_FOLD_SIDE_A_ROUGHNESS]->u.fs_d.value;
+    foldSettings.sideARoughScale = params[PARAM_FOLD_SIDE_A_ROUGH_SCALE]->u.fs_d.value;
+    foldSettings.sideAJagged = params[PARAM_FOLD_SIDE_A_JAGGEDNESS]->u.fs_d.value;
+    foldSettings.sideASoftness = 0.0;  // Hardcoded, control removed
+    foldSettings.sideBWidth = params[PARAM_FOLD_SIDE_B_WIDTH]->u.fs_d.value;
+    foldSettings.sideBRoughness = params[PARAM_FOLD_SIDE_B_ROUGHNESS]->u.fs_d.value;
+    foldSettings.sideBRoughScale = params[PARAM_FOLD_SIDE_B_ROUGH_SCALE]->u.fs_d.value;
+    foldSettings.sideBJagged = params[PARAM_FOLD_SIDE_B_JAGGEDNESS]->u.fs_d.value;
+    foldSettings.sideBSoftness = 0.0;  // Hardcoded, control removed
+    foldSettings.crackAmount = params[PARAM_FOLD_CRACK_AMOUNT]->u.fs_d.value / 100.0;
+    foldSettings.crackLength = params[PARAM_FOLD_CRACK_LENGTH]->u.fs_d.value;
+    foldSettings.crackLengthVar = params[PARAM_FOLD_CRACK_LENGTH_VAR]->u.fs_d.value / 100.0;
+    foldSettings.crackDensity = params[PARAM_FOLD_CRACK_DENSITY]->u.fs_d.value;
+    foldSettings.crackBranching = params[PARAM_FOLD_CRACK_BRANCHING]->u.fs_d.value / 100.0;
+    foldSettings.crackAngle = params[PARAM_FOLD_CRACK_ANGLE]->u.fs_d.value;
+    foldSettings.crackAngleVar = params[PARAM_FOLD_CRACK_ANGLE_VAR]->u.fs_d.value;
+    foldSettings.shadowAOpacity = params[PARAM_FOLD_SHADOW_A_OPACITY]->u.fs_d.value / 100.0;
+    foldSettings.shadowALength = params[PARAM_FOLD_SHADOW_A_LENGTH]->u.fs_d.value;
+    foldSettings.shadowAVariability = params[PARAM_FOLD_SHADOW_A_VARIABILITY]->u.fs_d.value / 100.0;
+    foldSettings.shadowBOpacity = params[PARAM_FOLD_SHADOW_B_OPACITY]->u.fs_d.value / 100.0;
+    foldSettings.shadowBLength = params[PARAM_FOLD_SHADOW_B_LENGTH]->u.fs_d.value;
+    foldSettings.shadowBVariability = params[PARAM_FOLD_SHADOW_B_VARIABILITY]->u.fs_d.value / 100.0;
+    foldSettings.scale = masterScale;
+    
+    plan.foldShadowAColor = params[PARAM_FOLD_SHADOW_A_COLOR]->u.cd.value;
+    plan.foldShadowBColor = params[PARAM_FOLD_SHADOW_B_COLOR]->u.cd.value;
     
     // Grunge
     double dirtAmount = params[PARAM_DIRT_AMOUNT]->u.fs_d.value;
     double dirtSize = params[PARAM_DIRT_SIZE]->u.fs_d.value;
-    double dirtOpacity = params[PARAM_DIRT_OPACITY]->u.fs_d.value / 100.0;
-    int dirtSeed = params[PARAM_DIRT_SEED]->u.sd.value;
+    int dirtSeed = params[PARAM_DIRT_SEED]->u.sd.value + boilOffset;
     PF_Pixel dirtColor = params[PARAM_DIRT_COLOR]->u.cd.value;
-    double dirtR = dirtColor.red / 255.0;
-    double dirtG = dirtColor.green / 255.0;
-    double dirtB = dirtColor.blue / 255.0;
+    plan.dirtOpacity = params[PARAM_DIRT_OPACITY]->u.fs_d.value / 100.0;
+    plan.dirtR = dirtColor.red / 255.0;
+    plan.dirtG = dirtColor.green / 255.0;
+    plan.dirtB = dirtColor.blue / 255.0;
     
     double smudgeAmount = params[PARAM_SMUDGE_AMOUNT]->u.fs_d.value;
     double smudgeSize = params[PARAM_SMUDGE_SIZE]->u.fs_d.value;
-    double smudgeOpacity = params[PARAM_SMUDGE_OPACITY]->u.fs_d.value / 100.0;
-    int smudgeSeed = params[PARAM_SMUDGE_SEED]->u.sd.value;
+    int smudgeSeed = params[PARAM_SMUDGE_SEED]->u.sd.value + boilOffset;
     PF_Pixel smudgeColor = params[PARAM_SMUDGE_COLOR]->u.cd.value;
-    double smudgeR = smudgeColor.red / 255.0;
-    double smudgeG = smudgeColor.green / 255.0;
-    double smudgeB = smudgeColor.blue / 255.0;
+    plan.smudgeOpacity = params[PARAM_SMUDGE_OPACITY]->u.fs_d.value / 100.0;
+    plan.smudgeR = smudgeColor.red / 255.0;
+    plan.smudgeG = smudgeColor.green / 255.0;
+    plan.smudgeB = smudgeColor.blue / 255.0;
     
     double dustAmount = params[PARAM_DUST_AMOUNT]->u.fs_d.value;
     double dustSize = params[PARAM_DUST_SIZE]->u.fs_d.value;
-    int dustSeed = params[PARAM_DUST_SEED]->u.sd.value;
+    int dustSeed = params[PARAM_DUST_SEED]->u.sd.value + boilOffset;
     PF_Pixel dustColor = params[PARAM_DUST_COLOR]->u.cd.value;
-    double dustR = dustColor.red / 255.0;
-    double dustG = dustColor.green / 255.0;
-    double dustB = dustColor.blue / 255.0;
-    
-    PF_EffectWorld* input = &params[PARAM_INPUT]->u.ld;
-    
-    int width = output->width;
-    int height = output->height;
-    
-    // Convert fold points from fixed point to pixels, scaled by downsample factor
-    // Fixed point format: upper 16 bits = integer, lower 16 bits = fraction
-    double fp1x = (double)fold1X / 65536.0;
-    double fp1y = (double)fold1Y / 65536.0;
-    double fp2x = (double)fold2X / 65536.0;
-    double fp2y = (double)fold2Y / 65536.0;
-    
-    // Build distance field
-    DistanceField df(width, height);
-    df.buildFromLayer(input);
-    
-    // Render
-    for (int y = 0; y < height; y++) {
-        PF_Pixel8* inRow = (PF_Pixel8*)((char*)input->data + y * input->rowbytes);
-        PF_Pixel8* outRow = (PF_Pixel8*)((char*)output->data + y * output->rowbytes);
-        
-        for (int x = 0; x < width; x++) {
-            double px = (double)x;
-            double py = (double)y;
-            
-            // Scale coordinates to full-resolution space for consistent noise sampling
-            double noisePx = px / downsampleFactor;
-            double noisePy = py / downsampleFactor;
-            
-            // signedDist is in canvas pixels - scale to full-res space
-            float signedDistRaw = df.getDist(x, y);
-            double signedDist = signedDistRaw / downsampleFactor;
-            float gradX, gradY;
-            df.getGradient(x, y, gradX, gradY);
-            
-            // Source pixel
-            double srcR = inRow[x].red / 255.0;
-            double srcG = inRow[x].green / 255.0;
-            double srcB = inRow[x].blue / 255.0;
-            double srcA = inRow[x].alpha / 255.0;
-            
-            // Edge displacements - use noise coordinates
-            double outerDisp = calcEdgeDisplacement(noisePx, noisePy, seed, 
-                outerRoughness, outerRoughScale, outerJaggedness, outerNotch, masterScale);
-            double innerDispRaw = calcEdgeDisplacement(noisePx + 1000, noisePy + 1000, seed + 5000,
-                innerRoughness, innerRoughScale, innerJaggedness, innerNotch, masterScale);
-            // Shift inner edge based on expansion control
-            double expansionFactor = (100.0 - innerExpansion) / 50.0;
-            double innerDispMaxEstimate = (innerRoughness + innerJaggedness * 0.5 + innerNotch * 0.3) * masterScale * expansionFactor;
-            double innerDisp = innerDispRaw - innerDispMaxEstimate;
-            
-            double halfGap = gapWidth / 2.0;
-            double outerEdge = -halfGap + outerDisp;
-            double innerEdge = halfGap + innerDisp;
-            
-            if (innerEdge < outerEdge + 2.0) {
-                double mid = (innerEdge + outerEdge) / 2.0;
-                innerEdge = mid + 1.0;
-                outerEdge = mid - 1.0;
-            }
-            
-            // Middle edges
-            double middle1Edge = outerEdge;
-            double middle2Edge = outerEdge;
-            
-            if (middle1Amount > 0) {
-                double m1Disp = calcEdgeDisplacement(noisePx + 2000, noisePy + 2000, seed + 10000,
-                    middle1Roughness, 100.0, middle1Roughness * 0.2, 0, masterScale);
-                double m1Base = outerEdge + (innerEdge - outerEdge) * middle1Position;
+    plan.dustR = dustColor.red / 255.0;
+    plan.dustG = dustColor.green / 255.0;
+    plan.dustB = dustColor.blue / 255.0;
+    
+    // Fields
+    plan.folds = foldField(downsampleFactor, seed, foldSettings, foldAmounts, foldX1, foldY1, foldX2, foldY2);
+    plan.outerDispField = edgeDisplacementField(width, height, downsampleFactor, adaptive,
+        0, seed, outerRoughness, outerRoughScale, outerJaggedness, outerNotch, masterScale);
+    plan.innerDispField = edgeDisplacementField(width, height, downsampleFactor, adaptive,
+        1000, seed + 5000, innerRoughness, innerRoughScale, innerJaggedness, innerNotch, masterScale);
+    if (plan.middle1Amount > 0) {
+        plan.middle1DispField = edgeDisplacementField(width, height, downsampleFactor, adaptive,
+            2000, seed + 10000, middle1Roughness, 100.0, middle1Roughness * 0.2, 0, masterScale);
+    }
+    if (plan.middle2Amount > 0) {
+        plan.middle2DispField = edgeDisplacementField(width, height, downsampleFactor, adaptive,
+            3000, seed + 15000, middle2Roughness, 100.0, middle2Roughness * 0.2, 0, masterScale);
+    }
+    if (plan.paperTexture > 0) {
+        plan.grainField = paperGrainField(width, height, downsampleFactor, adaptive, 3.0 * masterScale / downsampleFactor, seed);
+    }
+    if (dirtAmount > 0) {
+        plan.dirtPlane = dirtField(width, height, downsampleFactor, adaptive, dirtSeed, dirtSize, dirtAmount, masterScale);
+    }
+    if (smudgeAmount > 0) {
+        plan.smudgePlane = smudgeField(width, height, downsampleFactor, adaptive, smudgeSeed, smudgeSize, smudgeAmount, masterScale);
+    }
+    if (dustAmount > 0) {
+        plan.dust = dustField(width, height, downsampleFactor, dustSeed, dustSize, dustAmount, masterScale);
+    }
+    
+    // Render graph. Middle edges are only read by their fibers and their shadows.
+    bool middle1Fibers = plan.middle1Amount > 0 && plan.middle1FiberDensity > 0;
+    bool middle2Fibers = plan.middle2Amount > 0 && plan.middle2FiberDensity > 0;
+    bool middle1Shadow = plan.middle1Amount > 0 && plan.middle1Shadow > 0;
+    bool middle2Shadow = plan.middle2Amount > 0 && plan.middle2Shadow > 0;
+    
+    RenderGraph& graph = plan.graph;
+    graph.connect(NODE_MIDDLE, NODE_DISTANCE);
+    graph.connect(NODE_MATTE, NODE_DISTANCE);
+    graph.connect(NODE_MATTE, NODE_DISPLACEMENT);
+    graph.connect(NODE_FIBERS, NODE_MATTE);
+    if (middle1Fibers || middle2Fibers) graph.connect(NODE_FIBERS, NODE_MIDDLE);
+    graph.connect(NODE_PAPER, NODE_MATTE);
+    graph.connect(NODE_PAPER, NODE_FIBERS);
+    graph.connect(NODE_PAPER, NODE_TEXTURE);
+    if (middle1Shadow || middle2Shadow) graph.connect(NODE_PAPER, NODE_MIDDLE);
+    graph.connect(NODE_FOLD, NODE_MATTE);
+    graph.connect(NODE_GRUNGE, NODE_MATTE);
+    graph.connect(NODE_COMPOSITE, NODE_PAPER);
+    graph.connect(NODE_COMPOSITE, NODE_FOLD);
+    graph.connect(NODE_COMPOSITE, NODE_GRUNGE);
+    
+    graph.active = nodeBit(NODE_DISTANCE) | nodeBit(NODE_DISPLACEMENT) | nodeBit(NODE_MATTE) |
+        nodeBit(NODE_PAPER) | nodeBit(NODE_COMPOSITE);
+    // Vector edges carry no distances for fibers to follow, and trace the
+    // middle edges as polygons outside the graph
+    if (!plan.vectorEdges && (plan.middle1Amount > 0 || plan.middle2Amount > 0)) graph.active |= nodeBit(NODE_MIDDLE);
+    if (!plan.vectorEdges && plan.fiberOpacity > 0 && plan.fiberLength > 0 &&
+        (plan.fiberDensity > 0 || middle1Fibers || middle2Fibers)) graph.active |= nodeBit(NODE_FIBERS);
+    if (plan.paperTexture > 0) graph.active |= nodeBit(NODE_TEXTURE);
+    if (plan.folds->active()) graph.active |= nodeBit(NODE_FOLD);
+    if (plan.dirtPlane || plan.smudgePlane || plan.dust) graph.active |= nodeBit(NODE_GRUNGE);
+    
+    plan.stages = graph.resolve(graph.active);
+    
+    setupEdgeBounds(plan);
+}
+
+// Polygons the vector engine traces: the alpha contour pushed to each edge,
+// and to where each paper shadow ends
+enum TearPolygon {
+    TEAR_OUTER = 0,
+    TEAR_INNER,
+    TEAR_MIDDLE1,
+    TEAR_MIDDLE2,
+    TEAR_OUTER_SHADOW,      // outer edge pushed in by Shadow Width
+    TEAR_CONTENT_SHADOW,    // inner edge pushed out by Content Shadow Width
+    TEAR_MIDDLE1_SHADOW,    // middle edges pushed out by their shadow width
+    TEAR_MIDDLE2_SHADOW,
+    TEAR_POLYGON_COUNT
+};
+
+// Float32 planes for one output row. The input is deinterleaved into src*, the
+// geometry pass fills the coverage planes and the colour stages then run over
+// whole spans, so the blends vectorise.
+struct ShadeRow {
+    ShadeRow(FrameArena& arena, int width) {
+        float* p = arena.allocArray<float>((size_t)width * kPlanes);
+        memset(p, 0, (size_t)width * kPlanes * sizeof(float));
+        float** planes[kPlanes] = {
+            &srcR, &srcG, &srcB, &srcA,
+            &contentAlpha, &paperAlpha, &fiberAlpha, &fiberShadowAlpha, &fiberColorVar, &tex,
+            &shadeRG, &shadeB,
+            &backingR, &backingG, &backingB,
+            &paperR, &paperG, &paperB,
+            &r, &g, &b, &a,
+            &coverage,
+            &tearCover[TEAR_OUTER], &tearCover[TEAR_INNER], &tearCover[TEAR_MIDDLE1], &tearCover[TEAR_MIDDLE2],
+            &tearCover[TEAR_OUTER_SHADOW], &tearCover[TEAR_CONTENT_SHADOW],
+            &tearCover[TEAR_MIDDLE1_SHADOW], &tearCover[TEAR_MIDDLE2_SHADOW]
+        };
+        for (int i = 0; i < kPlanes; i++) *planes[i] = p + (size_t)i * width;
+    }
+    
+    enum { kPlanes = 23 + TEAR_POLYGON_COUNT };
+    
+    float *srcR, *srcG, *srcB, *srcA;
+    float *contentAlpha, *paperAlpha, *fiberAlpha, *fiberShadowAlpha, *fiberColorVar, *tex;
+    float *shadeRG, *shadeB;        // paper shadow multipliers
+    float *backingR, *backingG, *backingB;
+    float *paperR, *paperG, *paperB;
+    float *r, *g, *b, *a;
+    float *coverage;
+    float *tearCover[TEAR_POLYGON_COUNT];  // vector edge polygons
+};
+
+// Deinterleave [x0, x1) of one input row; pixels outside the input read as transparent black
+template<typename PixelT>
+inline void loadRow(PF_EffectWorld* input, int y, int x0, int x1, ShadeRow& row) {
+    typedef PixelTraits<PixelT> Traits;
+    
+    int inEnd = x0;
+    if (y >= 0 && y < input->height) {
+        inEnd = safeMax(x0, safeMin(x1, (int)input->width));
+        const PixelT* in = worldRow<PixelT>(input, y);
+        for (int x = x0; x < inEnd; x++) {
+            row.srcR[x] = Traits::toUnit(in[x].red);
+            row.srcG[x] = Traits::toUnit(in[x].green);
+            row.srcB[x] = Traits::toUnit(in[x].blue);
+            row.srcA[x] = Traits::toUnit(in[x].alpha);
+        }
+    }
+    for (int x = inEnd; x < x1; x++) {
+        row.srcR[x] = row.srcG[x] = row.srcB[x] = row.srcA[x] = 0.0f;
+    }
+}
+
+// Premultiply and re-interleave [x0, x1) of one row; out is the output pixel
+// for x0
+template<typename PixelT>
+inline void storeRow(const ShadeRow& row, int x0, int x1, PixelT* out) {
+    typedef PixelTraits<PixelT> Traits;
+    
+    for (int x = x0; x < x1; x++, out++) {
+        float a = row.a[x];
+        out->alpha = Traits::fromUnit(a);
+        out->red   = Traits::fromUnit(row.r[x] * a);
+        out->green = Traits::fromUnit(row.g[x] * a);
+        out->blue  = Traits::fromUnit(row.b[x] * a);
+    }
+}
+
+// Blend a flat colour over the span by coverage * opacity
+inline void blendColorSpan(float* r, float* g, float* b, const float* coverage, int n,
+    float opacity, float colorR, float colorG, float colorB)
+{
+    for (int x = 0; x < n; x++) {
+        float s = coverage[x] * opacity;
+        r[x] = r[x] * (1.0f - s) + colorR * s;
+        g[x] = g[x] * (1.0f - s) + colorG * s;
+        b[x] = b[x] * (1.0f - s) + colorB * s;
+    }
+}
+
+// Per-pixel geometry: edges, alphas, fibers and grain for [x0, x1) of one row.
+// This is where the noise is sampled, so it stays scalar and in double precision.
+template<bool Fibers, bool Middle, bool Texture>
+inline void shadeGeometry(const RenderPlan& plan, const DistanceField& df, int inputWidth, int inputHeight,
+    int y, int x0, int x1, ShadeRow& row)
+{
+    const double downsampleFactor = plan.downsampleFactor;
+    const int seed = plan.seed;
+    const double softness = plan.softness;
+    
+    // Get distance field values (clamp to input bounds)
+    int dfY = safeMax(0, safeMin(inputHeight - 1, y));
+    double noisePy = (double)y / downsampleFactor;
+    
+    for (int x = x0; x < x1; x++) {
+        // Scale coordinates to full-resolution space for consistent noise sampling
+        // At half res, pixel 50 should sample same noise as pixel 100 at full res
+        double noisePx = (double)x / downsampleFactor;
+        
+        int dfX = safeMax(0, safeMin(inputWidth - 1, x));
+        
+        // signedDist is in canvas pixels - scale to full-res space
+        double signedDist = df.getDist(dfX, dfY) / downsampleFactor;
+        
+        // Paper grain, shared by the backing and the paper colour
+        if (Texture) {
+            row.tex[x] = (float)((plan.grainField->at(x, y) - 0.5) * plan.paperTexture * 0.15);
+        }
+        
+        // Away from the band every edge term is known without sampling the noise
+        if (signedDist < plan.emptyBelow || signedDist > plan.contentAbove) {
+            row.contentAlpha[x] = signedDist > plan.contentAbove ? 1.0f : 0.0f;
+            row.paperAlpha[x] = 0.0f;
+            row.fiberAlpha[x] = 0.0f;
+            row.fiberShadowAlpha[x] = 0.0f;
+            row.fiberColorVar[x] = 0.5f;
+            row.shadeRG[x] = 1.0f;
+            row.shadeB[x] = 1.0f;
+            continue;
+        }
+        
+        float gradX, gradY;
+        df.getGradient(dfX, dfY, gradX, gradY);
+        
+        // Edge displacements - use noise coordinates for consistency
+        double outerDisp = plan.outerDispField->at(x, y);
+        double innerDisp = plan.innerDispField->at(x, y) - plan.innerDispShift;
+        
+        double outerEdge = -plan.halfGap + outerDisp;
+        double innerEdge = plan.halfGap + innerDisp;
+        
+        if (innerEdge < outerEdge + 2.0) {
+            double mid = (innerEdge + outerEdge) / 2.0;
+            innerEdge = mid + 1.0;
+            outerEdge = mid - 1.0;
+        }
+        
+        // Middle edges
+        double middle1Edge = outerEdge;
+        double middle2Edge = outerEdge;
+        
+        if (Middle) {
+            if (plan.middle1Amount > 0) {
+                double m1Disp = plan.middle1DispField->at(x, y);
+                double m1Base = outerEdge + (innerEdge - outerEdge) * plan.middle1Position;
                 middle1Edge = m1Base + m1Disp * 0.4;
                 middle1Edge = clamp(middle1Edge, outerEdge + 1.0, innerEdge - 1.0);
             }
             
-            if (middle2Amount > 0) {
-                double m2Disp = calcEdgeDisplacement(noisePx + 3000, noisePy + 3000, seed + 15000,
-                    middle2Roughness, 100.0, middle2Roughness * 0.2, 0, masterScale);
-                double m2Base = outerEdge + (innerEdge - outerEdge) * middle2Position;
+            if (plan.middle2Amount > 0) {
+                double m2Disp = plan.middle2DispField->at(x, y);
+                double m2Base = outerEdge + (innerEdge - outerEdge) * plan.middle2Position;
                 middle2Edge = m2Base + m2Disp * 0.4;
                 middle2Edge = clamp(middle2Edge, outerEdge + 1.0, innerEdge - 1.0);
             }
+        }
+        
+        // Alphas
+        double contentAlpha = smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
+        
+        double paperAlpha = 0.0;
+        if (signedDist <= outerEdge - softness) {
+            paperAlpha = 0.0;
+        } else if (signedDist >= innerEdge + softness) {
+            paperAlpha = 0.0;
+        } else if (signedDist > outerEdge + softness && signedDist < innerEdge - softness) {
+            paperAlpha = 1.0;
+        } else if (signedDist <= outerEdge + softness) {
+            paperAlpha = smoothstep(outerEdge - softness, outerEdge + softness, signedDist);
+        } else {
+            paperAlpha = 1.0 - smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
+        }
+        
+        // Fibers - use noise coordinates for consistency
+        double fiberAlpha = 0.0;
+        double fiberShadowAlpha = 0.0;
+        double fiberColorVariation = 0.5;
+        double outerFiberExtent = 0.0;
+        
+        if (Fibers) {
+            FiberFieldResult outerFibers = fiberField(noisePx, noisePy, signedDist - outerEdge, gradX, gradY,
+                plan.fiberDensity, plan.fiberLength, plan.fiberThickness, plan.fiberSpread,
+                plan.fiberSoftness, plan.fiberFeather, plan.fiberRange, seed + 1000);
             
-            // Alphas
-            double softness = safeMax(0.5, edgeSoftness);
-            double contentAlpha = smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
-            
-            double paperAlpha = 0.0;
-            if (signedDist <= outerEdge - softness) {
-                paperAlpha = 0.0;
-            } else if (signedDist >= innerEdge + softness) {
-                paperAlpha = 0.0;
-            } else if (signedDist > outerEdge + softness && signedDist < innerEdge - softness) {
-                paperAlpha = 1.0;
-            } else if (signedDist <= outerEdge + softness) {
-                paperAlpha = smoothstep(outerEdge - softness, outerEdge + softness, signedDist);
-            } else {
-                paperAlpha = 1.0 - smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
-            }
-            
-            // Fibers
-            FiberFieldResult outerFibers = fiberField(px, py, signedDist - outerEdge, gradX, gradY,
-                fiberDensity, fiberLength, fiberThickness, fiberSpread, 
-                fiberSoftness, fiberFeather, fiberRange, seed + 1000);
-            
-            FiberFieldResult innerFibers = fiberField(px, py, signedDist - innerEdge, -gradX, -gradY,
-                fiberDensity * 0.7, fiberLength * 0.8, fiberThickness, fiberSpread,
-                fiberSoftness, fiberFeather, fiberRange, seed + 2000);
+            FiberFieldResult innerFibers = fiberField(noisePx, noisePy, signedDist - innerEdge, -gradX, -gradY,
+                plan.fiberDensity * 0.7, plan.fiberLength * 0.8, plan.fiberThickness, plan.fiberSpread,
+                plan.fiberSoftness, plan.fiberFeather, plan.fiberRange, seed + 2000);
             
             FiberFieldResult middle1Fibers = {0, 0, 0.5, 0};
             FiberFieldResult middle2Fibers = {0, 0, 0.5, 0};
             
-            if (middle1Amount > 0 && middle1FiberDensity > 0) {
-                middle1Fibers = fiberField(px, py, signedDist - middle1Edge, -gradX, -gradY,
-                    middle1FiberDensity, fiberLength * 0.6, fiberThickness, fiberSpread,
-                    fiberSoftness, fiberFeather, fiberRange * 0.5, seed + 3000);
-                middle1Fibers.opacity *= middle1Amount;
-                middle1Fibers.shadowOpacity *= middle1Amount;
+            if (Middle && plan.middle1Amount > 0 && plan.middle1FiberDensity > 0) {
+                middle1Fibers = fiberField(noisePx, noisePy, signedDist - middle1Edge, -gradX, -gradY,
+                    plan.middle1FiberDensity, plan.fiberLength * 0.6, plan.fiberThickness, plan.fiberSpread,
+                    plan.fiberSoftness, plan.fiberFeather, plan.fiberRange * 0.5, seed + 3000);
+                middle1Fibers.opacity *= plan.middle1Amount;
+                middle1Fibers.shadowOpacity *= plan.middle1Amount;
             }
             
-            if (middle2Amount > 0 && middle2FiberDensity > 0) {
-                middle2Fibers = fiberField(px, py, signedDist - middle2Edge, -gradX, -gradY,
-                    middle2FiberDensity, fiberLength * 0.6, fiberThickness, fiberSpread,
-                    fiberSoftness, fiberFeather, fiberRange * 0.5, seed + 4000);
-                middle2Fibers.opacity *= middle2Amount;
-                middle2Fibers.shadowOpacity *= middle2Amount;
+            if (Middle && plan.middle2Amount > 0 && plan.middle2FiberDensity > 0) {
+                middle2Fibers = fiberField(noisePx, noisePy, signedDist - middle2Edge, -gradX, -gradY,
+                    plan.middle2FiberDensity, plan.fiberLength * 0.6, plan.fiberThickness, plan.fiberSpread,
+                    plan.fiberSoftness, plan.fiberFeather, plan.fiberRange * 0.5, seed + 4000);
+                middle2Fibers.opacity *= plan.middle2Amount;
+                middle2Fibers.shadowOpacity *= plan.middle2Amount;
             }
             
-            double fiberAlpha = safeMax(safeMax(outerFibers.opacity, innerFibers.opacity),
-                                        safeMax(middle1Fibers.opacity, middle2Fibers.opacity));
-            fiberAlpha *= fiberOpacity;
+            fiberAlpha = safeMax(safeMax(outerFibers.opacity, innerFibers.opacity),
+                                 safeMax(middle1Fibers.opacity, middle2Fibers.opacity));
+            fiberAlpha *= plan.fiberOpacity;
             
-            double fiberShadowAlpha = safeMax(safeMax(outerFibers.shadowOpacity, innerFibers.shadowOpacity),
-                                              safeMax(middle1Fibers.shadowOpacity, middle2Fibers.shadowOpacity));
-            fiberShadowAlpha *= fiberOpacity;
+            fiberShadowAlpha = safeMax(safeMax(outerFibers.shadowOpacity, innerFibers.shadowOpacity),
+                                       safeMax(middle1Fibers.shadowOpacity, middle2Fibers.shadowOpacity));
+            fiberShadowAlpha *= plan.fiberOpacity;
+            
+            double maxFiberOp = fiberAlpha / plan.fiberOpacityDivisor;
+            outerFiberExtent = outerFibers.maxExtent;
             
-            double fiberColorVariation = 0.5;
-            double maxFiberOp = fiberAlpha / safeMax(0.001, fiberOpacity);
             if (outerFibers.opacity >= maxFiberOp - 0.01) fiberColorVariation = outerFibers.colorVar;
             else if (innerFibers.opacity >= maxFiberOp - 0.01) fiberColorVariation = innerFibers.colorVar;
             
-            if (fiberBlur > 0 && fiberAlpha > 0) {
-                double blurFactor = 1.0 / (1.0 + fiberBlur * 0.2);
-                fiberAlpha *= blurFactor;
-                fiberShadowAlpha *= blurFactor;
+            if (plan.fiberBlur && fiberAlpha > 0) {
+                fiberAlpha *= plan.fiberBlurFactor;
+                fiberShadowAlpha *= plan.fiberBlurFactor;
             }
+        }
+        
+        double totalPaperAlpha = safeMax(paperAlpha, fiberAlpha);
+        
+        // Paper shadows cast by the middle tears, the outer fibers and the content edge
+        double shadeRG = 1.0, shadeB = 1.0;
+        if (plan.paperShadows && totalPaperAlpha > 0.01) {
+            double shadows[4] = {0, 0, 0, 0};
             
-            double totalPaperAlpha = safeMax(paperAlpha, fiberAlpha);
-            
-            // Paper backing color with texture
-            double backingR = paperBaseR;
-            double backingG = paperBaseG;
-            double backingB = paperBaseB;
-            
-            if (paperTexture > 0) {
-                double texScale = 3.0 * masterScale;
-                double grain1 = fbm2D(px / texScale, py / texScale, seed + 7000, 3, 0.5);
-                double grain2 = valueNoise2D(px / (texScale * 0.5), py / (texScale * 0.5), seed + 8000);
-                double streaks = fbm2D(px / (texScale * 0.67), py / (texScale * 5.0), seed + 9000, 2, 0.6);
-                
-                double tex = grain1 * 0.5 + grain2 * 0.3 + streaks * 0.2;
-                tex = (tex - 0.5) * paperTexture * 0.15;
-                
-                backingR = clamp01(backingR + tex);
-                backingG = clamp01(backingG + tex);
-                backingB = clamp01(backingB + tex * 0.9);
+            if (Middle && plan.middle1Amount > 0 && plan.middle1Shadow > 0) {
+                double distFromMiddle1 = middle1Edge - signedDist;
+                double m1ShadowWidth = plan.shadowWidth * 0.4;
+                if (distFromMiddle1 > 0 && distFromMiddle1 < m1ShadowWidth) {
+                    double shadowFactor = 1.0 - (distFromMiddle1 / m1ShadowWidth);
+                    shadows[0] = shadowFactor * shadowFactor * plan.middle1Shadow * plan.middle1Amount * 0.35;
+                }
             }
             
-            // Paper color
-            double paperR = paperBaseR, paperG = paperBaseG, paperB = paperBaseB;
-            
-            if (totalPaperAlpha > 0.01) {
-                if (fiberShadow > 0 && fiberShadowAlpha > 0.01) {
-                    double shadowStr = fiberShadowAlpha * fiberShadow * 0.4;
-                    paperR *= (1.0 - shadowStr);
-                    paperG *= (1.0 - shadowStr);
-                    paperB *= (1.0 - shadowStr * 0.8);
-                }
-                
-                if (fiberAlpha > 0.05) {
-                    double colorShift = (fiberColorVariation - 0.5) * fiberColorVar * 0.25;
-                    double fR = fiberBaseR * (1.0 + colorShift * 0.3);
-                    double fG = fiberBaseG * (1.0 + colorShift * 0.2);
-                    double fB = fiberBaseB * (1.0 + colorShift * 0.1);
-                    
-                    double fiberBlend = fiberAlpha * 0.6;
-                    paperR = paperR * (1.0 - fiberBlend) + clamp01(fR) * fiberBlend;
-                    paperG = paperG * (1.0 - fiberBlend) + clamp01(fG) * fiberBlend;
-                    paperB = paperB * (1.0 - fiberBlend) + clamp01(fB) * fiberBlend;
-                }
-                
-                if (paperTexture > 0) {
-                    double texScale = 3.0 * masterScale;
-                    double grain1 = fbm2D(px / texScale, py / texScale, seed + 7000, 3, 0.5);
-                    double grain2 = valueNoise2D(px / (texScale * 0.5), py / (texScale * 0.5), seed + 8000);
-                    double streaks = fbm2D(px / (texScale * 0.67), py / (texScale * 5.0), seed + 9000, 2, 0.6);
-                    
-                    double tex = grain1 * 0.5 + grain2 * 0.3 + streaks * 0.2;
-                    tex = (tex - 0.5) * paperTexture * 0.15;
-                    
-                    paperR = clamp01(paperR + tex);
-                    paperG = clamp01(paperG + tex);
-                    paperB = clamp01(paperB + tex * 0.9);
-                }
-                
-                // Middle shadows
-                if (middle1Amount > 0 && middle1Shadow > 0) {
-                    double distFromMiddle1 = middle1Edge - signedDist;
-                    double m1ShadowWidth = shadowWidth * 0.4;
-                    if (distFromMiddle1 > 0 && distFromMiddle1 < m1ShadowWidth) {
-                        double shadowFactor = 1.0 - (distFromMiddle1 / m1ShadowWidth);
-                        shadowFactor = shadowFactor * shadowFactor;
-                        double shadow = shadowFactor * middle1Shadow * middle1Amount * 0.35;
-                        paperR *= (1.0 - shadow);
-                        paperG *= (1.0 - shadow);
-                        paperB *= (1.0 - shadow * 0.8);
-                    }
-                }
-                
-                if (middle2Amount > 0 && middle2Shadow > 0) {
-                    double distFromMiddle2 = middle2Edge - signedDist;
-                    double m2ShadowWidth = shadowWidth * 0.4;
-                    if (distFromMiddle2 > 0 && distFromMiddle2 < m2ShadowWidth) {
-                        double shadowFactor = 1.0 - (distFromMiddle2 / m2ShadowWidth);
-                        shadowFactor = shadowFactor * shadowFactor;
-                        double shadow = shadowFactor * middle2Shadow * middle2Amount * 0.35;
-                        paperR *= (1.0 - shadow);
-                        paperG *= (1.0 - shadow);
-                        paperB *= (1.0 - shadow * 0.8);
-                    }
-                }
-                
-                // Outer shadow
-                if (shadowAmount > 0) {
-                    double fiberExtent = outerFibers.maxExtent;
-                    double shadowStart = outerEdge + fiberExtent;
-                    double distFromShadowStart = signedDist - shadowStart;
-                    if (distFromShadowStart > 0 && distFromShadowStart < shadowWidth) {
-                        double shadowFactor = 1.0 - (distFromShadowStart / shadowWidth);
-                        shadowFactor = shadowFactor * shadowFactor;
-                        double shadow = shadowFactor * shadowAmount * 0.4;
-                        paperR *= (1.0 - shadow);
-                        paperG *= (1.0 - shadow);
-                        paperB *= (1.0 - shadow * 0.8);
-                    }
-                }
-                
-                // Inner shadow
-                if (innerShadowAmount > 0) {
-                    double distFromInner = innerEdge - signedDist;
-                    if (distFromInner > 0 && distFromInner < innerShadowWidth) {
-                        double shadowFactor = 1.0 - (distFromInner / innerShadowWidth);
-                        shadowFactor = shadowFactor * shadowFactor;
-                        double shadow = shadowFactor * innerShadowAmount * 0.5;
-                        paperR *= (1.0 - shadow);
-                        paperG *= (1.0 - shadow);
-                        paperB *= (1.0 - shadow * 0.8);
-                    }
+            if (Middle && plan.middle2Amount > 0 && plan.middle2Shadow > 0) {
+                double distFromMiddle2 = middle2Edge - signedDist;
+                double m2ShadowWidth = plan.shadowWidth * 0.4;
+                if (distFromMiddle2 > 0 && distFromMiddle2 < m2ShadowWidth) {
+                    double shadowFactor = 1.0 - (distFromMiddle2 / m2ShadowWidth);
+                    shadows[1] = shadowFactor * shadowFactor * plan.middle2Shadow * plan.middle2Amount * 0.35;
                 }
             }
             
-            // Composite
-            double finalR, finalG, finalB, finalA;
-            
-            if (contentAlpha > 0.01) {
-                if (srcA > 0.99) {
-                    finalR = srcR;
-                    finalG = srcG;
-                    finalB = srcB;
-                    finalA = 1.0;
-                } else {
-                    finalR = srcR * srcA + backingR * (1.0 - srcA);
-                    finalG = srcG * srcA + backingG * (1.0 - srcA);
-                    finalB = srcB * srcA + backingB * (1.0 - srcA);
-                    finalA = 1.0;
-                }
-                
-                // Apply fold mark to content
-                if (foldAmount > 0) {
-                    double crackStrength, foldShadowAStr, foldShadowBStr;
-                    foldCrease(px, py, seed + 50000, fp1x, fp1y, fp2x, fp2y,
-                        foldLineRoughness, foldLineRoughScale, foldLineWidth,
-                        foldSideAWidth, foldSideARoughness, foldSideARoughScale, foldSideAJagged, foldSideASoftness,
-                        foldSideBWidth, foldSideBRoughness, foldSideBRoughScale, foldSideBJagged, foldSideBSoftness,
-                        foldCrackAmount, foldCrackLength, foldCrackLengthVar, foldCrackDensity, foldCrackBranching,
-                        foldCrackAngle, foldCrackAngleVar,
-                        foldShadowAOpacity, foldShadowALength, foldShadowAVariability,
-                        foldShadowBOpacity, foldShadowBLength, foldShadowBVariability,
-                        masterScale,
-                        crackStrength, foldShadowAStr, foldShadowBStr);
-                    
-                    // Blend paper through at crack
-                    // Apply foldAmount as a multiplier, but ensure 100% fold amount allows full crack visibility
-                    crackStrength *= foldAmount;
-                    if (crackStrength > 0) {
-                        // Use a steeper curve so cracks are more opaque
-                        double effectiveCrack = clamp01(crackStrength * 1.5);
-                        finalR = finalR * (1.0 - effectiveCrack) + backingR * effectiveCrack;
-                        finalG = finalG * (1.0 - effectiveCrack) + backingG * effectiveCrack;
-                        finalB = finalB * (1.0 - effectiveCrack) + backingB * effectiveCrack;
-                    }
-                    
-                    // Apply shadow A (highlight - typically white)
-                    foldShadowAStr *= foldAmount;
-                    if (foldShadowAStr > 0) {
-                        double shAR = foldShadowAColor.red / 255.0;
-                        double shAG = foldShadowAColor.green / 255.0;
-                        double shAB = foldShadowAColor.blue / 255.0;
-                        double effectiveShadowA = clamp01(foldShadowAStr);
-                        finalR = finalR * (1.0 - effectiveShadowA) + shAR * effectiveShadowA;
-                        finalG = finalG * (1.0 - effectiveShadowA) + shAG * effectiveShadowA;
-                        finalB = finalB * (1.0 - effectiveShadowA) + shAB * effectiveShadowA;
-                    }
-                    
-                    // Apply shadow B (shadow - typically black)
-                    foldShadowBStr *= foldAmount;
-                    if (foldShadowBStr > 0) {
-                        double shBR = foldShadowBColor.red / 255.0;
-                        double shBG = foldShadowBColor.green / 255.0;
-                        double shBB = foldShadowBColor.blue / 255.0;
-                        double effectiveShadowB = clamp01(foldShadowBStr);
-                        finalR = finalR * (1.0 - effectiveShadowB) + shBR * effectiveShadowB;
-                        finalG = finalG * (1.0 - effectiveShadowB) + shBG * effectiveShadowB;
-                        finalB = finalB * (1.0 - effectiveShadowB) + shBB * effectiveShadowB;
-                    }
-                }
-                
-                // Apply grunge
-                if (dirtAmount > 0) {
-                    double dirt = organicDirt(px, py, seed + 30000, dirtSize, dirtAmount, masterScale);
-                    double dirtStr = dirt * dirtOpacity;
-                    finalR = finalR * (1.0 - dirtStr) + dirtR * dirtStr;
-                    finalG = finalG * (1.0 - dirtStr) + dirtG * dirtStr;
-                    finalB = finalB * (1.0 - dirtStr) + dirtB * dirtStr;
-                }
-                
-                if (smudgeAmount > 0) {
-                    double smudge = organicSmudge(px, py, seed + 31000, smudgeSize, smudgeAmount, masterScale);
-                    double smudgeStr = smudge * smudgeOpacity;
-                    finalR = finalR * (1.0 - smudgeStr) + smudgeR * smudgeStr;
-                    finalG = finalG * (1.0 - smudgeStr) + smudgeG * smudgeStr;
-                    finalB = finalB * (1.0 - smudgeStr) + smudgeB * smudgeStr;
-                }
-                
-                if (dustAmount > 0) {
-                    double dust = dustParticles(px, py, dustSeed, dustSize, dustAmount, masterScale);
-                    if (dust > 0) {
-                        finalR = finalR * (1.0 - dust) + dustR * dust;
-                        finalG = finalG * (1.0 - dust) + dustG * dust;
-                        finalB = finalB * (1.0 - dust) + dustB * dust;
-                    }
+            if (plan.shadowAmount > 0) {
+                double distFromShadowStart = signedDist - (outerEdge + outerFiberExtent);
+                if (distFromShadowStart > 0 && distFromShadowStart < plan.shadowWidth) {
+                    double shadowFactor = 1.0 - (distFromShadowStart / plan.shadowWidth);
+                    shadows[2] = shadowFactor * shadowFactor * plan.shadowAmount * 0.4;
                 }
-                
-                if (contentAlpha < 0.99) {
-                    finalR = finalR * contentAlpha + paperR * (1.0 - contentAlpha);
-                    finalG = finalG * contentAlpha + paperG * (1.0 - contentAlpha);
-                    finalB = finalB * contentAlpha + paperB * (1.0 - contentAlpha);
-                    finalA = finalA * contentAlpha + totalPaperAlpha * (1.0 - contentAlpha);
+            }
+            
+            if (plan.contentShadowAmount > 0) {
+                double distFromInner = innerEdge - signedDist;
+                if (distFromInner > 0 && distFromInner < plan.contentShadowWidth) {
+                    double shadowFactor = 1.0 - (distFromInner / plan.contentShadowWidth);
+                    shadows[3] = shadowFactor * shadowFactor * plan.contentShadowAmount * 0.5;
                 }
-            } else {
-                finalR = paperR;
-                finalG = paperG;
-                finalB = paperB;
-                finalA = totalPaperAlpha;
             }
             
-            finalA = clamp01(finalA);
-            outRow[x].alpha = (A_u_char)(finalA * 255.0);
-            outRow[x].red   = (A_u_char)(clamp01(finalR) * finalA * 255.0);
-            outRow[x].green = (A_u_char)(clamp01(finalG) * finalA * 255.0);
-            outRow[x].blue  = (A_u_char)(clamp01(finalB) * finalA * 255.0);
+            for (int i = 0; i < 4; i++) {
+                shadeRG *= (1.0 - shadows[i]);
+                shadeB *= (1.0 - shadows[i] * 0.8);
+            }
         }
+        
+        row.contentAlpha[x] = (float)contentAlpha;
+        row.paperAlpha[x] = (float)totalPaperAlpha;
+        row.shadeRG[x] = (float)shadeRG;
+        row.shadeB[x] = (float)shadeB;
+        row.fiberAlpha[x] = (float)fiberAlpha;
+        row.fiberShadowAlpha[x] = (float)fiberShadowAlpha;
+        row.fiberColorVar[x] = (float)fiberColorVariation;
+    }
+}
+
+// Backing and paper colours for the span: fiber shadow, fiber tint, grain, paper shadows
+template<bool Fibers, bool Texture>
+inline void shadePaperSpan(const RenderPlan& plan, ShadeRow& row, int x0, int x1) {
+    const float baseR = (float)plan.paperBaseR;
+    const float baseG = (float)plan.paperBaseG;
+    const float baseB = (float)plan.paperBaseB;
+    const float fiberShadow = (float)(plan.fiberShadow * 0.4);
+    const float colorVarScale = (float)(plan.fiberColorVar * 0.25);
+    const float fiberR = (float)plan.fiberBaseR;
+    const float fiberG = (float)plan.fiberBaseG;
+    const float fiberB = (float)plan.fiberBaseB;
+    
+    for (int x = x0; x < x1; x++) {
+        float tex = Texture ? row.tex[x] : 0.0f;
+        row.backingR[x] = clamp01f(baseR + tex);
+        row.backingG[x] = clamp01f(baseG + tex);
+        row.backingB[x] = clamp01f(baseB + tex * 0.9f);
     }
     
-    return err;
+    for (int x = x0; x < x1; x++) {
+        // Paper colour only changes where there is paper to see
+        bool visible = row.paperAlpha[x] > 0.01f;
+        float pR = baseR, pG = baseG, pB = baseB;
+        
+        if (Fibers) {
+            float shadowStr = (visible && row.fiberShadowAlpha[x] > 0.01f) ? row.fiberShadowAlpha[x] * fiberShadow : 0.0f;
+            pR *= (1.0f - shadowStr);
+            pG *= (1.0f - shadowStr);
+            pB *= (1.0f - shadowStr * 0.8f);
+            
+            float colorShift = (row.fiberColorVar[x] - 0.5f) * colorVarScale;
+            float fiberBlend = (visible && row.fiberAlpha[x] > 0.05f) ? row.fiberAlpha[x] * 0.6f : 0.0f;
+            pR = pR * (1.0f - fiberBlend) + clamp01f(fiberR * (1.0f + colorShift * 0.3f)) * fiberBlend;
+            pG = pG * (1.0f - fiberBlend) + clamp01f(fiberG * (1.0f + colorShift * 0.2f)) * fiberBlend;
+            pB = pB * (1.0f - fiberBlend) + clamp01f(fiberB * (1.0f + colorShift * 0.1f)) * fiberBlend;
+        }
+        
+        if (Texture) {
+            float tex = visible ? row.tex[x] : 0.0f;
+            pR = clamp01f(pR + tex);
+            pG = clamp01f(pG + tex);
+            pB = clamp01f(pB + tex * 0.9f);
+        }
+        
+        row.paperR[x] = pR * row.shadeRG[x];
+        row.paperG[x] = pG * row.shadeRG[x];
+        row.paperB[x] = pB * row.shadeB[x];
+    }
 }
 
-// ============================================================
-// SMART RENDER IMPLEMENTATION
-// ============================================================
+// Q15 planes for the 8-bit compositing path
+struct FixedRow {
+    FixedRow(FrameArena& arena, int width) {
+        int16_t* p = arena.allocArray<int16_t>((size_t)width * kPlanes);
+        memset(p, 0, (size_t)width * kPlanes * sizeof(int16_t));
+        int16_t** planes[kPlanes] = {
+            &srcR, &srcG, &srcB, &srcA,
+            &backingR, &backingG, &backingB,
+            &paperR, &paperG, &paperB,
+            &r, &g, &b, &a,
+            &t
+        };
+        for (int i = 0; i < kPlanes; i++) *planes[i] = p + (size_t)i * width;
+    }
+    
+    enum { kPlanes = 15 };
+    
+    int16_t *srcR, *srcG, *srcB, *srcA;
+    int16_t *backingR, *backingG, *backingB;
+    int16_t *paperR, *paperG, *paperB;
+    int16_t *r, *g, *b, *a;
+    int16_t *t;
+};
+
+inline void toQ15Span(const float* in, int16_t* out, int n) {
+    for (int x = 0; x < n; x++) out[x] = toQ15(in[x]);
+}
+
+// 8-bit compositing in Q15 fixed point for [x0, x1) of one row: the same stages
+// as the float path, with every blend a fixed-point lerp and the output rounded,
+// not truncated. out is the output pixel for x0.
+template<bool Fold, bool Grunge>
+inline void compositeRow8(const RenderPlan& plan, PF_EffectWorld* input, int y, int x0, int x1,
+    ShadeRow& row, FixedRow& q, PF_Pixel8* out)
+{
+    const int n = x1 - x0;
+    
+    // Source pixels; outside the input reads as transparent black
+    int inEnd = x0;
+    if (y >= 0 && y < input->height) {
+        inEnd = safeMax(x0, safeMin(x1, (int)input->width));
+        const PF_Pixel8* in = worldRow<PF_Pixel8>(input, y);
+        for (int x = x0; x < inEnd; x++) {
+            q.srcR[x] = q15From8(in[x].red);
+            q.srcG[x] = q15From8(in[x].green);
+            q.srcB[x] = q15From8(in[x].blue);
+            q.srcA[x] = in[x].alpha > 252 ? (int16_t)Q15_ONE : q15From8(in[x].alpha);
+        }
+    }
+    for (int x = inEnd; x < x1; x++) {
+        q.srcR[x] = q.srcG[x] = q.srcB[x] = q.srcA[x] = 0;
+    }
+    
+    toQ15Span(row.backingR + x0, q.backingR + x0, n);
+    toQ15Span(row.backingG + x0, q.backingG + x0, n);
+    toQ15Span(row.backingB + x0, q.backingB + x0, n);
+    toQ15Span(row.paperR + x0, q.paperR + x0, n);
+    toQ15Span(row.paperG + x0, q.paperG + x0, n);
+    toQ15Span(row.paperB + x0, q.paperB + x0, n);
+    
+    // Content over the paper backing
+    lerpQ15Span(q.backingR + x0, q.srcR + x0, q.srcA + x0, q.r + x0, n);
+    lerpQ15Span(q.backingG + x0, q.srcG + x0, q.srcA + x0, q.g + x0, n);
+    lerpQ15Span(q.backingB + x0, q.srcB + x0, q.srcA + x0, q.b + x0, n);
+    
+    // Apply fold marks - use noise coordinates
+    if (Fold) {
+        double noisePy = (double)y / plan.downsampleFactor;
+        for (int x = x0; x < x1; x++) {
+            if (row.contentAlpha[x] <= 0.01f) continue;
+            double finalR = q.r[x] / (double)Q15_ONE;
+            double finalG = q.g[x] / (double)Q15_ONE;
+            double finalB = q.b[x] / (double)Q15_ONE;
+            applyFolds(*plan.folds, (double)x / plan.downsampleFactor, noisePy,
+                row.backingR[x], row.backingG[x], row.backingB[x],
+                plan.foldShadowAColor, plan.foldShadowBColor, finalR, finalG, finalB);
+            q.r[x] = toQ15(clamp01f((float)finalR));
+            q.g[x] = toQ15(clamp01f((float)finalG));
+            q.b[x] = toQ15(clamp01f((float)finalB));
+        }
+    }
+    
+    // Apply grunge
+    if (Grunge) {
+        if (plan.dirtPlane) {
+            float opacity = (float)plan.dirtOpacity;
+            for (int x = x0; x < x1; x++) q.t[x] = toQ15(plan.dirtPlane->at(x, y) * opacity);
+            lerpQ15SpanToConst(q.r + x0, toQ15((float)plan.dirtR), q.t + x0, n);
+            lerpQ15SpanToConst(q.g + x0, toQ15((float)plan.dirtG), q.t + x0, n);
+            lerpQ15SpanToConst(q.b + x0, toQ15((float)plan.dirtB), q.t + x0, n);
+        }
+        
+        if (plan.smudgePlane) {
+            float opacity = (float)plan.smudgeOpacity;
+            for (int x = x0; x < x1; x++) q.t[x] = toQ15(plan.smudgePlane->at(x, y) * opacity);
+            lerpQ15SpanToConst(q.r + x0, toQ15((float)plan.smudgeR), q.t + x0, n);
+            lerpQ15SpanToConst(q.g + x0, toQ15((float)plan.smudgeG), q.t + x0, n);
+            lerpQ15SpanToConst(q.b + x0, toQ15((float)plan.smudgeB), q.t + x0, n);
+        }
+        
+        if (plan.dust) {
+            for (int x = x0; x < x1; x++) q.t[x] = toQ15(plan.dust->at(x, y));
+            lerpQ15SpanToConst(q.r + x0, toQ15((float)plan.dustR), q.t + x0, n);
+            lerpQ15SpanToConst(q.g + x0, toQ15((float)plan.dustG), q.t + x0, n);
+            lerpQ15SpanToConst(q.b + x0, toQ15((float)plan.dustB), q.t + x0, n);
+        }
+    }
+    
+    // Content fades into the paper across the inner edge
+    for (int x = x0; x < x1; x++) {
+        float c = row.contentAlpha[x];
+        q.t[x] = toQ15(c <= 0.01f ? 0.0f : (c < 0.99f ? c : 1.0f));
+        q.a[x] = toQ15(clamp01f(row.paperAlpha[x]));
+    }
+    lerpQ15Span(q.paperR + x0, q.r + x0, q.t + x0, q.r + x0, n);
+    lerpQ15Span(q.paperG + x0, q.g + x0, q.t + x0, q.g + x0, n);
+    lerpQ15Span(q.paperB + x0, q.b + x0, q.t + x0, q.b + x0, n);
+    lerpQ15SpanToConst(q.a + x0, Q15_ONE, q.t + x0, n);
+    
+    // Premultiply and round to 8 bits
+    for (int x = x0; x < x1; x++, out++) {
+        int16_t a = q.a[x];
+        out->alpha = q15To8(a);
+        out->red   = q15To8(mulQ15(q.r[x], a));
+        out->green = q15To8(mulQ15(q.g[x], a));
+        out->blue  = q15To8(mulQ15(q.b[x], a));
+    }
+}
+
+// Tiles are classified before shading. Empty tiles hold no paper, fiber or
+// content and come out transparent black; solid tiles lie deep inside opaque
+// content that no fold or grunge touches and come out as the input pixels.
+// Only band tiles run the shader.
+enum { RENDER_TILE_SIZE = 64 };
+
+enum TileKind {
+    TILE_BAND = 0,
+    TILE_EMPTY,
+    TILE_SOLID
+};
+
+struct TileMap {
+    int tilesX, tilesY;
+    std::vector<unsigned char> kinds;
+    std::vector<unsigned char> stages;  // plan stages left after per-tile culling
+    
+    int at(int tx, int ty) const { return kinds[ty * tilesX + tx]; }
+    int stagesAt(int tx, int ty) const { return stages[ty * tilesX + tx]; }
+};
+
+// True when every pixel of the block is fully opaque with channels in 0..1,
+// so the shader would return it unchanged
+template<typename PixelT>
+inline bool opaqueBlock(PF_EffectWorld* input, int x0, int y0, int x1, int y1) {
+    typedef PixelTraits<PixelT> Traits;
+    
+    for (int y = y0; y < y1; y++) {
+        const PixelT* in = worldRow<PixelT>(input, y);
+        for (int x = x0; x < x1; x++) {
+            float r = Traits::toUnit(in[x].red);
+            float g = Traits::toUnit(in[x].green);
+            float b = Traits::toUnit(in[x].blue);
+            if (Traits::toUnit(in[x].alpha) != 1.0f) return false;
+            if (!(r >= 0.0f && r <= 1.0f && g >= 0.0f && g <= 1.0f && b >= 0.0f && b <= 1.0f)) return false;
+        }
+    }
+    return true;
+}
+
+inline void initTileMap(const RenderPlan& plan, TileMap& tiles) {
+    tiles.tilesX = (plan.width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    tiles.tilesY = (plan.height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    tiles.kinds.assign((size_t)tiles.tilesX * tiles.tilesY, TILE_BAND);
+    tiles.stages.assign((size_t)tiles.tilesX * tiles.tilesY, (unsigned char)plan.stages);
+}
+
+// Classify the tile rows [tyStart, tyEnd); df must hold their pixel rows
+template<typename PixelT>
+void classifyTiles(PF_InData* in_data, const RenderPlan& plan, const DistanceField& df, PF_EffectWorld* input,
+    TileMap& tiles, RenderProgress& progress, int tyStart, int tyEnd)
+{
+    bool solidAllowed = !(plan.stages & STAGE_GRUNGE);
+    
+    const double ds = plan.downsampleFactor;
+    
+    // One band per row of tiles
+    forEachBand(in_data, tyEnd - tyStart, [&](int band, int) {
+        if (!progress.alive()) return;
+        int ty = tyStart + band;
+        int y0 = ty * RENDER_TILE_SIZE;
+        int y1 = safeMin(plan.height, y0 + RENDER_TILE_SIZE);
+        int dfY0 = safeMax(0, safeMin(df.height - 1, y0));
+        int dfY1 = safeMax(0, safeMin(df.height - 1, y1 - 1));
+        
+        for (int tx = 0; tx < tiles.tilesX; tx++) {
+            // Cleared before the distance field was built, which holds nothing here
+            if (tiles.at(tx, ty) == TILE_EMPTY) continue;
+            
+            int x0 = tx * RENDER_TILE_SIZE;
+            int x1 = safeMin(plan.width, x0 + RENDER_TILE_SIZE);
+            int dfX0 = safeMax(0, safeMin(df.width - 1, x0));
+            int dfX1 = safeMax(0, safeMin(df.width - 1, x1 - 1));
+            
+            float distMin = 1e30f, distMax = -1e30f;
+            for (int y = dfY0; y <= dfY1; y++) {
+                for (int x = dfX0; x <= dfX1; x++) {
+                    float d = df.getDist(x, y);
+                    distMin = safeMin(distMin, d);
+                    distMax = safeMax(distMax, d);
+                }
+            }
+            
+            // Nodes that can reach some pixel of the tile
+            unsigned live = plan.graph.active;
+            if ((plan.stages & STAGE_FOLD) && !plan.folds->touches(x0 / ds, y0 / ds, (x1 - 1) / ds, (y1 - 1) / ds)) {
+                live &= ~nodeBit(NODE_FOLD);
+            }
+            if (distMin / ds > plan.contentAbove) {
+                live &= ~(nodeBit(NODE_FIBERS) | nodeBit(NODE_MIDDLE));
+            }
+            int stages = plan.graph.resolve(live);
+            
+            int kind = TILE_BAND;
+            if (distMax / ds < plan.emptyBelow) {
+                kind = TILE_EMPTY;
+            } else if (solidAllowed && !(stages & STAGE_FOLD) && distMin / ds > plan.solidAbove &&
+                       x1 <= input->width && y1 <= input->height &&
+                       opaqueBlock<PixelT>(input, x0, y0, x1, y1)) {
+                kind = TILE_SOLID;
+            }
+            tiles.kinds[ty * tiles.tilesX + tx] = (unsigned char)kind;
+            tiles.stages[ty * tiles.tilesX + tx] = (unsigned char)stages;
+        }
+    });
+}
+
+// ============================================================
+// VECTOR EDGES
+// ============================================================
+
+// Alternative to the distance field for very large stills. The alpha contour
+// is traced with marching squares, every contour vertex is pushed along its
+// normal to the outer and inner edge with the same displacement fields, and
+// the torn polygons are rasterised with exact-area coverage. Beyond one
+// pass over the alpha, the cost follows the perimeter and the pixels the
+// polygons touch. Middle edges and the ends of the paper shadows are traced
+// as polygons too. Fibers grow from distances, so this engine leaves them
+// out, and edges are antialiased by area rather than by Edge Softness;
+// UpdateParamsUI disables those params while it is selected.
+
+struct EdgeSegment {
+    float x0, y0, x1, y1;
+};
+
+// Signed-area coverage of a closed polygon given as directed segments, counting
+// positive winding only.
+// Segments are indexed by the rows they cross, so any row can be covered on
+// its own and rows can be shared between threads.
+class CoverageRaster {
+public:
+    CoverageRaster(int w, int h) : width(w), height(h) {
+        tilesX = (w + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+        tilesY = (h + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+        touched.assign((size_t)tilesX * tilesY, 0);
+    }
+    
+    // Parts left of the frame still cover it, so they are flattened onto x = 0;
+    // parts right of the frame are dropped
+    void addSegment(double x0, double y0, double x1, double y1) {
+        if (y0 == y1) return;
+        
+        double cuts[4] = {0.0, 1.0, 1.0, 1.0};
+        int n = 1;
+        if (x0 != x1) {
+            double t0 = (0.0 - x0) / (x1 - x0);
+            double tw = (width - x0) / (x1 - x0);
+            if (t0 > 0.0 && t0 < 1.0) cuts[n++] = t0;
+            if (tw > 0.0 && tw < 1.0) cuts[n++] = tw;
+            if (n == 3 && cuts[1] > cuts[2]) std::swap(cuts[1], cuts[2]);
+        }
+        cuts[n++] = 1.0;
+        
+        for (int i = 0; i + 1 < n; i++) {
+            double ta = cuts[i], tb = cuts[i + 1];
+            double ax = x0 + (x1 - x0) * ta, ay = y0 + (y1 - y0) * ta;
+            double bx = x0 + (x1 - x0) * tb, by = y0 + (y1 - y0) * tb;
+            double mid = (ax + bx) * 0.5;
+            if (mid >= width) continue;
+            ax = clamp(ax, 0.0, width);
+            bx = clamp(bx, 0.0, width);
+            push(ax, ay, bx, by);
+        }
+    }
+    
+    // Build the row index once every segment is in
+    void finish() {
+        rowStart.assign((size_t)height + 1, 0);
+        for (const EdgeSegment& s : segments) {
+            int r0, r1;
+            if (rowRange(s, r0, r1)) for (int r = r0; r <= r1; r++) rowStart[r + 1]++;
+        }
+        for (int r = 0; r < height; r++) rowStart[r + 1] += rowStart[r];
+        
+        rowSegments.resize(rowStart[height]);
+        std::vector<int> fill(rowStart.begin(), rowStart.end() - 1);
+        for (int i = 0; i < (int)segments.size(); i++) {
+            int r0, r1;
+            if (rowRange(segments[i], r0, r1)) for (int r = r0; r <= r1; r++) rowSegments[fill[r]++] = i;
+        }
+    }
+    
+    // Coverage of pixels [x0, x1) of row y, written to cover[x0, x1). Only
+    // acc[x0, x1) is used, and what segments add left of x0 seeds the sum.
+    // The changes are summed in fixed point, so a pixel gets the same
+    // coverage whichever pixel its rect starts at.
+    void coverRow(int y, int x0, int x1, int64_t* acc, float* cover) const {
+        std::fill(acc + x0, acc + x1, (int64_t)0);
+        int64_t left = 0;
+        for (int i = rowStart[y]; i < rowStart[y + 1]; i++) {
+            accumulate(segments[rowSegments[i]], y, x0, x1, acc, left);
+        }
+        int64_t sum = left;
+        for (int x = x0; x < x1; x++) {
+            sum += acc[x];
+            cover[x] = clamp01f((float)sum * (1.0f / kCoverOne));
+        }
+    }
+    
+    // No segment crosses an untouched tile, so its coverage is constant
+    bool touches(int tx, int ty) const { return touched[ty * tilesX + tx] != 0; }
+    
+private:
+    enum { kCoverOne = 1 << 24 };     // full coverage in fixed point
+    
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<EdgeSegment> segments;
+    std::vector<int> rowStart, rowSegments;
+    std::vector<unsigned char> touched;
+    
+    void push(double x0, double y0, double x1, double y1) {
+        EdgeSegment s = {(float)x0, (float)y0, (float)x1, (float)y1};
+        segments.push_back(s);
+        
+        int r0, r1;
+        if (!rowRange(s, r0, r1)) return;
+        int c0 = safeMin(tilesX - 1, (int)safeMin(x0, x1) / RENDER_TILE_SIZE);
+        int c1 = safeMin(tilesX - 1, (int)safeMax(x0, x1) / RENDER_TILE_SIZE);
+        for (int ty = r0 / RENDER_TILE_SIZE; ty <= r1 / RENDER_TILE_SIZE; ty++) {
+            for (int tx = c0; tx <= c1; tx++) touched[ty * tilesX + tx] = 1;
+        }
+    }
+    
+    bool rowRange(const EdgeSegment& s, int& r0, int& r1) const {
+        float top = safeMin(s.y0, s.y1), bottom = safeMax(s.y0, s.y1);
+        r0 = safeMax(0, (int)floor(top));
+        r1 = safeMin(height - 1, (int)ceil(bottom) - 1);
+        return r0 <= r1;
+    }
+    
+    static int64_t fixed(float v) { return (int64_t)std::lrint((double)v * kCoverOne); }
+    
+    // Adds the part of s inside row y: each pixel gets the change in covered
+    // area it causes, so a running sum along the row gives the coverage.
+    // Changes left of xBegin go to left and changes from xEnd on are dropped.
+    void accumulate(const EdgeSegment& s, int y, int xBegin, int xEnd, int64_t* acc, int64_t& left) const {
+        float x0 = s.x0, y0 = s.y0, x1 = s.x1, y1 = s.y1;
+        float dir = 1.0f;
+        if (y0 > y1) {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+            dir = -1.0f;
+        }
+        float top = safeMax(y0, (float)y);
+        float bottom = safeMin(y1, (float)(y + 1));
+        if (bottom <= top) return;
+        
+        float dxdy = (x1 - x0) / (y1 - y0);
+        float xa = x0 + (top - y0) * dxdy;
+        float xb = x0 + (bottom - y0) * dxdy;
+        float d = (bottom - top) * dir;
+        float lo = clamp01f(safeMin(xa, xb) / width) * width;
+        float hi = clamp01f(safeMax(xa, xb) / width) * width;
+        
+        float loFloor = floor(lo);
+        int loI = (int)loFloor;
+        if (loI >= xEnd) return;
+        float hiCeil = ceil(hi);
+        int hiI = (int)hiCeil;
+        
+        auto add = [&](int x, float v) {
+            if (x < xBegin) left += fixed(v);
+            else if (x < xEnd) acc[x] += fixed(v);
+        };
+        
+        if (hiI <= loI + 1) {
+            float mid = 0.5f * (lo + hi) - loFloor;
+            add(loI, d - d * mid);
+            add(loI + 1, d * mid);
+        } else {
+            float inv = 1.0f / (hi - lo);
+            float loF = lo - loFloor;
+            float a0 = 0.5f * inv * (1.0f - loF) * (1.0f - loF);
+            float hiF = hi - hiCeil + 1.0f;
+            float am = 0.5f * inv * hiF * hiF;
+            add(loI, d * a0);
+            if (hiI == loI + 2) {
+                add(loI + 1, d * (1.0f - a0 - am));
+            } else {
+                float a1 = inv * (1.5f - loF);
+                add(loI + 1, d * (a1 - a0));
+                // The run of equal changes between the ends
+                int64_t step = fixed(d * inv);
+                int runStart = loI + 2, runEnd = hiI - 1;
+                left += step * safeMax(0, safeMin(runEnd, xBegin) - runStart);
+                for (int x = safeMax(runStart, xBegin); x < safeMin(runEnd, xEnd); x++) acc[x] += step;
+                float a2 = a1 + (hiI - loI - 3) * inv;
+                add(hiI - 1, d * (1.0f - a2 - am));
+            }
+            add(hiI, d * am);
+        }
+    }
+};
+
+// Torn polygons of one frame. Middle edges only show through their shadows,
+// so they and the shadow polygons are traced when the plan casts the shadow.
+struct TearPolygons {
+    explicit TearPolygons(const RenderPlan& plan)
+        : rasters(TEAR_POLYGON_COUNT, CoverageRaster(plan.width, plan.height)), used(0)
+    {
+        bool middle1 = plan.middle1Amount > 0 && plan.middle1Shadow > 0;
+        bool middle2 = plan.middle2Amount > 0 && plan.middle2Shadow > 0;
+        used = (1u << TEAR_OUTER) | (1u << TEAR_INNER);
+        if (middle1) used |= (1u << TEAR_MIDDLE1) | (1u << TEAR_MIDDLE1_SHADOW);
+        if (middle2) used |= (1u << TEAR_MIDDLE2) | (1u << TEAR_MIDDLE2_SHADOW);
+        if (plan.shadowAmount > 0) used |= 1u << TEAR_OUTER_SHADOW;
+        if (plan.contentShadowAmount > 0) used |= 1u << TEAR_CONTENT_SHADOW;
+    }
+    
+    bool has(int polygon) const { return (used & (1u << polygon)) != 0; }
+    
+    const CoverageRaster& operator[](int polygon) const { return rasters[polygon]; }
+    CoverageRaster& operator[](int polygon) { return rasters[polygon]; }
+    
+private:
+    std::vector<CoverageRaster> rasters;
+    unsigned used;
+};
+
+// Traces the alpha contour and emits the displaced polygons. Each contour
+// vertex gets the edge offsets the distance field kernel would find there.
+// Alpha outside the input repeats its border like the distance field's lookups,
+// and a margin beyond the frame is left transparent so every contour closes
+// somewhere no displaced edge can reach the frame.
+//
+// Pushing a contour inwards past a convex corner, or outwards past a concave
+// one, folds the offset into a loop. An offset vertex that lies closer to the
+// contour than its own offset is inside such a loop, so it is dropped and its
+// neighbours are joined directly.
+template<typename PixelT>
+class TearTracer {
+public:
+    TearTracer(const RenderPlan& p, PF_EffectWorld* in, TearPolygons& out)
+        : plan(p), input(in), polygons(out)
+    {
+        double ds = plan.downsampleFactor;
+        double lo = safeMin(-plan.halfGap + plan.outerDispMin, plan.halfGap + plan.innerDispMin - plan.innerDispShift);
+        double hi = safeMax(-plan.halfGap + plan.outerDispMax, plan.halfGap + plan.innerDispMax - plan.innerDispShift);
+        // Shadow polygons lie a shadow width past the edges
+        lo -= safeMax(plan.contentShadowWidth, plan.shadowWidth * 0.4);
+        hi += plan.shadowWidth;
+        int margin = (int)ceil((safeMax(fabs(lo), fabs(hi)) + 1.0) * ds) + 2;
+        left = -margin;
+        top = -margin;
+        right = plan.width + margin;
+        bottom = plan.height + margin;
+    }
+    
+    // Stops part way once the render is cancelled, leaving the polygons unusable
+    void trace(RenderProgress& progress) {
+        findContours(progress);
+        if (!progress.alive()) return;
+        indexContours();
+        
+        std::vector<unsigned char> visited(vertices.size(), 0);
+        std::vector<int> loop;
+        for (int start = 0; start < (int)vertices.size(); start++) {
+            if (visited[start]) continue;
+            loop.clear();
+            for (int v = start; v >= 0 && !visited[v]; v = vertices[v].next) {
+                visited[v] = 1;
+                loop.push_back(v);
+            }
+            for (int p = 0; p < TEAR_POLYGON_COUNT; p++) {
+                if (polygons.has(p) && !emitLoop(loop, p, polygons[p], progress)) return;
+            }
+        }
+        
+        for (int p = 0; p < TEAR_POLYGON_COUNT; p++) {
+            if (polygons.has(p)) polygons[p].finish();
+        }
+    }
+    
+private:
+    struct Vertex {
+        double x, y;                    // canvas position
+        double nx, ny;                  // unit normal pointing into the content
+        double edge[TEAR_POLYGON_COUNT];    // signed offsets in canvas pixels
+        int next;                       // following vertex with the content on the left
+    };
+    
+    enum { kCellSize = 16, kPollRows = 16, kPollVertices = 256 };
+    
+    const RenderPlan& plan;
+    PF_EffectWorld* input;
+    TearPolygons& polygons;
+    int left, top, right, bottom;   // alpha is sampled over [left, right) x [top, bottom)
+    
+    std::vector<Vertex> vertices;
+    std::unordered_map<uint64_t, int> vertexIndex;
+    
+    // Contour segments by grid cell, for distance queries
+    int cellsX, cellsY;
+    std::vector<int> cellHead;
+    std::vector<int> entrySegment, entryNext;
+    
+    double alphaAt(int x, int y) const {
+        if (x < left || x >= right || y < top || y >= bottom) return 0.0;
+        x = safeMax(0, safeMin((int)input->width - 1, x));
+        y = safeMax(0, safeMin((int)input->height - 1, y));
+        return PixelTraits<PixelT>::toUnit(worldRow<PixelT>(input, y)[x].alpha);
+    }
+    
+    // Inside flags of lattice row y for x in [left - 1, right]
+    void insideRow(int y, unsigned char* inside) const {
+        for (int x = left - 1; x <= right; x++) inside[x - left + 1] = alphaAt(x, y) > 0.5 ? 1 : 0;
+    }
+    
+    void findContours(RenderProgress& progress) {
+        int cells = right - left + 1;
+        std::vector<unsigned char> above(cells + 1), below(cells + 1);
+        insideRow(top - 1, above.data());
+        
+        for (int cy = top - 1; cy < bottom; cy++) {
+            if ((cy - top + 1) % kPollRows == 0 && !progress.alive()) return;
+            insideRow(cy + 1, below.data());
+            for (int i = 0; i < cells; i++) {
+                int c = above[i] | (above[i + 1] << 1) | (below[i + 1] << 2) | (below[i] << 3);
+                if (c != 0 && c != 15) traceCell(left - 1 + i, cy, c);
+            }
+            above.swap(below);
+        }
+    }
+    
+    // The contour vertex on the lattice edge from (ax, ay) to its right or lower
+    // neighbour, created the first time either cell sharing the edge asks for it
+    int vertexOn(int ax, int ay, bool horizontal) {
+        uint64_t key = ((uint64_t)(uint32_t)(ay - top + 1) << 33) | ((uint64_t)(uint32_t)(ax - left + 1) << 1) |
+            (horizontal ? 1u : 0u);
+        std::unordered_map<uint64_t, int>::iterator found = vertexIndex.find(key);
+        if (found != vertexIndex.end()) return found->second;
+        
+        int bx = ax + (horizontal ? 1 : 0);
+        int by = ay + (horizontal ? 0 : 1);
+        double a = alphaAt(ax, ay);
+        double b = alphaAt(bx, by);
+        double t = (0.5 - a) / (b - a);
+        
+        Vertex v;
+        v.x = ax + (bx - ax) * t + 0.5;
+        v.y = ay + (by - ay) * t + 0.5;
+        v.next = -1;
+        
+        double gax = alphaAt(ax + 1, ay) - alphaAt(ax - 1, ay);
+        double gay = alphaAt(ax, ay + 1) - alphaAt(ax, ay - 1);
+        double gbx = alphaAt(bx + 1, by) - alphaAt(bx - 1, by);
+        double gby = alphaAt(bx, by + 1) - alphaAt(bx, by - 1);
+        double gx = gax + (gbx - gax) * t;
+        double gy = gay + (gby - gay) * t;
+        double len = sqrt(gx * gx + gy * gy);
+        if (len > 1e-6) {
+            v.nx = gx / len;
+            v.ny = gy / len;
+        } else {
+            double toward = b > a ? 1.0 : -1.0;
+            v.nx = (bx - ax) * toward;
+            v.ny = (by - ay) * toward;
+        }
+        
+        // Edge offsets from the same displacement fields, push-apart rule and
+        // middle edge placement as the distance field kernel
+        int px = safeMax(0, safeMin(plan.width - 1, (int)floor(v.x)));
+        int py = safeMax(0, safeMin(plan.height - 1, (int)floor(v.y)));
+        double outerEdge = -plan.halfGap + plan.outerDispField->at(px, py);
+        double innerEdge = plan.halfGap + plan.innerDispField->at(px, py) - plan.innerDispShift;
+        if (innerEdge < outerEdge + 2.0) {
+            double mid = (innerEdge + outerEdge) / 2.0;
+            innerEdge = mid + 1.0;
+            outerEdge = mid - 1.0;
+        }
+        double middle1Edge = outerEdge, middle2Edge = outerEdge;
+        if (polygons.has(TEAR_MIDDLE1)) {
+            middle1Edge = outerEdge + (innerEdge - outerEdge) * plan.middle1Position +
+                plan.middle1DispField->at(px, py) * 0.4;
+            middle1Edge = clamp(middle1Edge, outerEdge + 1.0, innerEdge - 1.0);
+        }
+        if (polygons.has(TEAR_MIDDLE2)) {
+            middle2Edge = outerEdge + (innerEdge - outerEdge) * plan.middle2Position +
+                plan.middle2DispField->at(px, py) * 0.4;
+            middle2Edge = clamp(middle2Edge, outerEdge + 1.0, innerEdge - 1.0);
+        }
+        
+        v.edge[TEAR_OUTER] = outerEdge;
+        v.edge[TEAR_INNER] = innerEdge;
+        v.edge[TEAR_MIDDLE1] = middle1Edge;
+        v.edge[TEAR_MIDDLE2] = middle2Edge;
+        v.edge[TEAR_OUTER_SHADOW] = outerEdge + plan.shadowWidth;
+        v.edge[TEAR_CONTENT_SHADOW] = innerEdge - plan.contentShadowWidth;
+        v.edge[TEAR_MIDDLE1_SHADOW] = middle1Edge - plan.shadowWidth * 0.4;
+        v.edge[TEAR_MIDDLE2_SHADOW] = middle2Edge - plan.shadowWidth * 0.4;
+        for (int p = 0; p < TEAR_POLYGON_COUNT; p++) v.edge[p] *= plan.downsampleFactor;
+        
+        vertices.push_back(v);
+        vertexIndex[key] = (int)vertices.size() - 1;
+        return (int)vertices.size() - 1;
+    }
+    
+    // Edge e of cell (cx, cy): 0 top, 1 right, 2 bottom, 3 left
+    int cellVertex(int cx, int cy, int e) {
+        switch (e) {
+            case 0:  return vertexOn(cx, cy, true);
+            case 1:  return vertexOn(cx + 1, cy, false);
+            case 2:  return vertexOn(cx, cy + 1, true);
+            default: return vertexOn(cx, cy, false);
+        }
+    }
+    
+    // Links edge ea to edge eb, directed so the content winds positively and
+    // the loops of a folded offset wind negatively
+    void link(int cx, int cy, int ea, int eb, int refCorner, bool refInside) {
+        static const int cornerX[4] = {0, 1, 1, 0};
+        static const int cornerY[4] = {0, 0, 1, 1};
+        
+        int p = cellVertex(cx, cy, ea);
+        int q = cellVertex(cx, cy, eb);
+        double rx = cx + cornerX[refCorner] + 0.5;
+        double ry = cy + cornerY[refCorner] + 0.5;
+        const Vertex& vp = vertices[p];
+        const Vertex& vq = vertices[q];
+        double cross = (vq.x - vp.x) * (ry - vp.y) - (vq.y - vp.y) * (rx - vp.x);
+        if ((cross > 0) == refInside) std::swap(p, q);
+        vertices[p].next = q;
+    }
+    
+    // Marching squares; corners are 1 top left, 2 top right, 4 bottom right,
+    // 8 bottom left. Saddles follow the average of the four corners.
+    void traceCell(int cx, int cy, int c) {
+        // Corner between two adjacent edges, or corner 0 for opposite edges
+        static const int sharedCorner[4][4] = {
+            {0, 1, 0, 0}, {1, 0, 2, 0}, {0, 2, 0, 3}, {0, 0, 3, 0}
+        };
+        
+        int pairs[2][2];
+        int n = 0;
+        switch (c) {
+            case 1:  case 14: pairs[n][0] = 3; pairs[n][1] = 0; n++; break;
+            case 2:  case 13: pairs[n][0] = 0; pairs[n][1] = 1; n++; break;
+            case 3:  case 12: pairs[n][0] = 3; pairs[n][1] = 1; n++; break;
+            case 4:  case 11: pairs[n][0] = 1; pairs[n][1] = 2; n++; break;
+            case 6:  case 9:  pairs[n][0] = 0; pairs[n][1] = 2; n++; break;
+            case 7:  case 8:  pairs[n][0] = 3; pairs[n][1] = 2; n++; break;
+            case 5: case 10: {
+                double centre = 0.25 * (alphaAt(cx, cy) + alphaAt(cx + 1, cy) +
+                    alphaAt(cx + 1, cy + 1) + alphaAt(cx, cy + 1));
+                if ((c == 5) == (centre > 0.5)) {
+                    // Corners 1 and 3 are cut off
+                    pairs[n][0] = 0; pairs[n][1] = 1; n++;
+                    pairs[n][0] = 2; pairs[n][1] = 3; n++;
+                } else {
+                    // Corners 0 and 2 are cut off
+                    pairs[n][0] = 3; pairs[n][1] = 0; n++;
+                    pairs[n][0] = 1; pairs[n][1] = 2; n++;
+                }
+                break;
+            }
+            default: break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            int corner = sharedCorner[pairs[i][0]][pairs[i][1]];
+            link(cx, cy, pairs[i][0], pairs[i][1], corner, ((c >> corner) & 1) != 0);
+        }
+    }
+    
+    // Buckets each contour segment, named by its first vertex, into the cells it spans
+    void indexContours() {
+        cellsX = (right - left) / kCellSize + 2;
+        cellsY = (bottom - top) / kCellSize + 2;
+        cellHead.assign((size_t)cellsX * cellsY, -1);
+        entrySegment.clear();
+        entryNext.clear();
+        
+        for (int s = 0; s < (int)vertices.size(); s++) {
+            if (vertices[s].next < 0) continue;
+            const Vertex& a = vertices[s];
+            const Vertex& b = vertices[a.next];
+            int c0 = cellX(safeMin(a.x, b.x)), c1 = cellX(safeMax(a.x, b.x));
+            int r0 = cellY(safeMin(a.y, b.y)), r1 = cellY(safeMax(a.y, b.y));
+            for (int r = r0; r <= r1; r++) {
+                for (int c = c0; c <= c1; c++) {
+                    entrySegment.push_back(s);
+                    entryNext.push_back(cellHead[r * cellsX + c]);
+                    cellHead[r * cellsX + c] = (int)entrySegment.size() - 1;
+                }
+            }
+        }
+    }
+    
+    int cellX(double x) const { return safeMax(0, safeMin(cellsX - 1, (int)floor((x - left) / kCellSize))); }
+    int cellY(double y) const { return safeMax(0, safeMin(cellsY - 1, (int)floor((y - top) / kCellSize))); }
+    
+    // True when some contour segment passes within radius of (x, y)
+    bool contourWithin(double x, double y, double radius) const {
+        double r2 = radius * radius;
+        int c0 = cellX(x - radius), c1 = cellX(x + radius);
+        int r0 = cellY(y - radius), r1 = cellY(y + radius);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                for (int e = cellHead[r * cellsX + c]; e >= 0; e = entryNext[e]) {
+                    const Vertex& a = vertices[entrySegment[e]];
+                    const Vertex& b = vertices[a.next];
+                    double dx = b.x - a.x, dy = b.y - a.y;
+                    double len2 = dx * dx + dy * dy;
+                    double t = len2 > 0.0 ? clamp(((x - a.x) * dx + (y - a.y) * dy) / len2, 0.0, 1.0) : 0.0;
+                    double ex = a.x + dx * t - x, ey = a.y + dy * t - y;
+                    if (ex * ex + ey * ey < r2) return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    // Offsets one contour loop to the edge of one polygon, leaving out the
+    // vertices that fold back over the contour
+    // False when cancelled part way
+    bool emitLoop(const std::vector<int>& loop, int polygon, CoverageRaster& raster, RenderProgress& progress) const {
+        std::vector<double> px, py;
+        px.reserve(loop.size());
+        py.reserve(loop.size());
+        
+        for (size_t k = 0; k < loop.size(); k++) {
+            if (k % kPollVertices == 0 && !progress.alive()) return false;
+            const Vertex& v = vertices[loop[k]];
+            double e = v.edge[polygon];
+            double x = v.x + v.nx * e;
+            double y = v.y + v.ny * e;
+            // Slack for normals taken from the alpha gradient
+            double radius = fabs(e) - (0.5 + 0.05 * fabs(e));
+            if (radius > 0.0 && contourWithin(x, y, radius)) continue;
+            px.push_back(x);
+            py.push_back(y);
+        }
+        
+        int n = (int)px.size();
+        if (n < 3) return true;
+        for (int i = 0; i < n; i++) {
+            int j = (i + 1) % n;
+            raster.addSegment(px[i], py[i], px[j], py[j]);
+        }
+        return true;
+    }
+};
+
+// Classify every tile from the polygon coverage, a row of tiles per band
+template<typename PixelT>
+void classifyVectorTiles(PF_InData* in_data, const RenderPlan& plan, const TearPolygons& polygons,
+    PF_EffectWorld* input, TileMap& tiles, RenderProgress& progress)
+{
+    initTileMap(plan, tiles);
+    
+    bool solidAllowed = !(plan.stages & STAGE_GRUNGE);
+    const double ds = plan.downsampleFactor;
+    
+    forEachBand(in_data, tiles.tilesY, [&](int ty, int) {
+        if (!progress.alive()) return;
+        int y0 = ty * RENDER_TILE_SIZE;
+        int y1 = safeMin(plan.height, y0 + RENDER_TILE_SIZE);
+        std::vector<int64_t> acc(plan.width);
+        std::vector<float> outerCover(plan.width), innerCover(plan.width);
+        polygons[TEAR_OUTER].coverRow(y0, 0, plan.width, acc.data(), outerCover.data());
+        polygons[TEAR_INNER].coverRow(y0, 0, plan.width, acc.data(), innerCover.data());
+        
+        for (int tx = 0; tx < tiles.tilesX; tx++) {
+            int x0 = tx * RENDER_TILE_SIZE;
+            int x1 = safeMin(plan.width, x0 + RENDER_TILE_SIZE);
+            
+            unsigned live = plan.graph.active;
+            if ((plan.stages & STAGE_FOLD) && !plan.folds->touches(x0 / ds, y0 / ds, (x1 - 1) / ds, (y1 - 1) / ds)) {
+                live &= ~nodeBit(NODE_FOLD);
+            }
+            int stages = plan.graph.resolve(live);
+            
+            int kind = TILE_BAND;
+            if (!polygons[TEAR_OUTER].touches(tx, ty) && !polygons[TEAR_INNER].touches(tx, ty)) {
+                if (outerCover[x0] == 0.0f && innerCover[x0] == 0.0f) {
+                    kind = TILE_EMPTY;
+                } else if (solidAllowed && !(stages & STAGE_FOLD) && innerCover[x0] == 1.0f &&
+                           x1 <= input->width && y1 <= input->height &&
+                           opaqueBlock<PixelT>(input, x0, y0, x1, y1)) {
+                    kind = TILE_SOLID;
+                }
+            }
+            tiles.kinds[ty * tiles.tilesX + tx] = (unsigned char)kind;
+            tiles.stages[ty * tiles.tilesX + tx] = (unsigned char)stages;
+        }
+    });
+}
+
+// Share of a shadow's peak strength it keeps on average across its width,
+// the mean of the (1 - d / width)^2 falloff
+#define VECTOR_SHADOW_MEAN  (1.0 / 3.0)
+
+// Coverage of the band between two polygons, the first holding the second
+inline float bandCover(const ShadeRow& row, int outside, int inside, int x) {
+    return clamp01f(row.tearCover[outside][x] - row.tearCover[inside][x]);
+}
+
+// Geometry planes for [x0, x1) of one row from the polygon coverage. Polygons
+// carry no distance to fade a shadow by, so each shadow darkens the band
+// between its edge and where it ends evenly, at the falloff's mean strength.
+template<bool Texture>
+inline void shadeVectorGeometry(const RenderPlan& plan, int y, int x0, int x1, ShadeRow& row) {
+    const bool middle1 = plan.middle1Amount > 0 && plan.middle1Shadow > 0;
+    const bool middle2 = plan.middle2Amount > 0 && plan.middle2Shadow > 0;
+    const double middle1Shadow = plan.middle1Shadow * plan.middle1Amount * 0.35 * VECTOR_SHADOW_MEAN;
+    const double middle2Shadow = plan.middle2Shadow * plan.middle2Amount * 0.35 * VECTOR_SHADOW_MEAN;
+    const double outerShadow = plan.shadowAmount * 0.4 * VECTOR_SHADOW_MEAN;
+    const double contentShadow = plan.contentShadowAmount * 0.5 * VECTOR_SHADOW_MEAN;
+    
+    for (int x = x0; x < x1; x++) {
+        if (Texture) {
+            row.tex[x] = (float)((plan.grainField->at(x, y) - 0.5) * plan.paperTexture * 0.15);
+        }
+        float paperAlpha = safeMax(0.0f, row.tearCover[TEAR_OUTER][x] - row.tearCover[TEAR_INNER][x]);
+        row.contentAlpha[x] = row.tearCover[TEAR_INNER][x];
+        row.paperAlpha[x] = paperAlpha;
+        row.fiberAlpha[x] = 0.0f;
+        row.fiberShadowAlpha[x] = 0.0f;
+        row.fiberColorVar[x] = 0.5f;
+        
+        double shadeRG = 1.0, shadeB = 1.0;
+        if (plan.paperShadows && paperAlpha > 0.01f) {
+            double shadows[4] = {0, 0, 0, 0};
+            if (middle1) shadows[0] = bandCover(row, TEAR_MIDDLE1_SHADOW, TEAR_MIDDLE1, x) * middle1Shadow;
+            if (middle2) shadows[1] = bandCover(row, TEAR_MIDDLE2_SHADOW, TEAR_MIDDLE2, x) * middle2Shadow;
+            if (plan.shadowAmount > 0) shadows[2] = bandCover(row, TEAR_OUTER, TEAR_OUTER_SHADOW, x) * outerShadow;
+            if (plan.contentShadowAmount > 0) {
+                shadows[3] = bandCover(row, TEAR_CONTENT_SHADOW, TEAR_INNER, x) * contentShadow;
+            }
+            for (int i = 0; i < 4; i++) {
+                shadeRG *= (1.0 - shadows[i]);
+                shadeB *= (1.0 - shadows[i] * 0.8);
+            }
+        }
+        row.shadeRG[x] = (float)shadeRG;
+        row.shadeB[x] = (float)shadeB;
+    }
+}
+
+// Shade [x0, x1) of one row through every active stage; outRow is the output
+// pixel for x0
+template<typename PixelT, bool Fold, bool Grunge, bool Fibers, bool Middle, bool Texture>
+inline void shadeSpan(const RenderPlan& plan, const DistanceField& df,
+    PF_EffectWorld* input, int y, int x0, int x1, ShadeRow& row, FixedRow& fixed, PixelT* outRow)
+{
+    const int n = x1 - x0;
+    
+    if (plan.vectorEdges) {
+        shadeVectorGeometry<Texture>(plan, y, x0, x1, row);
+    } else {
+        shadeGeometry<Fibers, Middle, Texture>(plan, df, input->width, input->height, y, x0, x1, row);
+    }
+    shadePaperSpan<Fibers, Texture>(plan, row, x0, x1);
+    
+    if (std::is_same<PixelT, PF_Pixel8>::value) {
+        compositeRow8<Fold, Grunge>(plan, input, y, x0, x1, row, fixed, (PF_Pixel8*)outRow);
+        return;
+    }
+    
+    loadRow<PixelT>(input, y, x0, x1, row);
+    
+    // Content over the paper backing
+    for (int x = x0; x < x1; x++) {
+        float srcA = row.srcA[x] > 0.99f ? 1.0f : row.srcA[x];
+        row.r[x] = row.srcR[x] * srcA + row.backingR[x] * (1.0f - srcA);
+        row.g[x] = row.srcG[x] * srcA + row.backingG[x] * (1.0f - srcA);
+        row.b[x] = row.srcB[x] * srcA + row.backingB[x] * (1.0f - srcA);
+    }
+    
+    // Apply fold marks - use noise coordinates
+    if (Fold) {
+        double noisePy = (double)y / plan.downsampleFactor;
+        for (int x = x0; x < x1; x++) {
+            if (row.contentAlpha[x] <= 0.01f) continue;
+            double finalR = row.r[x], finalG = row.g[x], finalB = row.b[x];
+            applyFolds(*plan.folds, (double)x / plan.downsampleFactor, noisePy,
+                row.backingR[x], row.backingG[x], row.backingB[x],
+                plan.foldShadowAColor, plan.foldShadowBColor, finalR, finalG, finalB);
+            row.r[x] = (float)finalR;
+            row.g[x] = (float)finalG;
+            row.b[x] = (float)finalB;
+        }
+    }
+    
+    // Apply grunge
+    if (Grunge) {
+        if (plan.dirtPlane) {
+            for (int x = x0; x < x1; x++) row.coverage[x] = plan.dirtPlane->at(x, y);
+            blendColorSpan(row.r + x0, row.g + x0, row.b + x0, row.coverage + x0, n, (float)plan.dirtOpacity,
+                (float)plan.dirtR, (float)plan.dirtG, (float)plan.dirtB);
+        }
+        
+        if (plan.smudgePlane) {
+            for (int x = x0; x < x1; x++) row.coverage[x] = plan.smudgePlane->at(x, y);
+            blendColorSpan(row.r + x0, row.g + x0, row.b + x0, row.coverage + x0, n, (float)plan.smudgeOpacity,
+                (float)plan.smudgeR, (float)plan.smudgeG, (float)plan.smudgeB);
+        }
+        
+        if (plan.dust) {
+            for (int x = x0; x < x1; x++) row.coverage[x] = plan.dust->at(x, y);
+            blendColorSpan(row.r + x0, row.g + x0, row.b + x0, row.coverage + x0, n, 1.0f,
+                (float)plan.dustR, (float)plan.dustG, (float)plan.dustB);
+        }
+    }
+    
+    // Content fades into the paper across the inner edge
+    for (int x = x0; x < x1; x++) {
+        float c = row.contentAlpha[x];
+        float w = c <= 0.01f ? 0.0f : (c < 0.99f ? c : 1.0f);
+        row.r[x] = clamp01f(row.r[x] * w + row.paperR[x] * (1.0f - w));
+        row.g[x] = clamp01f(row.g[x] * w + row.paperG[x] * (1.0f - w));
+        row.b[x] = clamp01f(row.b[x] * w + row.paperB[x] * (1.0f - w));
+        row.a[x] = clamp01f(w + row.paperAlpha[x] * (1.0f - w));
+    }
+    
+    storeRow<PixelT>(row, x0, x1, outRow);
+}
+
+template<typename PixelT>
+using SpanKernelFn = void (*)(const RenderPlan&, const DistanceField&, PF_EffectWorld*,
+    int, int, int, ShadeRow&, FixedRow&, PixelT*);
+
+template<typename PixelT, int Stages>
+void spanKernelForStages(const RenderPlan& plan, const DistanceField& df, PF_EffectWorld* input,
+    int y, int x0, int x1, ShadeRow& row, FixedRow& fixed, PixelT* outRow)
+{
+    shadeSpan<PixelT, (Stages & STAGE_FOLD) != 0, (Stages & STAGE_GRUNGE) != 0, (Stages & STAGE_FIBERS) != 0,
+              (Stages & STAGE_MIDDLE) != 0, (Stages & STAGE_TEXTURE) != 0>(plan, df, input, y, x0, x1, row, fixed, outRow);
+}
+
+template<typename PixelT, size_t... Stages>
+std::array<SpanKernelFn<PixelT>, sizeof...(Stages)> makeSpanKernels(std::index_sequence<Stages...>) {
+    return {{ &spanKernelForStages<PixelT, (int)Stages>... }};
+}
+
+// Span shader specialised for the pixel type and a set of active stages.
+// Stages switched off are compiled out of the loops entirely.
+template<typename PixelT>
+inline SpanKernelFn<PixelT> selectSpanKernel(int stages) {
+    static const std::array<SpanKernelFn<PixelT>, STAGE_COUNT> kernels =
+        makeSpanKernels<PixelT>(std::make_index_sequence<STAGE_COUNT>());
+    return kernels[stages];
+}
+
+// Scratch rows for one thread of the shading pass
+struct RowScratch {
+    RowScratch(FrameArena& arena, int width, bool fixed8, bool vectorEdges)
+        : row(arena, width), fixed(arena, fixed8 ? width : 0),
+          acc(arena.allocArray<int64_t>(vectorEdges ? width : 0)) {}
+    
+    ShadeRow row;
+    FixedRow fixed;
+    int64_t* acc;   // coverage accumulator for vector edges
+};
+
+// RowScratch per render thread, made the first time a thread asks. Thread
+// indices past the table get fresh rows per call.
+class ScratchTable {
+public:
+    ScratchTable(FrameArena& arena, int width, bool fixed8, bool vectorEdges)
+        : arena(arena), width(width), fixed8(fixed8), vectorEdges(vectorEdges)
+    {
+        for (int i = 0; i < kSlots; i++) slots[i] = nullptr;
+    }
+    
+    RowScratch& forThread(int thread) {
+        if (thread < 0 || thread >= kSlots) return *arena.create<RowScratch>(arena, width, fixed8, vectorEdges);
+        if (!slots[thread]) slots[thread] = arena.create<RowScratch>(arena, width, fixed8, vectorEdges);
+        return *slots[thread];
+    }
+    
+private:
+    enum { kSlots = 64 };
+    FrameArena& arena;
+    int width;
+    bool fixed8, vectorEdges;
+    RowScratch* slots[kSlots];
+};
+
+// The part of the frame an output world holds: world pixel (0, 0) is frame
+// pixel (x0, y0). Frame pixels are layer pixels and every stage reads them by
+// their frame position alone, so a pixel comes out the same whichever window,
+// tile, band or thread shades it.
+struct OutputWindow {
+    PF_EffectWorld* world;
+    int x0, y0;
+    
+    int x1() const { return x0 + world->width; }
+    int y1() const { return y0 + world->height; }
+};
+
+// Whether a band tile of tile row ty crosses pixels [x0, x1)
+inline bool bandTileIn(const TileMap& tiles, int ty, int x0, int x1) {
+    for (int tx = x0 / RENDER_TILE_SIZE; tx * RENDER_TILE_SIZE < x1; tx++) {
+        if (tiles.at(tx, ty) == TILE_BAND) return true;
+    }
+    return false;
+}
+
+// Shade frame pixels [xStart, xEnd) x [yStart, yEnd), which must lie in the
+// output window. Empty and solid tiles are filled or copied without shading;
+// band tiles run the shader for their own stages. polygons is null unless the
+// plan uses vector edges. Each row is counted as it finishes, and a cancel
+// stops the rect before its next row.
+template<typename PixelT>
+void renderRect(const RenderPlan& plan, const DistanceField& df, const TearPolygons* polygons,
+    const TileMap& tiles, PF_EffectWorld* input, const OutputWindow& output,
+    int xStart, int xEnd, int yStart, int yEnd, RowScratch& scratch, RenderProgress& progress)
+{
+    ShadeRow& row = scratch.row;
+    
+    for (int y = yStart; y < yEnd; y++) {
+        if (!progress.alive()) return;
+        PixelT* outRow = worldRow<PixelT>(output.world, y - output.y0);
+        int ty = y / RENDER_TILE_SIZE;
+        
+        // Only band tiles read the polygon coverage
+        if (polygons && bandTileIn(tiles, ty, xStart, xEnd)) {
+            for (int p = 0; p < TEAR_POLYGON_COUNT; p++) {
+                if (polygons->has(p)) (*polygons)[p].coverRow(y, xStart, xEnd, scratch.acc, row.tearCover[p]);
+            }
+        }
+        
+        int x0 = xStart;
+        while (x0 < xEnd) {
+            int tx = x0 / RENDER_TILE_SIZE;
+            int kind = tiles.at(tx, ty);
+            int x1 = safeMin(xEnd, (tx + 1) * RENDER_TILE_SIZE);
+            PixelT* out = outRow + (x0 - output.x0);
+            
+            if (kind == TILE_EMPTY) {
+                memset(out, 0, (x1 - x0) * sizeof(PixelT));
+            } else if (kind == TILE_SOLID) {
+                memcpy(out, worldRow<PixelT>(input, y) + x0, (x1 - x0) * sizeof(PixelT));
+            } else {
+                // Neighbouring band tiles with the same stages shade as one span
+                int stages = tiles.stagesAt(tx, ty);
+                while (x1 < xEnd && tiles.at(x1 / RENDER_TILE_SIZE, ty) == TILE_BAND &&
+                       tiles.stagesAt(x1 / RENDER_TILE_SIZE, ty) == stages) {
+                    x1 = safeMin(xEnd, x1 + RENDER_TILE_SIZE);
+                }
+                selectSpanKernel<PixelT>(stages)(plan, df, input, y, x0, x1, row, scratch.fixed, out);
+            }
+            x0 = x1;
+        }
+        progress.advance(xEnd - xStart);
+    }
+}
+
+// Shade frame rows [yStart, yEnd) where they cross the output window. AE's
+// iterate_generic gets row bands as wide as the window. The plugin's own pool
+// gets square tasks of the tuned number of tiles in Morton order instead, so
+// threads stealing work take compact groups of tiles and the torn edge is
+// shared out. Once the render is cancelled every band and task stops before
+// its next row.
+template<typename PixelT>
+PF_Err shadeRows(PF_InData* in_data, const RenderPlan& plan, const DistanceField& df,
+    const TearPolygons* polygons, const TileMap& tiles, PF_EffectWorld* input, const OutputWindow& output,
+    ScratchTable& scratch, RenderProgress& progress, int yStart, int yEnd)
+{
+    const int xStart = safeMax(0, output.x0);
+    const int xEnd = safeMin(plan.width, output.x1());
+    yStart = safeMax(yStart, output.y0);
+    yEnd = safeMin(yEnd, output.y1());
+    if (xStart >= xEnd || yStart >= yEnd) return PF_Err_NONE;
+    
+    if (genericBands(in_data)) {
+        return forEachRowBand(in_data, yStart, yEnd, [&](int y0, int y1, int thread) {
+            renderRect<PixelT>(plan, df, polygons, tiles, input, output, xStart, xEnd, y0, y1,
+                scratch.forThread(thread), progress);
+        });
+    }
+    
+    int span = RenderTuner::instance().poolTileSpan();
+    int taskSize = span * RENDER_TILE_SIZE;
+    int tasksX = (xEnd - xStart + taskSize - 1) / taskSize;
+    std::vector<int> order = mortonOrder(tasksX, (yEnd - yStart + taskSize - 1) / taskSize);
+    
+    TilePool::instance().run((int)order.size(), [&](int task, int thread) {
+        int x0 = xStart + (order[task] % tasksX) * taskSize;
+        int y0 = yStart + (order[task] / tasksX) * taskSize;
+        int x1 = safeMin(xEnd, x0 + taskSize);
+        int y1 = safeMin(yEnd, y0 + taskSize);
+        renderRect<PixelT>(plan, df, polygons, tiles, input, output, x0, x1, y0, y1, scratch.forThread(thread), progress);
+    });
+    return PF_Err_NONE;
+}
+
+// ============================================================
+// STRIP PIPELINE
+// ============================================================
+
+// Layers with at least this many pixels render as horizontal strips instead
+// of building one distance field for the whole frame. The tests lower it to
+// run small frames through the strip pipeline.
+#ifndef STRIP_MIN_PIXELS
+#define STRIP_MIN_PIXELS    (3840 * 2160)
+#endif
+
+enum {
+    STRIP_ROWS = 4 * RENDER_TILE_SIZE,
+    STRIP_WINDOWS = 4           // most distance windows in flight
+};
+
+// Distance windows in flight are cut back to fit this, down to two so the
+// sweeps still overlap the shading
+#define STRIP_WINDOW_BYTES  ((size_t)256 * 1024 * 1024)
+
+// Distance field pixels a window needs around those it serves. Past the edge
+// band a distance only has to keep its sign and stay outside the band, which
+// a window guarantees; the two extra pixels cover the gradient stencil.
+inline int windowHalo(const RenderPlan& plan) {
+    double band = safeMax(fabs(plan.emptyBelow), fabs(plan.contentAbove)) * plan.downsampleFactor;
+    return (int)ceil(band) + 2;
+}
+
+// The procedural planes of a strip render. Planes of a frame too big for the
+// field cache are built for this render alone and freed behind the shading,
+// since every read is at the pixel being shaded; others stay shared.
+class StripPlanes {
+public:
+    explicit StripPlanes(RenderPlan& plan)
+        : slots(planeSlots(plan)), owned(!FieldCache::instance().fits(fullPlaneBytes(plan)))
+    {
+        if (!owned) return;
+        for (std::shared_ptr<FieldPlane>* slot : slots) {
+            if (*slot) *slot = (*slot)->blankCopy();
+        }
+    }
+    
+    // Rows above y are shaded and never read again
+    void shadedAbove(int y) {
+        if (!owned) return;
+        for (std::shared_ptr<FieldPlane>* slot : slots) {
+            if (*slot) (*slot)->releaseRowsAbove(y);
+        }
+    }
+    
+private:
+    std::vector<std::shared_ptr<FieldPlane>*> slots;
+    bool owned;
+};
+
+// A producer thread seeds, sweeps and classifies the distance field window of
+// each strip and hands it over a StripQueue; the calling thread shades the
+// strip on the render threads and passes the window back for reuse. The
+// serial chamfer sweeps overlap the shading of the strip before, and at most
+// STRIP_WINDOWS windows of distances ever exist. After a cancel both sides
+// keep passing windows without working on them, so neither waits forever.
+// Only the strips crossing the output window are built and shaded.
+//
+// Planes of a frame too big for the field cache come from StripPlanes, so
+// scratch then grows with the strip height and the frame width, never the
+// frame height.
+template<typename PixelT>
+PF_Err renderStrips(PF_InData* in_data, const RenderPlan& framePlan, PF_EffectWorld* input,
+    const OutputWindow& output, FrameArena& arena, ScratchTable& scratch, RenderProgress& progress)
+{
+    PF_Err err = PF_Err_NONE;
+    const int rowStart = safeMax(0, output.y0);
+    const int rowEnd = safeMin(framePlan.height, output.y1());
+    if (rowStart >= rowEnd) return err;
+    
+    RenderPlan plan = framePlan;
+    StripPlanes planes(plan);
+    
+    TileMap tiles;
+    initTileMap(plan, tiles);
+    
+    const int halo = windowHalo(plan);
+    const int firstStrip = rowStart / STRIP_ROWS;
+    const int stripEnd = (rowEnd + STRIP_ROWS - 1) / STRIP_ROWS;
+    const int windowRows = safeMin(input->height, STRIP_ROWS + 2 * halo);
+    const size_t windowBytes = (size_t)windowRows * input->width * 3 * sizeof(float);
+    const int windowCount = (int)safeMax((size_t)2, safeMin((size_t)STRIP_WINDOWS, STRIP_WINDOW_BYTES / windowBytes));
+    
+    // Input rows [top, bottom) of the distance window for strip i: the rows
+    // read by the shader, clamped to the input as in shadeGeometry, plus the halo
+    auto stripWindow = [&](int i, int& top, int& bottom) {
+        int y0 = i * STRIP_ROWS;
+        int y1 = safeMin(plan.height, y0 + STRIP_ROWS);
+        int readTop = safeMax(0, safeMin(input->height - 1, y0));
+        int readBottom = safeMax(0, safeMin(input->height - 1, y1 - 1));
+        top = safeMax(0, readTop - halo);
+        bottom = safeMin(input->height, readBottom + 1 + halo);
+    };
+    
+    int64_t work = (int64_t)(safeMin(plan.width, output.x1()) - safeMax(0, output.x0)) * (rowEnd - rowStart);
+    for (int i = firstStrip; i < stripEnd; i++) {
+        int top, bottom;
+        stripWindow(i, top, bottom);
+        work += (int64_t)input->width * (bottom - top);
+    }
+    progress.setTotal(work);
+    
+    StripQueue<DistanceField*, STRIP_WINDOWS> ready, spare;
+    for (int i = 0; i < windowCount; i++) {
+        spare.push(arena.create<DistanceField>(arena, input->width, input->height, windowRows));
+    }
+    
+    std::thread producer([&]() {
+        for (int i = firstStrip; i < stripEnd; i++) {
+            int y0 = i * STRIP_ROWS;
+            int y1 = safeMin(plan.height, y0 + STRIP_ROWS);
+            int top, bottom;
+            stripWindow(i, top, bottom);
+            
+            DistanceField* df = spare.pop();
+            if (progress.alive()) {
+                df->setWindow(top, bottom - top);
+                df->buildFromPixels<PixelT>(nullptr, input, progress);
+                classifyTiles<PixelT>(nullptr, plan, *df, input, tiles, progress,
+                    y0 / RENDER_TILE_SIZE, (y1 + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE);
+            }
+            ready.push(df);
+        }
+    });
+    
+    // The producer cannot ask the host, so this thread keeps polling while
+    // it waits for a window and a cancel still reaches the producer
+    for (int i = firstStrip; i < stripEnd; i++) {
+        DistanceField* df = ready.pop([&]() { progress.alive(); });
+        int y0 = i * STRIP_ROWS;
+        int y1 = safeMin(plan.height, y0 + STRIP_ROWS);
+        if (progress.alive()) {
+            ERR(shadeRows<PixelT>(in_data, plan, *df, nullptr, tiles, input, output, scratch, progress, y0, y1));
+        }
+        spare.push(df);
+        planes.shadedAbove(y1);
+    }
+    producer.join();
+    return err;
+}
+
+// Vector edges in strips. The polygons are traced and the tiles classified
+// for the whole frame, which costs memory by the perimeter; the shading then
+// goes a strip at a time so the planes can be freed behind it as in
+// renderStrips.
+template<typename PixelT>
+PF_Err renderVectorStrips(PF_InData* in_data, const RenderPlan& framePlan, PF_EffectWorld* input,
+    const OutputWindow& output, FrameArena& arena, ScratchTable& scratch, RenderProgress& progress)
+{
+    PF_Err err = PF_Err_NONE;
+    const int rowStart = safeMax(0, output.y0);
+    const int rowEnd = safeMin(framePlan.height, output.y1());
+    
+    RenderPlan plan = framePlan;
+    StripPlanes planes(plan);
+    
+    TearPolygons polygons(plan);
+    TearTracer<PixelT>(plan, input, polygons).trace(progress);
+    if (!progress.alive()) return err;
+    TileMap tiles;
+    classifyVectorTiles<PixelT>(in_data, plan, polygons, input, tiles, progress);
+    if (!progress.alive()) return err;
+    
+    DistanceField noDistances(arena, 0, 0);
+    for (int y0 = rowStart / STRIP_ROWS * STRIP_ROWS; y0 < rowEnd && !err && progress.alive(); y0 += STRIP_ROWS) {
+        int y1 = safeMin(plan.height, y0 + STRIP_ROWS);
+        ERR(shadeRows<PixelT>(in_data, plan, noDistances, &polygons, tiles, input, output, scratch, progress, y0, y1));
+        planes.shadedAbove(y1);
+    }
+    return err;
+}
+
+// ============================================================
+// CONNECTED COMPONENTS
+// ============================================================
+
+// Layers whose padded islands cover more than this share of the input build
+// the distance field over the whole frame instead
+#define COMPONENT_MAX_COVERAGE  0.5
+
+// Text and logo layers are a few islands of alpha in an empty frame. Islands
+// are found at tile resolution: tiles holding a pixel the distance field
+// counts as inside are joined with their eight neighbours, and each island's
+// bounding box, padded by the window halo and one pixel for the edge seeded
+// just outside it, becomes a region of the distance field. Overlapping
+// regions are merged, so a pixel in the edge band shares its region with its
+// nearest edge and every chamfer path between them, and the regions hold the
+// same band distances as a field of the whole frame.
+//
+// Returns false and leaves tiles alone when the regions would cover most of
+// the layer. Otherwise fills regions and marks every tile that reads no
+// region pixel empty.
+template<typename PixelT>
+bool findComponents(PF_InData* in_data, const RenderPlan& plan, PF_EffectWorld* input, TileMap& tiles,
+    std::vector<DistanceField::Region>& regions, RenderProgress& progress)
+{
+    const int tilesX = (input->width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    const int tilesY = (input->height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    if (tilesX == 0 || tilesY == 0) return false;
+    
+    // Tiles holding content, a row of tiles per band
+    std::vector<unsigned char> occupied((size_t)tilesX * tilesY, 0);
+    forEachBand(in_data, tilesY, [&](int ty, int) {
+        if (!progress.alive()) return;
+        int y0 = ty * RENDER_TILE_SIZE;
+        int y1 = safeMin(input->height, y0 + RENDER_TILE_SIZE);
+        for (int tx = 0; tx < tilesX; tx++) {
+            int x0 = tx * RENDER_TILE_SIZE;
+            int x1 = safeMin(input->width, x0 + RENDER_TILE_SIZE);
+            bool inside = false;
+            for (int y = y0; y < y1 && !inside; y++) {
+                const PixelT* row = worldRow<PixelT>(input, y);
+                for (int x = x0; x < x1 && !inside; x++) {
+                    inside = (double)PixelTraits<PixelT>::toUnit(row[x].alpha) > 0.5;
+                }
+            }
+            occupied[ty * tilesX + tx] = inside ? 1 : 0;
+        }
+    });
+    if (!progress.alive()) return false;
+    
+    // Bounding boxes of the islands in tiles, inclusive, grown by the padding
+    struct Box {
+        int x0, y0, x1, y1;
+        bool overlaps(const Box& o) const { return x0 <= o.x1 && o.x0 <= x1 && y0 <= o.y1 && o.y0 <= y1; }
+    };
+    const int pad = (windowHalo(plan) + 1 + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    std::vector<Box> boxes;
+    std::vector<int> stack;
+    for (int start = 0; start < tilesX * tilesY; start++) {
+        if (occupied[start] != 1) continue;
+        Box box = { start % tilesX, start / tilesX, start % tilesX, start / tilesX };
+        occupied[start] = 2;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int t = stack.back();
+            stack.pop_back();
+            int tx = t % tilesX, ty = t / tilesX;
+            box.x0 = safeMin(box.x0, tx);
+            box.x1 = safeMax(box.x1, tx);
+            box.y0 = safeMin(box.y0, ty);
+            box.y1 = safeMax(box.y1, ty);
+            for (int ny = safeMax(0, ty - 1); ny <= safeMin(tilesY - 1, ty + 1); ny++) {
+                for (int nx = safeMax(0, tx - 1); nx <= safeMin(tilesX - 1, tx + 1); nx++) {
+                    int n = ny * tilesX + nx;
+                    if (occupied[n] != 1) continue;
+                    occupied[n] = 2;
+                    stack.push_back(n);
+                }
+            }
+        }
+        box.x0 = safeMax(0, box.x0 - pad);
+        box.y0 = safeMax(0, box.y0 - pad);
+        box.x1 = safeMin(tilesX - 1, box.x1 + pad);
+        box.y1 = safeMin(tilesY - 1, box.y1 + pad);
+        boxes.push_back(box);
+    }
+    
+    // A merge can make a box reach others, so repeat until nothing overlaps
+    for (bool merged = true; merged; ) {
+        merged = false;
+        for (size_t i = 0; i < boxes.size(); i++) {
+            for (size_t j = i + 1; j < boxes.size(); ) {
+                if (!boxes[i].overlaps(boxes[j])) {
+                    j++;
+                    continue;
+                }
+                boxes[i].x0 = safeMin(boxes[i].x0, boxes[j].x0);
+                boxes[i].y0 = safeMin(boxes[i].y0, boxes[j].y0);
+                boxes[i].x1 = safeMax(boxes[i].x1, boxes[j].x1);
+                boxes[i].y1 = safeMax(boxes[i].y1, boxes[j].y1);
+                boxes.erase(boxes.begin() + j);
+                merged = true;
+            }
+        }
+    }
+    
+    int64_t area = 0;
+    for (const Box& box : boxes) area += (int64_t)(box.x1 - box.x0 + 1) * (box.y1 - box.y0 + 1);
+    if (area > COMPONENT_MAX_COVERAGE * tilesX * tilesY) return false;
+    
+    std::vector<unsigned char> covered((size_t)tilesX * tilesY, 0);
+    regions.clear();
+    for (const Box& box : boxes) {
+        DistanceField::Region region = {
+            box.x0 * RENDER_TILE_SIZE, box.y0 * RENDER_TILE_SIZE,
+            safeMin(input->width, (box.x1 + 1) * RENDER_TILE_SIZE),
+            safeMin(input->height, (box.y1 + 1) * RENDER_TILE_SIZE)
+        };
+        regions.push_back(region);
+        for (int ty = box.y0; ty <= box.y1; ty++) {
+            for (int tx = box.x0; tx <= box.x1; tx++) covered[ty * tilesX + tx] = 1;
+        }
+    }
+    
+    // Output tiles past the input read its last row or column of pixels
+    for (int ty = 0; ty < tiles.tilesY; ty++) {
+        for (int tx = 0; tx < tiles.tilesX; tx++) {
+            if (!covered[safeMin(ty, tilesY - 1) * tilesX + safeMin(tx, tilesX - 1)]) {
+                tiles.kinds[ty * tiles.tilesX + tx] = TILE_EMPTY;
+            }
+        }
+    }
+    return true;
+}
+
+// Build the distance field, or the torn polygons for vector edges, and shade
+// the output window of the frame for one pixel format. Both are built from
+// the whole input, so a window shades as it would in a render of the whole
+// frame. Distance planes and scratch rows come from an arena borrowed for the
+// frame. Returns PF_Interrupt_CANCEL when the host cancels part way; the
+// output is then incomplete.
+template<typename PixelT>
+PF_Err renderWorld(PF_InData* in_data, const RenderPlan& plan, PF_EffectWorld* input, const OutputWindow& output,
+    bool reportProgress)
+{
+    PF_Err err = PF_Err_NONE;
+    const bool fixed8 = std::is_same<PixelT, PF_Pixel8>::value;
+    ScopedArena arena;
+    ScratchTable scratch(*arena, plan.width, fixed8, plan.vectorEdges);
+    RenderProgress progress(in_data, reportProgress);
+    
+    const int64_t windowPixels = (int64_t)safeMax(0, safeMin(plan.width, output.x1()) - safeMax(0, output.x0)) *
+        safeMax(0, safeMin(plan.height, output.y1()) - safeMax(0, output.y0));
+    
+    if (plan.vectorEdges) {
+        progress.setTotal(windowPixels);
+        ERR(renderVectorStrips<PixelT>(in_data, plan, input, output, *arena, scratch, progress));
+    } else if ((double)plan.width * plan.height >= STRIP_MIN_PIXELS) {
+        ERR(renderStrips<PixelT>(in_data, plan, input, output, *arena, scratch, progress));
+    } else {
+        // Sparse layers only build the field around their islands
+        TileMap tiles;
+        initTileMap(plan, tiles);
+        std::vector<DistanceField::Region> regions;
+        bool sparse = findComponents<PixelT>(in_data, plan, input, tiles, regions, progress);
+        if (!progress.alive()) return progress.result();
+        
+        int64_t fieldPixels = (int64_t)input->width * input->height;
+        if (sparse) {
+            fieldPixels = 0;
+            for (const DistanceField::Region& r : regions) fieldPixels += (int64_t)(r.x1 - r.x0) * (r.y1 - r.y0);
+        }
+        progress.setTotal(fieldPixels + windowPixels);
+        
+        DistanceField df(*arena, input->width, input->height);
+        if (sparse) {
+            df.buildRegions<PixelT>(in_data, input, regions, progress);
+        } else {
+            df.buildFromPixels<PixelT>(in_data, input, progress);
+        }
+        if (!progress.alive()) return progress.result();
+        
+        // Only the tile rows the window crosses are shaded
+        int tyEnd = safeMax(0, safeMin(tiles.tilesY, (output.y1() + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE));
+        int tyStart = safeMin(tyEnd, safeMax(0, output.y0) / RENDER_TILE_SIZE);
+        classifyTiles<PixelT>(in_data, plan, df, input, tiles, progress, tyStart, tyEnd);
+        if (!progress.alive()) return progress.result();
+        
+        ERR(shadeRows<PixelT>(in_data, plan, df, nullptr, tiles, input, output, scratch, progress, 0, plan.height));
+    }
+    
+    if (!err) err = progress.result();
+    return err;
+}
+
+// ============================================================
+// AUTO TUNING
+// ============================================================
+
+enum {
+    CALIBRATION_WIDTH = 640,
+    CALIBRATION_HEIGHT = 480,
+    CALIBRATION_RUNS = 5        // renders timed per candidate
+};
+
+// How much faster than the best so far a candidate must render to replace
+// it, so timing noise does not pick it
+#define CALIBRATION_MARGIN  0.97
+
+// Synthetic layer for calibration: a disc of content with a wavy rim, so a
+// frame has empty, solid and torn tiles in proportions like a real layer
+struct CalibrationFrame {
+    CalibrationFrame(int w, int h) : inputPixels((size_t)w * h), outputPixels((size_t)w * h) {
+        initWorld(input, inputPixels, w, h);
+        initWorld(output, outputPixels, w, h);
+
+        double cx = w * 0.5, cy = h * 0.5;
+        double radius = safeMin(w, h) * 0.38;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                double dx = x - cx, dy = y - cy;
+                double angle = std::atan2(dy, dx);
+                double rim = radius * (1.0 + 0.08 * std::sin(angle * 7.0) + 0.04 * std::sin(angle * 23.0));
+                PF_Pixel8& p = inputPixels[(size_t)y * w + x];
+                p.alpha = (dx * dx + dy * dy <= rim * rim) ? 255 : 0;
+                p.red = (A_u_char)(x * 255 / w);
+                p.green = (A_u_char)(y * 255 / h);
+                p.blue = 128;
+            }
+        }
+    }
+
+    // Whether the output holds exactly these pixels
+    bool outputMatches(const std::vector<PF_Pixel8>& pixels) const {
+        return pixels.size() == outputPixels.size() &&
+            memcmp(pixels.data(), outputPixels.data(), pixels.size() * sizeof(PF_Pixel8)) == 0;
+    }
+
+    OutputWindow window() {
+        OutputWindow window = { &output, 0, 0 };
+        return window;
+    }
+
+    static void initWorld(PF_EffectWorld& world, std::vector<PF_Pixel8>& pixels, int w, int h) {
+        memset(&world, 0, sizeof(world));
+        world.data = pixels.data();
+        world.rowbytes = w * (A_long)sizeof(PF_Pixel8);
+        world.width = w;
+        world.height = h;
+    }
+
+    std::vector<PF_Pixel8> inputPixels, outputPixels;
+    PF_EffectWorld input, output;
+};
+
+// Candidates only change the band height, the task size and how many of the
+// pool's threads a job uses; the workers themselves are restarted once, for
+// the tuning finally picked
+inline void tryTuning(const RenderTuning& tuning) {
+    RenderTuner::instance().set(tuning);
+    TilePool::instance().limit(tuning.poolThreads);
+}
+
+inline void applyTuning(const RenderTuning& tuning) {
+    tryTuning(tuning);
+    if (TilePool::instance().threadCount() != tuning.poolThreads) TilePool::instance().start(tuning.poolThreads);
+}
+
+// Fastest of CALIBRATION_RUNS renders of the calibration frame, in seconds.
+// Bands handed out as iterate_generic does get every pool thread, as AE lends
+// a render all of its own.
+inline PF_Err timeTuning(PF_InData* in_data, const RenderPlan& plan, CalibrationFrame& frame,
+    const RenderTuning& tuning, double& seconds)
+{
+    PF_Err err = PF_Err_NONE;
+    tryTuning(tuning);
+    if (emulateIterateGeneric()) TilePool::instance().limit(TilePool::instance().threadCount());
+    seconds = 1e30;
+    for (int run = 0; run < CALIBRATION_RUNS && !err; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        err = renderWorld<PF_Pixel8>(in_data, plan, &frame.input, frame.window(), false);
+        seconds = safeMin(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return err;
+}
+
+// Param values as ParamsSetup declares them, recorded by running it against
+// an add_param that keeps each def instead of handing it to the host
+class DefaultParams {
+public:
+    explicit DefaultParams(const PF_InData* in_data) : added(0) {
+        memset(values, 0, sizeof(values));
+        PF_InData recorder = *in_data;
+        recorder.effect_ref = this;
+        recorder.inter.add_param = &DefaultParams::record;
+        PF_OutData out_data;
+        AEFX_CLR_STRUCT(out_data);
+        ParamsSetup(&recorder, &out_data, nullptr, nullptr);
+        for (int i = 0; i < PARAM_NUM_PARAMS; i++) pointers[i] = &values[i];
+    }
+
+    PF_ParamDef** params() { return pointers; }
+
+private:
+    // The input layer is param 0 and never added
+    static PF_Err record(PF_ProgPtr effect_ref, PF_ParamIndex, PF_ParamDef* def) {
+        DefaultParams* self = static_cast<DefaultParams*>(effect_ref);
+        if (++self->added < PARAM_NUM_PARAMS) self->values[self->added] = *def;
+        return PF_Err_NONE;
+    }
+
+    PF_ParamDef values[PARAM_NUM_PARAMS];
+    PF_ParamDef* pointers[PARAM_NUM_PARAMS];
+    int added;
+};
+
+// A calibration render has no host to ask, so it stops whenever the
+// prefetch thread it runs on has newer work
+inline PF_Err calibrationAbort(PF_ProgPtr) {
+    return Prefetcher::instance().overtaken() ? PF_Interrupt_CANCEL : PF_Err_NONE;
+}
+
+// Times candidate tunings on the calibration frame and applies and saves the
+// fastest. Runs on the prefetch thread after GlobalSetup found no current
+// tuning, with the default params at full resolution so the result never
+// depends on a project, and with TilePool threads since the host's own
+// threads are only lent to a render; renders meanwhile carry on with whatever
+// tuning is current. The pool's threads and task size are timed on the pool's
+// tiles, and the band height with bands handed out as iterate_generic does,
+// each on the path that uses it. The tuning only decides how the work is split, so every
+// candidate must render the pixels of the first; one that does not is never
+// picked. A field precompute overtakes the calibration, which then keeps the
+// defaults until the next session calibrates again.
+class Calibration {
+public:
+    explicit Calibration(const PF_InData* in_data) : inData(*in_data), defaults(in_data) {
+        inData.pica_basicP = nullptr;
+        inData.effect_ref = nullptr;
+        inData.inter.abort = &calibrationAbort;
+        inData.downsample_x.num = inData.downsample_x.den = 1;
+        inData.downsample_y.num = inData.downsample_y.den = 1;
+        inData.current_time = 0;
+    }
+
+    void run() {
+        PF_Err err = PF_Err_NONE;
+        CalibrationFrame frame(CALIBRATION_WIDTH, CALIBRATION_HEIGHT);
+        RenderPlan plan;
+        setupRenderPlan(plan, &inData, defaults.params(), CALIBRATION_WIDTH, CALIBRATION_HEIGHT);
+
+        // The first render fills the field cache so it does not count against a candidate
+        RenderTuning best = defaultTuning();
+        double bestTime = 0;
+        tryTuning(best);
+        ERR(renderWorld<PF_Pixel8>(&inData, plan, &frame.input, frame.window(), false));
+        ERR(timeTuning(&inData, plan, frame, best, bestTime));
+        const std::vector<PF_Pixel8> reference = frame.outputPixels;
+
+        auto consider = [&](const RenderTuning& candidate) {
+            if (err || candidate == best) return;
+            double time = 0;
+            err = timeTuning(&inData, plan, frame, candidate, time);
+            if (!err && time < bestTime * CALIBRATION_MARGIN && frame.outputMatches(reference)) {
+                best = candidate;
+                bestTime = time;
+            }
+        };
+
+        int cores = defaultTuning().poolThreads;
+        const int threadCounts[] = { cores, safeMax(1, cores / 2) };
+        const int spans[] = { 1, 2 };
+        RenderTuning base = best;
+        for (int threads : threadCounts) {
+            for (int span : spans) {
+                RenderTuning candidate = base;
+                candidate.poolThreads = threads;
+                candidate.poolTileSpan = span;
+                consider(candidate);
+            }
+        }
+        
+        // The band height against its own baseline, on the other path
+        emulateIterateGeneric() = true;
+        ERR(timeTuning(&inData, plan, frame, best, bestTime));
+        const int bandRows[] = { 8, 16, 32, 64 };
+        base = best;
+        for (int rows : bandRows) {
+            RenderTuning candidate = base;
+            candidate.bandRows = rows;
+            consider(candidate);
+        }
+        emulateIterateGeneric() = false;
+
+        if (err) {
+            applyTuning(defaultTuning());
+            RenderTuner::instance().releaseCalibration();
+            return;
+        }
+        applyTuning(best);
+        RenderTuner::instance().save(best);
+    }
+
+private:
+    PF_InData inData;
+    DefaultParams defaults;
+};
+
+inline void calibrateInBackground(PF_InData* in_data) {
+    if (!RenderTuner::instance().claimCalibration()) return;
+    std::shared_ptr<Calibration> job = std::make_shared<Calibration>(in_data);
+    Prefetcher::instance().submit([job]() { job->run(); });
+}
+
+// ============================================================
+// FIELD PRECOMPUTE
+// ============================================================
+
+// Pixels SmartPreRender adds around the input for fibers reaching past it
+inline A_long fiberExpansion(double fiberLength, double masterScale) {
+    A_long expand = (A_long)(fiberLength * masterScale + 20);
+    if (expand > MAX_EXPAND_PIXELS) expand = MAX_EXPAND_PIXELS;
+    return expand;
+}
+
+// Sizes of a rendered frame. The cached planes are keyed by output size and
+// downsampling, which a param change does not report, so the precompute
+// assumes the next frame is laid out like the last one.
+struct RenderTarget {
+    int inputWidth, inputHeight;
+    int outputWidth, outputHeight;
+    A_long expand;
+    PF_RationalScale downsampleX, downsampleY;
+};
+
+class LastRenderTarget {
+public:
+    static LastRenderTarget& instance() {
+        static LastRenderTarget last;
+        return last;
+    }
+
+    void record(const RenderTarget& t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = t;
+        valid = true;
+    }
+
+    bool get(RenderTarget& t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        t = target;
+        return valid;
+    }
+
+private:
+    LastRenderTarget() : valid(false) {}
+
+    std::mutex mutex;
+    RenderTarget target;
+    bool valid;
+};
+
+// Output extent once the expansion changes. Where the output is larger than
+// the input it was grown by the expansion on one side or both.
+inline int expandedExtent(int input, int output, A_long oldExpand, A_long newExpand) {
+    if (output <= input || oldExpand <= 0) return output;
+    return input + (int)((A_long)(output - input) * newExpand / oldExpand);
+}
+
+// Param values copied out of a change notification, resolved on the
+// prefetch thread at the size the next frame is expected to have
+class FieldPrecompute {
+public:
+    FieldPrecompute(const PF_InData* in_data, PF_ParamDef* params[], const RenderTarget& target)
+        : inData(*in_data)
+    {
+        for (int i = 0; i < PARAM_NUM_PARAMS; i++) {
+            values[i] = *params[i];
+            pointers[i] = &values[i];
+        }
+        inData.downsample_x = target.downsampleX;
+        inData.downsample_y = target.downsampleY;
+
+        A_long expand = fiberExpansion(values[PARAM_FIBER_LENGTH].u.fs_d.value,
+            values[PARAM_MASTER_SCALE].u.fs_d.value / 100.0);
+        width = expandedExtent(target.inputWidth, target.outputWidth, target.expand, expand);
+        height = expandedExtent(target.inputHeight, target.outputHeight, target.expand, expand);
+    }
+
+    // Resolving the plan builds the folds; the planes are then filled a tile
+    // row at a time. Planes too big to stay cached are left alone, since the
+    // strip render builds its own.
+    void run() {
+        RenderPlan plan;
+        setupRenderPlan(plan, &inData, pointers, width, height);
+        if (!FieldCache::instance().fits(fullPlaneBytes(plan))) return;
+
+        for (std::shared_ptr<FieldPlane>* slot : planeSlots(plan)) {
+            FieldPlane* plane = slot->get();
+            if (!plane) continue;
+            for (int ty = 0; ty < plane->tileRows(); ty++) {
+                if (Prefetcher::instance().overtaken()) return;
+                plane->fillTileRow(ty);
+            }
+        }
+    }
+
+private:
+    PF_InData inData;
+    PF_ParamDef values[PARAM_NUM_PARAMS];
+    PF_ParamDef* pointers[PARAM_NUM_PARAMS];
+    int width, height;
+};
+
+// A supervised param changed: build the fields for the new values in the
+// background so the next render finds them in the field cache. A render
+// builds whatever is not ready yet itself, so a late or mispredicted
+// precompute only costs the background thread's time.
+PF_Err UserChangedParam(
+    PF_InData       *in_data,
+    PF_OutData      *out_data,
+    PF_ParamDef     *params[],
+    PF_LayerDef     *output)
+{
+    RenderTarget target;
+    if (!LastRenderTarget::instance().get(target)) {
+        target.inputWidth = target.outputWidth = in_data->width;
+        target.inputHeight = target.outputHeight = in_data->height;
+        target.expand = 0;
+        target.downsampleX = in_data->downsample_x;
+        target.downsampleY = in_data->downsample_y;
+    }
+
+    std::shared_ptr<FieldPrecompute> job = std::make_shared<FieldPrecompute>(in_data, params, target);
+    Prefetcher::instance().submit([job]() { job->run(); });
+
+    return PF_Err_NONE;
+}
+
+// Params the vector edge engine has no use for: fibers grow from distances
+// and polygon edges are antialiased by area
+static const PF_ParamIndex kDistanceOnlyParams[] = {
+    PARAM_EDGE_SOFTNESS,
+    PARAM_MIDDLE1_FIBER_DENSITY, PARAM_MIDDLE2_FIBER_DENSITY, PARAM_FIBER_COLOR,
+    PARAM_FIBER_DENSITY, PARAM_FIBER_LENGTH, PARAM_FIBER_THICKNESS, PARAM_FIBER_SPREAD,
+    PARAM_FIBER_SOFTNESS, PARAM_FIBER_FEATHER, PARAM_FIBER_RANGE, PARAM_FIBER_SHADOW,
+    PARAM_FIBER_OPACITY, PARAM_FIBER_BLUR
+};
+
+PF_Err UpdateParamsUI(
+    PF_InData       *in_data,
+    PF_OutData      *out_data,
+    PF_ParamDef     *params[],
+    PF_LayerDef     *output)
+{
+    PF_Err err = PF_Err_NONE;
+    AEGP_SuiteHandler suites(in_data->pica_basicP);
+    
+    // Disable the params Vector Polygons ignores while it is selected
+    bool vector = params[PARAM_EDGE_ENGINE]->u.pd.value == EDGE_ENGINE_VECTOR;
+    for (PF_ParamIndex index : kDistanceOnlyParams) {
+        bool disabled = (params[index]->ui_flags & PF_PUI_DISABLED) != 0;
+        if (disabled == vector) continue;
+        
+        PF_ParamDef def = *params[index];
+        if (vector) {
+            def.ui_flags |= PF_PUI_DISABLED;
+        } else {
+            def.ui_flags &= ~PF_PUI_DISABLED;
+        }
+        ERR(suites.ParamUtilsSuite3()->PF_UpdateParamUI(in_data->effect_ref, index, &def));
+    }
+    
+    return err;
+}
+
+// Where a render's worlds lie in layer coordinates, and the extent of the
+// effect's whole output there. The plan and its cached fields are sized by
+// that extent and never by the rect the host asked for, so every request
+// shades a pixel from the same fields.
+struct FrameLayout {
+    int inputX, inputY;
+    int outputX, outputY;
+    int width, height;
+};
+
+// Render gets the whole output, lined up with the input
+inline FrameLayout wholeOutputLayout(PF_EffectWorld* output) {
+    FrameLayout layout = { 0, 0, 0, 0, output->width, output->height };
+    return layout;
+}
+
+// SmartRender's worlds carry their offsets from the layer origin. The whole
+// output is the input grown by the fiber expansion, as SmartPreRender reports
+// it; the output world is some part of that.
+inline FrameLayout smartLayout(PF_EffectWorld* input, PF_EffectWorld* output, A_long expand) {
+    FrameLayout layout;
+    layout.inputX = input->origin_x;
+    layout.inputY = input->origin_y;
+    layout.outputX = output->origin_x;
+    layout.outputY = output->origin_y;
+    layout.width = safeMax(layout.inputX + input->width + (int)expand, layout.outputX + output->width);
+    layout.height = safeMax(layout.inputY + input->height + (int)expand, layout.outputY + output->height);
+    return layout;
+}
+
+// The input as a world whose pixel (x, y) is layer pixel (x, y). An input
+// starting at the layer origin, as the whole-layer request gives, is used as
+// it is. Otherwise the input is copied, behind a transparent margin where it
+// starts inside the layer and without its pixels left of or above the origin.
+template<typename PixelT>
+PF_EffectWorld* layerInput(PF_EffectWorld* input, const FrameLayout& layout, PF_EffectWorld& copy,
+    std::vector<PixelT>& pixels)
+{
+    if (layout.inputX == 0 && layout.inputY == 0) return input;
+    
+    int width = safeMax(1, layout.inputX + input->width);
+    int height = safeMax(1, layout.inputY + input->height);
+    pixels.assign((size_t)width * height, PixelT());
+    copy = *input;
+    copy.data = (PF_PixelPtr)pixels.data();
+    copy.rowbytes = width * (A_long)sizeof(PixelT);
+    copy.width = width;
+    copy.height = height;
+    copy.origin_x = 0;
+    copy.origin_y = 0;
+    
+    int x0 = safeMax(0, layout.inputX);
+    int x1 = layout.inputX + input->width;
+    for (int y = safeMax(0, layout.inputY); y < layout.inputY + input->height && x0 < x1; y++) {
+        memcpy(worldRow<PixelT>(&copy, y) + x0, worldRow<PixelT>(input, y - layout.inputY) + (x0 - layout.inputX),
+            (x1 - x0) * sizeof(PixelT));
+    }
+    return &copy;
+}
+
+// Render the part of the frame the output world holds
+template<typename PixelT>
+PF_Err renderLayout(PF_InData* in_data, const RenderPlan& plan, PF_EffectWorld* input, PF_EffectWorld* output,
+    const FrameLayout& layout)
+{
+    PF_EffectWorld copy;
+    std::vector<PixelT> pixels;
+    OutputWindow window = { output, layout.outputX, layout.outputY };
+    return renderWorld<PixelT>(in_data, plan, layerInput<PixelT>(input, layout, copy, pixels), window, true);
+}
+
+// Shared by Render and SmartRender: resolve the plan, then dispatch on the
+// output world's pixel format
+PF_Err renderFrame(
+    PF_InData       *in_data,
+    PF_OutData      *out_data,
+    PF_ParamDef     *params[],
+    PF_EffectWorld  *input,
+    PF_EffectWorld  *output,
+    const FrameLayout& layout)
+{
+    PF_Err err = PF_Err_NONE;
+    
+    RenderPlan plan;
+    setupRenderPlan(plan, in_data, params, layout.width, layout.height);
+    
+    RenderTarget target;
+    target.inputWidth = input->width;
+    target.inputHeight = input->height;
+    target.outputWidth = layout.width;
+    target.outputHeight = layout.height;
+    target.expand = fiberExpansion(params[PARAM_FIBER_LENGTH]->u.fs_d.value,
+        params[PARAM_MASTER_SCALE]->u.fs_d.value / 100.0);
+    target.downsampleX = in_data->downsample_x;
+    target.downsampleY = in_data->downsample_y;
+    LastRenderTarget::instance().record(target);
+    
+    // Pixel format from the world itself
+    PF_PixelFormat format = PF_PixelFormat_INVALID;
+    AEFX_SuiteScoper<PF_WorldSuite2> worldSuite(in_data, kPFWorldSuite, kPFWorldSuiteVersion2, out_data);
+    ERR(worldSuite->PF_GetPixelFormat(output, &format));
+    
+    if (!err) {
+        switch (format) {
+            case PF_PixelFormat_ARGB128:
+                err = renderLayout<PF_PixelFloat>(in_data, plan, input, output, layout);
+                break;
+            case PF_PixelFormat_ARGB64:
+                err = renderLayout<PF_Pixel16>(in_data, plan, input, output, layout);
+                break;
+            case PF_PixelFormat_ARGB32:
+                err = renderLayout<PF_Pixel8>(in_data, plan, input, output, layout);
+                break;
+            default:
+                err = PF_Err_BAD_CALLBACK_PARAM;
+                break;
+        }
+    }
+    
+    return err;
+}
+
+// ============================================================
+// MAIN RENDER
+// ============================================================
+
+PF_Err Render(
+    PF_InData       *in_data,
+    PF_OutData      *out_data,
+    PF_ParamDef     *params[],
+    PF_LayerDef     *output)
+{
+    // Parameters arrive already checked out at the current time
+    return renderFrame(in_data, out_data, params, &params[PARAM_INPUT]->u.ld, output, wholeOutputLayout(output));
+}
+
+// ============================================================
+// SMART RENDER IMPLEMENTATION
+// ============================================================
 
 PF_Err SmartPreRender(
     PF_InData           *in_data,
@@ -1962,8 +5229,13 @@ PF_Err SmartPreRender(
     PF_RenderRequest req = extra->input->output_request;
     PF_CheckoutResult checkout;
     
-    // We need the full input layer for distance field calculation
-    // Request entire layer
+    // The distance field needs the whole input layer whatever part of the
+    // output was asked for, so the request grows to cover the layer. AE clips
+    // it to the pixels the layer has.
+    req.rect.left = safeMin(req.rect.left, (A_long)0);
+    req.rect.top = safeMin(req.rect.top, (A_long)0);
+    req.rect.right = safeMax(req.rect.right, in_data->width);
+    req.rect.bottom = safeMax(req.rect.bottom, in_data->height);
     req.preserve_rgb_of_zero_alpha = TRUE;
     
     // Checkout the input layer
@@ -2002,8 +5274,7 @@ PF_Err SmartPreRender(
         }
         
         // Calculate expansion based on fiber length
-        A_long expand = (A_long)(fiberLength * masterScale + 20);
-        if (expand > MAX_EXPAND_PIXELS) expand = MAX_EXPAND_PIXELS;
+        A_long expand = fiberExpansion(fiberLength, masterScale);
         
         // Set the result rect (expanded from input)
         extra->output->result_rect = checkout.result_rect;
@@ -2052,7 +5323,11 @@ PF_Err SmartRender(
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_MASTER_SCALE, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_MASTER_SCALE]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_GAP_WIDTH, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_GAP_WIDTH]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_RANDOM_SEED, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_RANDOM_SEED]));
+        ERR(PF_CHECKOUT_PARAM(in_data, PARAM_BOIL, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_BOIL]));
+        ERR(PF_CHECKOUT_PARAM(in_data, PARAM_BOIL_HOLD, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_BOIL_HOLD]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_EDGE_SOFTNESS, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_EDGE_SOFTNESS]));
+        ERR(PF_CHECKOUT_PARAM(in_data, PARAM_ADAPTIVE_SHADING, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_ADAPTIVE_SHADING]));
+        ERR(PF_CHECKOUT_PARAM(in_data, PARAM_EDGE_ENGINE, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_EDGE_ENGINE]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_OUTER_ROUGHNESS, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_OUTER_ROUGHNESS]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_OUTER_ROUGH_SCALE, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_OUTER_ROUGH_SCALE]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_OUTER_JAGGEDNESS, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_OUTER_JAGGEDNESS]));
@@ -2093,6 +5368,10 @@ PF_Err SmartRender(
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_AMOUNT, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_AMOUNT]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_POINT1, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_POINT1]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_POINT2, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_POINT2]));
+        ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_LAYOUT, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_LAYOUT]));
+        for (int i = PARAM_FOLD2_AMOUNT; i <= PARAM_FOLD6_END; i++) {
+            ERR(PF_CHECKOUT_PARAM(in_data, i, in_data->current_time, in_data->time_step, in_data->time_scale, &params[i]));
+        }
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_LINE_ROUGHNESS, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_LINE_ROUGHNESS]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_LINE_ROUGH_SCALE, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_LINE_ROUGH_SCALE]));
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_FOLD_LINE_WIDTH, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_FOLD_LINE_WIDTH]));
@@ -2137,540 +5416,25 @@ PF_Err SmartRender(
         ERR(PF_CHECKOUT_PARAM(in_data, PARAM_DUST_COLOR, in_data->current_time, in_data->time_step, in_data->time_scale, &params[PARAM_DUST_COLOR]));
         
         if (!err) {
-            // Calculate downsample factor for preview resolution scaling
-            // At full res: num=1, den=1 -> factor=1.0
-            // At half res: num=1, den=2 -> factor=0.5
-            double downsampleX = (double)in_data->downsample_x.num / (double)in_data->downsample_x.den;
-            double downsampleY = (double)in_data->downsample_y.num / (double)in_data->downsample_y.den;
-            double downsampleFactor = (downsampleX + downsampleY) * 0.5;  // Average of X and Y
-            
-            // Extract parameter values
-            // DON'T scale masterScale - we work in full-res coordinate space
-            double masterScale = params[PARAM_MASTER_SCALE].u.fs_d.value / 100.0;
-            
-            double gapWidth = params[PARAM_GAP_WIDTH].u.fs_d.value * masterScale;
-            int seed = params[PARAM_RANDOM_SEED].u.sd.value;
-            double edgeSoftness = params[PARAM_EDGE_SOFTNESS].u.fs_d.value * masterScale;
-            
-            double outerRoughness = params[PARAM_OUTER_ROUGHNESS].u.fs_d.value;
-            double outerRoughScale = params[PARAM_OUTER_ROUGH_SCALE].u.fs_d.value;
-            double outerJaggedness = params[PARAM_OUTER_JAGGEDNESS].u.fs_d.value;
-            double outerNotch = params[PARAM_OUTER_NOTCH].u.fs_d.value;
-            
-            double innerRoughness = params[PARAM_INNER_ROUGHNESS].u.fs_d.value;
-            double innerRoughScale = params[PARAM_INNER_ROUGH_SCALE].u.fs_d.value;
-            double innerJaggedness = params[PARAM_INNER_JAGGEDNESS].u.fs_d.value;
-            double innerNotch = params[PARAM_INNER_NOTCH].u.fs_d.value;
-            double innerExpansion = params[PARAM_INNER_EXPANSION].u.fs_d.value;
-            
-            double middle1Amount = params[PARAM_MIDDLE1_AMOUNT].u.fs_d.value / 100.0;
-            double middle1Position = params[PARAM_MIDDLE1_POSITION].u.fs_d.value / 100.0;
-            double middle1Roughness = params[PARAM_MIDDLE1_ROUGHNESS].u.fs_d.value;
-            double middle1Shadow = params[PARAM_MIDDLE1_SHADOW].u.fs_d.value / 100.0;
-            double middle1FiberDensity = params[PARAM_MIDDLE1_FIBER_DENSITY].u.fs_d.value;
-            
-            double middle2Amount = params[PARAM_MIDDLE2_AMOUNT].u.fs_d.value / 100.0;
-            double middle2Position = params[PARAM_MIDDLE2_POSITION].u.fs_d.value / 100.0;
-            double middle2Roughness = params[PARAM_MIDDLE2_ROUGHNESS].u.fs_d.value;
-            double middle2Shadow = params[PARAM_MIDDLE2_SHADOW].u.fs_d.value / 100.0;
-            double middle2FiberDensity = params[PARAM_MIDDLE2_FIBER_DENSITY].u.fs_d.value;
-            
-            double paperTexture = params[PARAM_PAPER_TEXTURE].u.fs_d.value / 100.0;
-            double shadowAmount = params[PARAM_SHADOW_AMOUNT].u.fs_d.value / 100.0;
-            double shadowWidth = params[PARAM_SHADOW_WIDTH].u.fs_d.value * masterScale;
-            
-            PF_Pixel paperColor = params[PARAM_PAPER_COLOR].u.cd.value;
-            double paperBaseR = paperColor.red / 255.0;
-            double paperBaseG = paperColor.green / 255.0;
-            double paperBaseB = paperColor.blue / 255.0;
-            
-            PF_Pixel fiberColor = params[PARAM_FIBER_COLOR].u.cd.value;
-            double fiberBaseR = fiberColor.red / 255.0;
-            double fiberBaseG = fiberColor.green / 255.0;
-            double fiberBaseB = fiberColor.blue / 255.0;
-            
-            double innerShadowAmount = params[PARAM_CONTENT_SHADOW_AMOUNT].u.fs_d.value / 100.0;
-            double innerShadowWidth = params[PARAM_CONTENT_SHADOW_WIDTH].u.fs_d.value * masterScale;
-            
-            double fiberDensity = params[PARAM_FIBER_DENSITY].u.fs_d.value;
-            double fiberLength = params[PARAM_FIBER_LENGTH].u.fs_d.value * masterScale;
-            double fiberThickness = params[PARAM_FIBER_THICKNESS].u.fs_d.value * masterScale;
-            double fiberSpread = params[PARAM_FIBER_SPREAD].u.fs_d.value;
-            double fiberSoftness = params[PARAM_FIBER_SOFTNESS].u.fs_d.value / 100.0;
-            double fiberFeather = params[PARAM_FIBER_FEATHER].u.fs_d.value / 100.0;
-            double fiberRange = params[PARAM_FIBER_RANGE].u.fs_d.value;
-            double fiberShadow = params[PARAM_FIBER_SHADOW].u.fs_d.value / 100.0;
-            double fiberOpacity = params[PARAM_FIBER_OPACITY].u.fs_d.value / 100.0;
-            double fiberBlur = params[PARAM_FIBER_BLUR].u.fs_d.value;
-            double fiberColorVar = 0.30;  // Hardcoded, control removed
-            
-            double foldAmount = params[PARAM_FOLD_AMOUNT].u.fs_d.value / 100.0;
-            A_long fold1X = params[PARAM_FOLD_POINT1].u.td.x_value;
-            A_long fold1Y = params[PARAM_FOLD_POINT1].u.td.y_value;
-            A_long fold2X = params[PARAM_FOLD_POINT2].u.td.x_value;
-            A_long fold2Y = params[PARAM_FOLD_POINT2].u.td.y_value;
-            double foldLineRoughness = params[PARAM_FOLD_LINE_ROUGHNESS].u.fs_d.value;
-            double foldLineRoughScale = params[PARAM_FOLD_LINE_ROUGH_SCALE].u.fs_d.value;
-            // These pixel values are used in noise-coordinate space (full resolution)
-            double foldLineWidth = params[PARAM_FOLD_LINE_WIDTH].u.fs_d.value;
-            double foldSideAWidth = params[PARAM_FOLD_SIDE_A_WIDTH].u.fs_d.value;
-            double foldSideARoughness = params[PARAM_FOLD_SIDE_A_ROUGHNESS].u.fs_d.value;
-            double foldSideARoughScale = params[PARAM_FOLD_SIDE_A_ROUGH_SCALE].u.fs_d.value;
-            double foldSideAJagged = params[PARAM_FOLD_SIDE_A_JAGGEDNESS].u.fs_d.value;
-            double foldSideASoftness = 0.0;  // Hardcoded, control removed
-            double foldSideBWidth = params[PARAM_FOLD_SIDE_B_WIDTH].u.fs_d.value;
-            double foldSideBRoughness = params[PARAM_FOLD_SIDE_B_ROUGHNESS].u.fs_d.value;
-            double foldSideBRoughScale = params[PARAM_FOLD_SIDE_B_ROUGH_SCALE].u.fs_d.value;
-            double foldSideBJagged = params[PARAM_FOLD_SIDE_B_JAGGEDNESS].u.fs_d.value;
-            double foldSideBSoftness = 0.0;  // Hardcoded, control removed
-            double foldCrackAmount = params[PARAM_FOLD_CRACK_AMOUNT].u.fs_d.value / 100.0;
-            double foldCrackLength = params[PARAM_FOLD_CRACK_LENGTH].u.fs_d.value;
-            double foldCrackLengthVar = params[PARAM_FOLD_CRACK_LENGTH_VAR].u.fs_d.value / 100.0;
-            double foldCrackDensity = params[PARAM_FOLD_CRACK_DENSITY].u.fs_d.value;
-            double foldCrackBranching = params[PARAM_FOLD_CRACK_BRANCHING].u.fs_d.value / 100.0;
-            double foldCrackAngle = params[PARAM_FOLD_CRACK_ANGLE].u.fs_d.value;
-            double foldCrackAngleVar = params[PARAM_FOLD_CRACK_ANGLE_VAR].u.fs_d.value;
-            double foldShadowAOpacity = params[PARAM_FOLD_SHADOW_A_OPACITY].u.fs_d.value / 100.0;
-            double foldShadowALength = params[PARAM_FOLD_SHADOW_A_LENGTH].u.fs_d.value;
-            double foldShadowAVariability = params[PARAM_FOLD_SHADOW_A_VARIABILITY].u.fs_d.value / 100.0;
-            PF_Pixel foldShadowAColor = params[PARAM_FOLD_SHADOW_A_COLOR].u.cd.value;
-            double foldShadowBOpacity = params[PARAM_FOLD_SHADOW_B_OPACITY].u.fs_d.value / 100.0;
-            double foldShadowBLength = params[PARAM_FOLD_SHADOW_B_LENGTH].u.fs_d.value;
-            double foldShadowBVariability = params[PARAM_FOLD_SHADOW_B_VARIABILITY].u.fs_d.value / 100.0;
-            PF_Pixel foldShadowBColor = params[PARAM_FOLD_SHADOW_B_COLOR].u.cd.value;
-            
-            double dirtAmount = params[PARAM_DIRT_AMOUNT].u.fs_d.value;
-            double dirtSize = params[PARAM_DIRT_SIZE].u.fs_d.value;
-            double dirtOpacity = params[PARAM_DIRT_OPACITY].u.fs_d.value / 100.0;
-            int dirtSeed = params[PARAM_DIRT_SEED].u.sd.value;
-            PF_Pixel dirtColor = params[PARAM_DIRT_COLOR].u.cd.value;
-            double dirtR = dirtColor.red / 255.0;
-            double dirtG = dirtColor.green / 255.0;
-            double dirtB = dirtColor.blue / 255.0;
-            
-            double smudgeAmount = params[PARAM_SMUDGE_AMOUNT].u.fs_d.value;
-            double smudgeSize = params[PARAM_SMUDGE_SIZE].u.fs_d.value;
-            double smudgeOpacity = params[PARAM_SMUDGE_OPACITY].u.fs_d.value / 100.0;
-            int smudgeSeed = params[PARAM_SMUDGE_SEED].u.sd.value;
-            PF_Pixel smudgeColor = params[PARAM_SMUDGE_COLOR].u.cd.value;
-            double smudgeR = smudgeColor.red / 255.0;
-            double smudgeG = smudgeColor.green / 255.0;
-            double smudgeB = smudgeColor.blue / 255.0;
-            
-            double dustAmount = params[PARAM_DUST_AMOUNT].u.fs_d.value;
-            double dustSize = params[PARAM_DUST_SIZE].u.fs_d.value;
-            int dustSeed = params[PARAM_DUST_SEED].u.sd.value;
-            PF_Pixel dustColor = params[PARAM_DUST_COLOR].u.cd.value;
-            double dustR = dustColor.red / 255.0;
-            double dustG = dustColor.green / 255.0;
-            double dustB = dustColor.blue / 255.0;
-            
-            int width = output->width;
-            int height = output->height;
-            
-            // Fold points are in full-resolution layer coordinates
-            // We'll divide by downsampleFactor when calling foldCrease to match noisePx/noisePy
-            double fp1x = (double)fold1X / 65536.0;
-            double fp1y = (double)fold1Y / 65536.0;
-            double fp2x = (double)fold2X / 65536.0;
-            double fp2y = (double)fold2Y / 65536.0;
-            
-            // Build distance field from input
-            // Need to handle different pixel formats for distance field too
-            DistanceField df(input->width, input->height);
-            
-            // Determine bit depth properly
-            // PF_WORLD_IS_DEEP checks for 16-bit
-            // For 32-bit float, we need to check world_flags for specific flag
-            bool is16bit = PF_WORLD_IS_DEEP(output) ? true : false;
-            bool isFloat = false;
-            
-            // Check if 32-bit float by looking at actual bytes per pixel
-            // 8-bit: 4 bytes per pixel (but rowbytes may have padding)
-            // 16-bit: 8 bytes per pixel  
-            // 32-bit float: 16 bytes per pixel
-            // Use a more reliable check - if not 16-bit deep, check if rowbytes suggests float
-            if (!is16bit) {
-                // Minimum bytes needed for the row without padding
-                A_long minRowBytes8 = output->width * 4;   // 8-bit ARGB
-                A_long minRowBytes32 = output->width * 16; // 32-bit float ARGB
-                
-                // If rowbytes is large enough for float, it's probably float
-                if (output->rowbytes >= minRowBytes32) {
-                    isFloat = true;
-                }
-            }
-            
-            // Determine pixel size for array indexing
-            int pixelSize = 4;  // Default 8-bit (4 bytes)
-            if (isFloat) {
-                pixelSize = 16;  // 32-bit float (16 bytes)
-            } else if (is16bit) {
-                pixelSize = 8;   // 16-bit (8 bytes)
+            PF_ParamDef* paramPtrs[PARAM_NUM_PARAMS];
+            for (int i = 0; i < PARAM_NUM_PARAMS; i++) {
+                paramPtrs[i] = &params[i];
             }
             
-            // Build distance field
-            df.buildFromLayerGeneric(input, pixelSize);
-            
-            // Render to output based on format
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    double px = (double)x;
-                    double py = (double)y;
-                    
-                    // Scale coordinates to full-resolution space for consistent noise sampling
-                    // At half res, pixel 50 should sample same noise as pixel 100 at full res
-                    double noisePx = px / downsampleFactor;
-                    double noisePy = py / downsampleFactor;
-                    
-                    // Map output coords to input coords (handle expansion)
-                    int inX = x;
-                    int inY = y;
-                    
-                    // Get distance field values (clamp to input bounds)
-                    int dfX = safeMax(0, safeMin(input->width - 1, inX));
-                    int dfY = safeMax(0, safeMin(input->height - 1, inY));
-                    
-                    // signedDist is in canvas pixels - scale to full-res space
-                    float signedDistRaw = df.getDist(dfX, dfY);
-                    double signedDist = signedDistRaw / downsampleFactor;
-                    float gradX, gradY;
-                    df.getGradient(dfX, dfY, gradX, gradY);
-                    
-                    // Get source pixel (with bounds check) - normalized to 0.0-1.0
-                    double srcR = 0, srcG = 0, srcB = 0, srcA = 0;
-                    if (inX >= 0 && inX < input->width && inY >= 0 && inY < input->height) {
-                        if (isFloat) {
-                            // 32-bit float
-                            PF_PixelFloat* inRow = (PF_PixelFloat*)((char*)input->data + inY * input->rowbytes);
-                            srcR = inRow[inX].red;
-                            srcG = inRow[inX].green;
-                            srcB = inRow[inX].blue;
-                            srcA = inRow[inX].alpha;
-                        } else if (is16bit) {
-                            // 16-bit
-                            PF_Pixel16* inRow = (PF_Pixel16*)((char*)input->data + inY * input->rowbytes);
-                            srcR = inRow[inX].red / 32768.0;
-                            srcG = inRow[inX].green / 32768.0;
-                            srcB = inRow[inX].blue / 32768.0;
-                            srcA = inRow[inX].alpha / 32768.0;
-                        } else {
-                            // 8-bit
-                            PF_Pixel8* inRow = (PF_Pixel8*)((char*)input->data + inY * input->rowbytes);
-                            srcR = inRow[inX].red / 255.0;
-                            srcG = inRow[inX].green / 255.0;
-                            srcB = inRow[inX].blue / 255.0;
-                            srcA = inRow[inX].alpha / 255.0;
-                        }
-                    }
-                    
-                    // Edge displacements - use noise coordinates for consistency
-                    // masterScale is already scaled for pixel sizes, noisePx/noisePy for noise
-                    double outerDisp = calcEdgeDisplacement(noisePx, noisePy, seed, 
-                        outerRoughness, outerRoughScale, outerJaggedness, outerNotch, masterScale);
-                    double innerDispRaw = calcEdgeDisplacement(noisePx + 1000, noisePy + 1000, seed + 5000,
-                        innerRoughness, innerRoughScale, innerJaggedness, innerNotch, masterScale);
-                    // Shift inner edge based on expansion control
-                    // expansion=100: no shift (innerDisp = innerDispRaw)
-                    // expansion=50: current behavior (small shift)
-                    // expansion=1: maximum shift inward
-                    double expansionFactor = (100.0 - innerExpansion) / 50.0;  // 0 at 100, 1 at 50, ~2 at 1
-                    double innerDispMaxEstimate = (innerRoughness + innerJaggedness * 0.5 + innerNotch * 0.3) * masterScale * expansionFactor;
-                    double innerDisp = innerDispRaw - innerDispMaxEstimate;
-                    
-                    double halfGap = gapWidth / 2.0;
-                    double outerEdge = -halfGap + outerDisp;
-                    double innerEdge = halfGap + innerDisp;
-                    
-                    if (innerEdge < outerEdge + 2.0) {
-                        double mid = (innerEdge + outerEdge) / 2.0;
-                        innerEdge = mid + 1.0;
-                        outerEdge = mid - 1.0;
-                    }
-                    
-                    // Middle edges
-                    double middle1Edge = outerEdge;
-                    double middle2Edge = outerEdge;
-                    
-                    if (middle1Amount > 0) {
-                        double m1Disp = calcEdgeDisplacement(noisePx + 2000, noisePy + 2000, seed + 10000,
-                            middle1Roughness, 100.0, middle1Roughness * 0.2, 0, masterScale);
-                        double m1Base = outerEdge + (innerEdge - outerEdge) * middle1Position;
-                        middle1Edge = m1Base + m1Disp * 0.4;
-                        middle1Edge = clamp(middle1Edge, outerEdge + 1.0, innerEdge - 1.0);
-                    }
-                    
-                    if (middle2Amount > 0) {
-                        double m2Disp = calcEdgeDisplacement(noisePx + 3000, noisePy + 3000, seed + 15000,
-                            middle2Roughness, 100.0, middle2Roughness * 0.2, 0, masterScale);
-                        double m2Base = outerEdge + (innerEdge - outerEdge) * middle2Position;
-                        middle2Edge = m2Base + m2Disp * 0.4;
-                        middle2Edge = clamp(middle2Edge, outerEdge + 1.0, innerEdge - 1.0);
-                    }
-                    
-                    // Alphas
-                    double softness = safeMax(0.5, edgeSoftness);
-                    double contentAlpha = smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
-                    
-                    double paperAlpha = 0.0;
-                    if (signedDist <= outerEdge - softness) {
-                        paperAlpha = 0.0;
-                    } else if (signedDist >= innerEdge + softness) {
-                        paperAlpha = 0.0;
-                    } else if (signedDist > outerEdge + softness && signedDist < innerEdge - softness) {
-                        paperAlpha = 1.0;
-                    } else if (signedDist <= outerEdge + softness) {
-                        paperAlpha = smoothstep(outerEdge - softness, outerEdge + softness, signedDist);
-                    } else {
-                        paperAlpha = 1.0 - smoothstep(innerEdge - softness, innerEdge + softness, signedDist);
-                    }
-                    
-                    // Fibers - use noise coordinates for consistency
-                    FiberFieldResult outerFibers = fiberField(noisePx, noisePy, signedDist - outerEdge, gradX, gradY,
-                        fiberDensity, fiberLength, fiberThickness, fiberSpread, 
-                        fiberSoftness, fiberFeather, fiberRange, seed + 1000);
-                    
-                    FiberFieldResult innerFibers = fiberField(noisePx, noisePy, signedDist - innerEdge, -gradX, -gradY,
-                        fiberDensity * 0.7, fiberLength * 0.8, fiberThickness, fiberSpread,
-                        fiberSoftness, fiberFeather, fiberRange, seed + 2000);
-                    
-                    FiberFieldResult middle1Fibers = {0, 0, 0.5, 0};
-                    FiberFieldResult middle2Fibers = {0, 0, 0.5, 0};
-                    
-                    if (middle1Amount > 0 && middle1FiberDensity > 0) {
-                        middle1Fibers = fiberField(noisePx, noisePy, signedDist - middle1Edge, -gradX, -gradY,
-                            middle1FiberDensity, fiberLength * 0.6, fiberThickness, fiberSpread,
-                            fiberSoftness, fiberFeather, fiberRange * 0.5, seed + 3000);
-                        middle1Fibers.opacity *= middle1Amount;
-                        middle1Fibers.shadowOpacity *= middle1Amount;
-                    }
-                    
-                    if (middle2Amount > 0 && middle2FiberDensity > 0) {
-                        middle2Fibers = fiberField(noisePx, noisePy, signedDist - middle2Edge, -gradX, -gradY,
-                            middle2FiberDensity, fiberLength * 0.6, fiberThickness, fiberSpread,
-                            fiberSoftness, fiberFeather, fiberRange * 0.5, seed + 4000);
-                        middle2Fibers.opacity *= middle2Amount;
-                        middle2Fibers.shadowOpacity *= middle2Amount;
-                    }
-                    
-                    double fiberAlpha = safeMax(safeMax(outerFibers.opacity, innerFibers.opacity),
-                                                safeMax(middle1Fibers.opacity, middle2Fibers.opacity));
-                    fiberAlpha *= fiberOpacity;
-                    
-                    double fiberShadowAlpha = safeMax(safeMax(outerFibers.shadowOpacity, innerFibers.shadowOpacity),
-                                                      safeMax(middle1Fibers.shadowOpacity, middle2Fibers.shadowOpacity));
-                    fiberShadowAlpha *= fiberOpacity;
-                    
-                    double fiberColorVariation = 0.5;
-                    double maxFiberOp = fiberAlpha / safeMax(0.001, fiberOpacity);
-                    if (outerFibers.opacity >= maxFiberOp - 0.01) fiberColorVariation = outerFibers.colorVar;
-                    else if (innerFibers.opacity >= maxFiberOp - 0.01) fiberColorVariation = innerFibers.colorVar;
-                    
-                    if (fiberBlur > 0 && fiberAlpha > 0) {
-                        double blurFactor = 1.0 / (1.0 + fiberBlur * 0.2);
-                        fiberAlpha *= blurFactor;
-                        fiberShadowAlpha *= blurFactor;
-                    }
-                    
-                    double totalPaperAlpha = safeMax(paperAlpha, fiberAlpha);
-                    
-                    // Paper backing color with texture
-                    double backingR = paperBaseR;
-                    double backingG = paperBaseG;
-                    double backingB = paperBaseB;
-                    
-                    if (paperTexture > 0) {
-                        double texScale = 3.0 * masterScale / downsampleFactor;
-                        double grain1 = fbm2D(noisePx / texScale, noisePy / texScale, seed + 7000, 3, 0.5);
-                        double grain2 = valueNoise2D(noisePx / (texScale * 0.5), noisePy / (texScale * 0.5), seed + 8000);
-                        double streaks = fbm2D(noisePx / (texScale * 0.67), noisePy / (texScale * 5.0), seed + 9000, 2, 0.6);
-                        
-                        double tex = grain1 * 0.5 + grain2 * 0.3 + streaks * 0.2;
-                        tex = (tex - 0.5) * paperTexture * 0.15;
-                        
-                        backingR = clamp01(backingR + tex);
-                        backingG = clamp01(backingG + tex);
-                        backingB = clamp01(backingB + tex * 0.9);
-                    }
-                    
-                    // Paper color (simplified for SmartRender - full version in Render())
-                    double paperR = paperBaseR, paperG = paperBaseG, paperB = paperBaseB;
-                    
-                    if (totalPaperAlpha > 0.01) {
-                        if (fiberShadow > 0 && fiberShadowAlpha > 0.01) {
-                            double shadowStr = fiberShadowAlpha * fiberShadow * 0.4;
-                            paperR *= (1.0 - shadowStr);
-                            paperG *= (1.0 - shadowStr);
-                            paperB *= (1.0 - shadowStr * 0.8);
-                        }
-                        
-                        if (fiberAlpha > 0.05) {
-                            double colorShift = (fiberColorVariation - 0.5) * fiberColorVar * 0.25;
-                            double fR = fiberBaseR * (1.0 + colorShift * 0.3);
-                            double fG = fiberBaseG * (1.0 + colorShift * 0.2);
-                            double fB = fiberBaseB * (1.0 + colorShift * 0.1);
-                            
-                            double fiberBlend = fiberAlpha * 0.6;
-                            paperR = paperR * (1.0 - fiberBlend) + clamp01(fR) * fiberBlend;
-                            paperG = paperG * (1.0 - fiberBlend) + clamp01(fG) * fiberBlend;
-                            paperB = paperB * (1.0 - fiberBlend) + clamp01(fB) * fiberBlend;
-                        }
-                        
-                        if (paperTexture > 0) {
-                            double texScale = 3.0 * masterScale / downsampleFactor;
-                            double grain1 = fbm2D(noisePx / texScale, noisePy / texScale, seed + 7000, 3, 0.5);
-                            double grain2 = valueNoise2D(noisePx / (texScale * 0.5), noisePy / (texScale * 0.5), seed + 8000);
-                            double streaks = fbm2D(noisePx / (texScale * 0.67), noisePy / (texScale * 5.0), seed + 9000, 2, 0.6);
-                            
-                            double tex = grain1 * 0.5 + grain2 * 0.3 + streaks * 0.2;
-                            tex = (tex - 0.5) * paperTexture * 0.15;
-                            
-                            paperR = clamp01(paperR + tex);
-                            paperG = clamp01(paperG + tex);
-                            paperB = clamp01(paperB + tex * 0.9);
-                        }
-                    }
-                    
-                    // Composite
-                    double finalR, finalG, finalB, finalA;
-                    
-                    if (contentAlpha > 0.01) {
-                        if (srcA > 0.99) {
-                            finalR = srcR;
-                            finalG = srcG;
-                            finalB = srcB;
-                            finalA = 1.0;
-                        } else {
-                            finalR = srcR * srcA + backingR * (1.0 - srcA);
-                            finalG = srcG * srcA + backingG * (1.0 - srcA);
-                            finalB = srcB * srcA + backingB * (1.0 - srcA);
-                            finalA = 1.0;
-                        }
-                        
-                        // Apply fold mark - use noise coordinates
-                        if (foldAmount > 0) {
-                            double crackStrength, foldShadowAStr, foldShadowBStr;
-                            // fp1/fp2 are in full-res space, so divide by downsampleFactor to match noisePx/noisePy
-                            foldCrease(noisePx, noisePy, seed + 50000, 
-                                fp1x / downsampleFactor, fp1y / downsampleFactor, 
-                                fp2x / downsampleFactor, fp2y / downsampleFactor,
-                                foldLineRoughness, foldLineRoughScale, foldLineWidth,
-                                foldSideAWidth, foldSideARoughness, foldSideARoughScale, foldSideAJagged, foldSideASoftness,
-                                foldSideBWidth, foldSideBRoughness, foldSideBRoughScale, foldSideBJagged, foldSideBSoftness,
-                                foldCrackAmount, foldCrackLength, foldCrackLengthVar, foldCrackDensity, foldCrackBranching,
-                                foldCrackAngle, foldCrackAngleVar,
-                                foldShadowAOpacity, foldShadowALength, foldShadowAVariability,
-                                foldShadowBOpacity, foldShadowBLength, foldShadowBVariability,
-                                masterScale,
-                                crackStrength, foldShadowAStr, foldShadowBStr);
-                            
-                            crackStrength *= foldAmount;
-                            if (crackStrength > 0) {
-                                double effectiveCrack = clamp01(crackStrength * 1.5);
-                                finalR = finalR * (1.0 - effectiveCrack) + backingR * effectiveCrack;
-                                finalG = finalG * (1.0 - effectiveCrack) + backingG * effectiveCrack;
-                                finalB = finalB * (1.0 - effectiveCrack) + backingB * effectiveCrack;
-                            }
-                            
-                            foldShadowAStr *= foldAmount;
-                            if (foldShadowAStr > 0) {
-                                double shAR = foldShadowAColor.red / 255.0;
-                                double shAG = foldShadowAColor.green / 255.0;
-                                double shAB = foldShadowAColor.blue / 255.0;
-                                double effectiveShadowA = clamp01(foldShadowAStr);
-                                finalR = finalR * (1.0 - effectiveShadowA) + shAR * effectiveShadowA;
-                                finalG = finalG * (1.0 - effectiveShadowA) + shAG * effectiveShadowA;
-                                finalB = finalB * (1.0 - effectiveShadowA) + shAB * effectiveShadowA;
-                            }
-                            
-                            foldShadowBStr *= foldAmount;
-                            if (foldShadowBStr > 0) {
-                                double shBR = foldShadowBColor.red / 255.0;
-                                double shBG = foldShadowBColor.green / 255.0;
-                                double shBB = foldShadowBColor.blue / 255.0;
-                                double effectiveShadowB = clamp01(foldShadowBStr);
-                                finalR = finalR * (1.0 - effectiveShadowB) + shBR * effectiveShadowB;
-                                finalG = finalG * (1.0 - effectiveShadowB) + shBG * effectiveShadowB;
-                                finalB = finalB * (1.0 - effectiveShadowB) + shBB * effectiveShadowB;
-                            }
-                        }
-                        
-                        // Apply grunge
-                        if (dirtAmount > 0) {
-                            double dirt = organicDirt(noisePx, noisePy, dirtSeed, dirtSize, dirtAmount, masterScale);
-                            double dirtStr = dirt * dirtOpacity;
-                            finalR = finalR * (1.0 - dirtStr) + dirtR * dirtStr;
-                            finalG = finalG * (1.0 - dirtStr) + dirtG * dirtStr;
-                            finalB = finalB * (1.0 - dirtStr) + dirtB * dirtStr;
-                        }
-                        
-                        if (smudgeAmount > 0) {
-                            double smudge = organicSmudge(noisePx, noisePy, smudgeSeed, smudgeSize, smudgeAmount, masterScale);
-                            double smudgeStr = smudge * smudgeOpacity;
-                            finalR = finalR * (1.0 - smudgeStr) + smudgeR * smudgeStr;
-                            finalG = finalG * (1.0 - smudgeStr) + smudgeG * smudgeStr;
-                            finalB = finalB * (1.0 - smudgeStr) + smudgeB * smudgeStr;
-                        }
-                        
-                        if (dustAmount > 0) {
-                            double dust = dustParticles(noisePx, noisePy, dustSeed, dustSize, dustAmount, masterScale);
-                            if (dust > 0) {
-                                finalR = finalR * (1.0 - dust) + dustR * dust;
-                                finalG = finalG * (1.0 - dust) + dustG * dust;
-                                finalB = finalB * (1.0 - dust) + dustB * dust;
-                            }
-                        }
-                        
-                        if (contentAlpha < 0.99) {
-                            finalR = finalR * contentAlpha + paperR * (1.0 - contentAlpha);
-                            finalG = finalG * contentAlpha + paperG * (1.0 - contentAlpha);
-                            finalB = finalB * contentAlpha + paperB * (1.0 - contentAlpha);
-                            finalA = finalA * contentAlpha + totalPaperAlpha * (1.0 - contentAlpha);
-                        }
-                    } else {
-                        finalR = paperR;
-                        finalG = paperG;
-                        finalB = paperB;
-                        finalA = totalPaperAlpha;
-                    }
-                    
-                    finalA = clamp01(finalA);
-                    finalR = clamp01(finalR);
-                    finalG = clamp01(finalG);
-                    finalB = clamp01(finalB);
-                    
-                    // Write output pixel based on format
-                    if (isFloat) {
-                        // 32-bit float (0.0 - 1.0 range, NOT premultiplied for straight alpha)
-                        PF_PixelFloat* outRow = (PF_PixelFloat*)((char*)output->data + y * output->rowbytes);
-                        outRow[x].alpha = (PF_FpShort)finalA;
-                        outRow[x].red   = (PF_FpShort)(finalR * finalA);
-                        outRow[x].green = (PF_FpShort)(finalG * finalA);
-                        outRow[x].blue  = (PF_FpShort)(finalB * finalA);
-                    } else if (is16bit) {
-                        // 16-bit (0 - 32768 range)
-                        PF_Pixel16* outRow = (PF_Pixel16*)((char*)output->data + y * output->rowbytes);
-                        outRow[x].alpha = (A_u_short)(finalA * 32768.0);
-                        outRow[x].red   = (A_u_short)(finalR * finalA * 32768.0);
-                        outRow[x].green = (A_u_short)(finalG * finalA * 32768.0);
-                        outRow[x].blue  = (A_u_short)(finalB * finalA * 32768.0);
-                    } else {
-                        // 8-bit (0 - 255 range)
-                        PF_Pixel8* outRow = (PF_Pixel8*)((char*)output->data + y * output->rowbytes);
-                        outRow[x].alpha = (A_u_char)(finalA * 255.0);
-                        outRow[x].red   = (A_u_char)(finalR * finalA * 255.0);
-                        outRow[x].green = (A_u_char)(finalG * finalA * 255.0);
-                        outRow[x].blue  = (A_u_char)(finalB * finalA * 255.0);
-                    }
-                }
-            }
+            A_long expand = fiberExpansion(params[PARAM_FIBER_LENGTH].u.fs_d.value,
+                params[PARAM_MASTER_SCALE].u.fs_d.value / 100.0);
+            ERR(renderFrame(in_data, out_data, paramPtrs, input, output, smartLayout(input, output, expand)));
         }
         
         // Check in all parameters
         PF_CHECKIN_PARAM(in_data, &params[PARAM_MASTER_SCALE]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_GAP_WIDTH]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_RANDOM_SEED]);
+        PF_CHECKIN_PARAM(in_data, &params[PARAM_BOIL]);
+        PF_CHECKIN_PARAM(in_data, &params[PARAM_BOIL_HOLD]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_EDGE_SOFTNESS]);
+        PF_CHECKIN_PARAM(in_data, &params[PARAM_ADAPTIVE_SHADING]);
+        PF_CHECKIN_PARAM(in_data, &params[PARAM_EDGE_ENGINE]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_OUTER_ROUGHNESS]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_OUTER_ROUGH_SCALE]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_OUTER_JAGGEDNESS]);
@@ -2711,6 +5475,10 @@ PF_Err SmartRender(
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_AMOUNT]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_POINT1]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_POINT2]);
+        PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_LAYOUT]);
+        for (int i = PARAM_FOLD2_AMOUNT; i <= PARAM_FOLD6_END; i++) {
+            PF_CHECKIN_PARAM(in_data, &params[i]);
+        }
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_LINE_ROUGHNESS]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_LINE_ROUGH_SCALE]);
         PF_CHECKIN_PARAM(in_data, &params[PARAM_FOLD_LINE_WIDTH]);
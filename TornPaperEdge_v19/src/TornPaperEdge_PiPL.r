@@ -27,10 +27,10 @@ resource 'PiPL' (16000) {
             0
         },
         AE_Effect_Global_OutFlags {
-            33555968
+            100664836
         },
         AE_Effect_Global_OutFlags_2 {
-            134222848
+            134222849
         },
         AE_Effect_Match_Name {
             "TORN_PAPER"
@@ -0,0 +1,524 @@
+/*
+    RenderDeterminismTest.cpp
+
+    Drives the plugin through EffectMain from a stub host and checks that a
+    pixel comes out the same whatever part of the output the host asks for
+    and however the work is spread over threads. Every scenario renders its
+    whole frame and then offset rects of it, at 8, 16 and 32 bits per
+    channel, with the host's iterate_generic and with the plugin's own
+    TilePool at one and at three threads, and every render is compared byte
+    for byte with the first whole frame.
+
+    The plugin is compiled into this file. CMake builds it a second time
+    with STRIP_MIN_PIXELS lowered so the same frames go through the strip
+    pipeline.
+*/
+
+#include "../src/TornPaperEdge.cpp"
+
+#include <cstdlib>
+#include <set>
+#include <string>
+
+namespace {
+
+// ============================================================
+// STUB HOST
+// ============================================================
+
+enum { GENERIC_THREADS = 4 };
+
+struct TestWorld {
+    std::vector<char> bytes;
+    PF_EffectWorld world;
+
+    TestWorld(int w, int h, int bytesPerPixel, int originX = 0, int originY = 0)
+        : bytes((size_t)safeMax(1, w * h) * bytesPerPixel)
+    {
+        memset(&world, 0, sizeof(world));
+        world.data = (PF_PixelPtr)bytes.data();
+        world.rowbytes = w * bytesPerPixel;
+        world.width = w;
+        world.height = h;
+        world.origin_x = originX;
+        world.origin_y = originY;
+        world.extent_hint.right = w;
+        world.extent_hint.bottom = h;
+        if (bytesPerPixel > 4) world.world_flags = PF_WorldFlag_DEEP;
+    }
+};
+
+struct StubHost {
+    PF_InData in_data;
+    PF_OutData out_data;
+    SPBasicSuite pica;
+    std::vector<PF_ParamDef> params;    // param 0 is the input layer
+    PF_EffectWorld* input;
+    PF_EffectWorld* output;
+    PF_PixelFormat format;
+    bool iterateGeneric;
+    PF_Iterate8Suite2 iterateSuite;
+    PF_WorldSuite2 worldSuite;
+    PF_ParamUtilsSuite3 paramUtilsSuite;
+};
+
+StubHost host;
+
+PF_Err addParam(PF_ProgPtr, PF_ParamIndex, PF_ParamDef* def) {
+    host.params.push_back(*def);
+    return PF_Err_NONE;
+}
+
+PF_Err checkoutParam(PF_ProgPtr, PF_ParamIndex index, A_long, A_long, A_u_long, PF_ParamDef* def) {
+    if (index < 0 || index >= (PF_ParamIndex)host.params.size()) return PF_Err_INVALID_INDEX;
+    *def = host.params[index];
+    if (index == 0) def->u.ld = *host.input;
+    return PF_Err_NONE;
+}
+
+PF_Err checkinParam(PF_ProgPtr, PF_ParamDef*) { return PF_Err_NONE; }
+
+PF_Err updateParamUI(PF_ProgPtr, PF_ParamIndex index, const PF_ParamDef* def) {
+    if (index < 0 || index >= (PF_ParamIndex)host.params.size()) return PF_Err_INVALID_INDEX;
+    host.params[index].ui_flags = def->ui_flags;
+    return PF_Err_NONE;
+}
+PF_Err abortCheck(PF_ProgPtr) { return PF_Err_NONE; }
+PF_Err progress(PF_ProgPtr, A_long, A_long) { return PF_Err_NONE; }
+
+// Spreads the iterations over the threads as AE does, the calling thread
+// taking part as thread 0
+PF_Err iterateGeneric(A_long iterations, void* refcon, PF_Err (*fn)(void*, A_long, A_long, A_long)) {
+    std::atomic<A_long> next(0);
+    std::atomic<PF_Err> result(PF_Err_NONE);
+    auto work = [&](A_long thread) {
+        for (A_long i = next++; i < iterations; i = next++) {
+            PF_Err err = fn(refcon, thread, i, iterations);
+            if (err) result = err;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (A_long t = 1; t < GENERIC_THREADS; t++) threads.emplace_back(work, t);
+    work(0);
+    for (std::thread& t : threads) t.join();
+    return result.load();
+}
+
+PF_Err getPixelFormat(const PF_EffectWorld*, PF_PixelFormat* format) {
+    *format = host.format;
+    return PF_Err_NONE;
+}
+
+PF_Err checkoutLayer(PF_ProgPtr, PF_ParamIndex, A_long, const PF_RenderRequest*, A_long, A_long, A_u_long,
+    PF_CheckoutResult* result)
+{
+    memset(result, 0, sizeof(*result));
+    result->result_rect.right = host.input->width;
+    result->result_rect.bottom = host.input->height;
+    result->max_result_rect = result->result_rect;
+    return PF_Err_NONE;
+}
+
+PF_Err mixInGuid(PF_ProgPtr, A_u_long, const void*) { return PF_Err_NONE; }
+
+PF_Err checkoutLayerPixels(PF_ProgPtr, A_long, PF_EffectWorld** world) {
+    *world = host.input;
+    return PF_Err_NONE;
+}
+
+PF_Err checkinLayerPixels(PF_ProgPtr, A_long) { return PF_Err_NONE; }
+
+PF_Err checkoutOutput(PF_ProgPtr, PF_EffectWorld** world) {
+    *world = host.output;
+    return PF_Err_NONE;
+}
+
+} // namespace
+
+extern "C" void* stub_acquire_suite(const char* name) {
+    if (!strcmp(name, kPFWorldSuite)) return &host.worldSuite;
+    if (!strcmp(name, kPFIterate8Suite)) return host.iterateGeneric ? &host.iterateSuite : nullptr;
+    return nullptr;
+}
+
+AEGP_SuiteHandler::AEGP_SuiteHandler(SPBasicSuite*) {}
+
+PF_Iterate8Suite2* AEGP_SuiteHandler::Iterate8Suite2() {
+    if (!host.iterateGeneric) throw (A_Err)PF_Err_BAD_CALLBACK_PARAM;
+    return &host.iterateSuite;
+}
+
+PF_WorldSuite2* AEGP_SuiteHandler::WorldSuite2() { return &host.worldSuite; }
+PF_ParamUtilsSuite3* AEGP_SuiteHandler::ParamUtilsSuite3() { return &host.paramUtilsSuite; }
+
+namespace {
+
+void setupHost() {
+    memset(&host.in_data, 0, sizeof(host.in_data));
+    memset(&host.out_data, 0, sizeof(host.out_data));
+    host.in_data.inter.add_param = addParam;
+    host.in_data.inter.checkout_param = checkoutParam;
+    host.in_data.inter.checkin_param = checkinParam;
+    host.in_data.inter.abort = abortCheck;
+    host.in_data.inter.progress = progress;
+    host.in_data.time_step = 1;
+    host.in_data.time_scale = 24;
+    host.in_data.downsample_x.num = host.in_data.downsample_x.den = 1;
+    host.in_data.downsample_y.num = host.in_data.downsample_y.den = 1;
+    host.in_data.pica_basicP = &host.pica;
+    host.iterateGeneric = true;
+    host.iterateSuite.iterate = nullptr;
+    host.iterateSuite.iterate_generic = iterateGeneric;
+    host.worldSuite.PF_NewWorld = nullptr;
+    host.worldSuite.PF_DisposeWorld = nullptr;
+    host.worldSuite.PF_GetPixelFormat = getPixelFormat;
+    host.paramUtilsSuite.PF_UpdateParamUI = updateParamUI;
+
+    PF_ParamDef layer;
+    AEFX_CLR_STRUCT(layer);
+    host.params.push_back(layer);
+    EffectMain(PF_Cmd_GLOBAL_SETUP, &host.in_data, &host.out_data, nullptr, nullptr, nullptr);
+    EffectMain(PF_Cmd_PARAMS_SETUP, &host.in_data, &host.out_data, nullptr, nullptr, nullptr);
+
+    // A calibration would retune the threads under the test
+    Prefetcher::instance().stop();
+}
+
+void teardownHost() {
+    EffectMain(PF_Cmd_GLOBAL_SETDOWN, &host.in_data, &host.out_data, nullptr, nullptr, nullptr);
+}
+
+PF_Rect intersect(const PF_Rect& a, const PF_Rect& b) {
+    PF_Rect r;
+    r.left = safeMax(a.left, b.left);
+    r.top = safeMax(a.top, b.top);
+    r.right = safeMin(a.right, b.right);
+    r.bottom = safeMin(a.bottom, b.bottom);
+    return r;
+}
+
+PF_Err preRender(const PF_Rect& rect, int bytesPerPixel, PF_PreRenderInput& preInput, PF_PreRenderOutput& preOutput) {
+    AEFX_CLR_STRUCT(preInput);
+    preInput.output_request.rect = rect;
+    preInput.bitdepth = (short)(bytesPerPixel * 2);
+    AEFX_CLR_STRUCT(preOutput);
+    PF_PreRenderCallbacks preCallbacks = { checkoutLayer, mixInGuid };
+    PF_PreRenderExtra preExtra = { &preInput, &preOutput, &preCallbacks };
+    return EffectMain(PF_Cmd_SMART_PRE_RENDER, &host.in_data, &host.out_data, nullptr, nullptr, &preExtra);
+}
+
+void freePreRenderData(PF_PreRenderOutput& preOutput) {
+    if (preOutput.delete_pre_render_data_func && preOutput.pre_render_data) {
+        preOutput.delete_pre_render_data_func(preOutput.pre_render_data);
+    }
+}
+
+// The whole output the effect can produce for the current input
+PF_Rect frameRect(int bytesPerPixel) {
+    PF_Rect layer = { 0, 0, host.input->width, host.input->height };
+    PF_PreRenderInput preInput;
+    PF_PreRenderOutput preOutput;
+    preRender(layer, bytesPerPixel, preInput, preOutput);
+    freePreRenderData(preOutput);
+    return preOutput.result_rect;
+}
+
+// Smart-renders the part of the output inside rect, which the host clips to
+// the result rect, and returns the pixels it gets back, row after row
+std::vector<char> render(const PF_Rect& rect, int bytesPerPixel) {
+    PF_PreRenderInput preInput;
+    PF_PreRenderOutput preOutput;
+    PF_Err err = preRender(rect, bytesPerPixel, preInput, preOutput);
+
+    PF_Rect window = intersect(rect, preOutput.result_rect);
+    TestWorld output(window.right - window.left, window.bottom - window.top, bytesPerPixel, window.left, window.top);
+    host.output = &output.world;
+
+    PF_SmartRenderInput input;
+    AEFX_CLR_STRUCT(input);
+    input.output_request = preInput.output_request;
+    input.bitdepth = preInput.bitdepth;
+    input.pre_render_data = preOutput.pre_render_data;
+    PF_SmartRenderCallbacks callbacks = { checkoutLayerPixels, checkinLayerPixels, checkoutOutput };
+    PF_SmartRenderExtra extra = { &input, &callbacks };
+    ERR(EffectMain(PF_Cmd_SMART_RENDER, &host.in_data, &host.out_data, nullptr, nullptr, &extra));
+    freePreRenderData(preOutput);
+    host.output = nullptr;
+    if (err) {
+        printf("  render failed with error %d\n", (int)err);
+        return std::vector<char>();
+    }
+    return output.bytes;
+}
+
+// ============================================================
+// SCENARIOS
+// ============================================================
+
+// Premultiplied colour ramps under the given alpha, in the world's depth
+template<typename Alpha>
+void fillInput(TestWorld& layer, int bytesPerPixel, Alpha alphaAt) {
+    PF_EffectWorld& w = layer.world;
+    for (int y = 0; y < w.height; y++) {
+        for (int x = 0; x < w.width; x++) {
+            float a = alphaAt(x, y);
+            float r = (float)x / w.width * a;
+            float g = (float)y / w.height * a;
+            float b = (0.5f + 0.5f * std::sin(x * 0.05f + y * 0.03f)) * a;
+            if (bytesPerPixel == 4) {
+                PF_Pixel8& p = worldRow<PF_Pixel8>(&w, y)[x];
+                p.alpha = PixelTraits<PF_Pixel8>::fromUnit(a);
+                p.red = PixelTraits<PF_Pixel8>::fromUnit(r);
+                p.green = PixelTraits<PF_Pixel8>::fromUnit(g);
+                p.blue = PixelTraits<PF_Pixel8>::fromUnit(b);
+            } else if (bytesPerPixel == 8) {
+                PF_Pixel16& p = worldRow<PF_Pixel16>(&w, y)[x];
+                p.alpha = PixelTraits<PF_Pixel16>::fromUnit(a);
+                p.red = PixelTraits<PF_Pixel16>::fromUnit(r);
+                p.green = PixelTraits<PF_Pixel16>::fromUnit(g);
+                p.blue = PixelTraits<PF_Pixel16>::fromUnit(b);
+            } else {
+                PF_PixelFloat& p = worldRow<PF_PixelFloat>(&w, y)[x];
+                p.alpha = a;
+                p.red = r;
+                p.green = g;
+                p.blue = b;
+            }
+        }
+    }
+}
+
+// A photo-like layer: a solid rectangle with a row of small islands above it
+float denseAlpha(int x, int y, int w, int h) {
+    double dx = (x - w * 0.5) / (w * 0.32);
+    double dy = (y - h * 0.5) / (h * 0.30);
+    if (std::fabs(dx) < 1 && std::fabs(dy) < 1) return 1.0f;
+    bool island = (x / 23) % 3 == 0 && (y / 19) % 4 == 0 && x % 23 < 9 && y % 19 < 7 && y < h * 0.15;
+    return island ? 1.0f : 0.0f;
+}
+
+// A text-like layer: two rings with bars in a mostly empty frame, far enough
+// apart that the distance field is only built around them
+float sparseAlpha(int x, int y) {
+    float a = 0;
+    for (int i = 0; i < 2; i++) {
+        double cx = 150 + i * 650, cy = 150 + i * 300;
+        double d = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+        double ring = clamp01(1.5 * (1.0 - std::fabs(d - 24) / 6.0));
+        double bar = (std::fabs(x - cx - 30) < 4 && std::fabs(y - cy) < 30) ? 1.0 : 0.0;
+        a = safeMax(a, (float)safeMax(ring, bar));
+    }
+    return a;
+}
+
+void setFloat(int param, double value) { host.params[param].u.fs_d.value = value; }
+void setPopup(int param, int value) { host.params[param].u.pd.value = value; }
+void setCheckbox(int param, bool value) { host.params[param].u.bd.value = value ? TRUE : FALSE; }
+
+void setPoint(int param, double x, double y) {
+    host.params[param].u.td.x_value = (PF_Fixed)(x * 65536);
+    host.params[param].u.td.y_value = (PF_Fixed)(y * 65536);
+}
+
+struct Scenario {
+    const char* name;
+    int width, height;
+    bool sparse;
+    void (*setParams)(int width, int height);
+};
+
+void defaultParams(int, int) {}
+
+void vectorParams(int, int) {
+    setPopup(PARAM_EDGE_ENGINE, EDGE_ENGINE_VECTOR);
+}
+
+// Three folds along a polyline with cracks, grunge and adaptive shading
+void foldParams(int w, int h) {
+    setCheckbox(PARAM_ADAPTIVE_SHADING, true);
+    setFloat(PARAM_FOLD_AMOUNT, 80);
+    setPoint(PARAM_FOLD_POINT1, w * 0.3, h * 0.2);
+    setPoint(PARAM_FOLD_POINT2, w * 0.7, h * 0.85);
+    setFloat(PARAM_FOLD2_AMOUNT, 70);
+    setPoint(PARAM_FOLD2_START, w * 0.1, h * 0.6);
+    setPoint(PARAM_FOLD2_END, w * 0.9, h * 0.5);
+    setFloat(PARAM_FOLD3_AMOUNT, 60);
+    setPoint(PARAM_FOLD3_END, w * 0.2, h * 0.9);
+    setPopup(PARAM_FOLD_LAYOUT, FOLD_LAYOUT_POLYLINE);
+    setFloat(PARAM_FOLD_CRACK_DENSITY, 40);
+    setFloat(PARAM_FOLD_SIDE_A_ROUGHNESS, 40);
+    setFloat(PARAM_DIRT_AMOUNT, 60);
+    setFloat(PARAM_SMUDGE_AMOUNT, 60);
+    setFloat(PARAM_DUST_AMOUNT, 70);
+    setFloat(PARAM_FIBER_BLUR, 3);
+}
+
+const Scenario scenarios[] = {
+    { "dense", 320, 240, false, defaultParams },
+    { "sparse", 1024, 640, true, defaultParams },
+    { "vector", 320, 240, false, vectorParams },
+    { "folds", 320, 240, false, foldParams },
+};
+
+struct Threading {
+    const char* name;
+    bool iterateGeneric;
+    int poolThreads;
+    int bandRows;
+    int poolTileSpan;
+};
+
+const Threading threadings[] = {
+    { "iterate_generic", true, 1, 16, 1 },
+    { "pool x1", false, 1, 32, 1 },
+    { "pool x3", false, 3, 8, 2 },
+};
+
+void applyThreading(const Threading& threading) {
+    host.iterateGeneric = threading.iterateGeneric;
+    RenderTuning tuning = defaultTuning();
+    tuning.bandRows = threading.bandRows;
+    tuning.poolTileSpan = threading.poolTileSpan;
+    tuning.poolThreads = threading.poolThreads;
+    RenderTuner::instance().set(tuning);
+    TilePool::instance().start(threading.poolThreads);
+
+    // Each threading builds its own fields
+    FieldCache::instance().clear();
+}
+
+// Rects of the frame off the tile grid, along its edges and a single row
+std::vector<PF_Rect> subRects(const PF_Rect& frame) {
+    int w = frame.right - frame.left, h = frame.bottom - frame.top;
+    PF_Rect rects[] = {
+        { 13, 7, 13 + w / 2, 7 + h / 3 },
+        { w / 3, h / 2, w - 5, h },
+        { w - 70, 0, w, 50 },
+        { 0, h / 2 + 1, w, h / 2 + 2 },
+    };
+    std::vector<PF_Rect> result;
+    for (PF_Rect r : rects) {
+        r.left += frame.left;
+        r.right += frame.left;
+        r.top += frame.top;
+        r.bottom += frame.top;
+        result.push_back(r);
+    }
+    return result;
+}
+
+// Number of pixels in rect that differ from the same pixels of the frame
+int differingPixels(const std::vector<char>& frameBytes, const PF_Rect& frame, const std::vector<char>& bytes,
+    const PF_Rect& rect, int bytesPerPixel)
+{
+    int w = rect.right - rect.left, h = rect.bottom - rect.top;
+    int frameW = frame.right - frame.left;
+    if (bytes.size() != (size_t)w * h * bytesPerPixel) return w * h;
+    int differing = 0;
+    for (int y = 0; y < h; y++) {
+        const char* expected = frameBytes.data() +
+            ((size_t)(rect.top - frame.top + y) * frameW + (rect.left - frame.left)) * bytesPerPixel;
+        const char* actual = bytes.data() + (size_t)y * w * bytesPerPixel;
+        for (int x = 0; x < w; x++) {
+            if (memcmp(expected + x * bytesPerPixel, actual + x * bytesPerPixel, bytesPerPixel)) differing++;
+        }
+    }
+    return differing;
+}
+
+// Projects save values under the disk IDs, so two params sharing one would
+// load each other's keyframes
+int duplicateDiskIds() {
+    std::set<A_long> ids;
+    int duplicates = 0;
+    for (size_t i = 1; i < host.params.size(); i++) {
+        if (!ids.insert(host.params[i].uu.id).second) {
+            printf("FAIL param %d reuses disk ID %d\n", (int)i, (int)host.params[i].uu.id);
+            duplicates++;
+        }
+    }
+    return duplicates;
+}
+
+// Vector Polygons disables the fiber params and Edge Softness, and Distance
+// Field enables them again
+int vectorParamsUI() {
+    const PF_ParamIndex watched[] = { PARAM_EDGE_SOFTNESS, PARAM_FIBER_DENSITY, PARAM_FIBER_BLUR };
+    const A_long engines[] = { EDGE_ENGINE_VECTOR, EDGE_ENGINE_DISTANCE };
+    int failures = 0;
+    for (A_long engine : engines) {
+        host.params[PARAM_EDGE_ENGINE].u.pd.value = engine;
+        std::vector<PF_ParamDef*> params;
+        for (PF_ParamDef& def : host.params) params.push_back(&def);
+        EffectMain(PF_Cmd_UPDATE_PARAMS_UI, &host.in_data, &host.out_data, params.data(), nullptr, nullptr);
+        for (PF_ParamIndex index : watched) {
+            bool disabled = (host.params[index].ui_flags & PF_PUI_DISABLED) != 0;
+            if (disabled != (engine == EDGE_ENGINE_VECTOR)) {
+                printf("FAIL param %d is %s with edge engine %d\n", (int)index,
+                    disabled ? "disabled" : "enabled", (int)engine);
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+int main() {
+    setupHost();
+    const std::vector<PF_ParamDef> defaults = host.params;
+    const int depths[] = { 4, 8, 16 };
+    int failures = duplicateDiskIds() + vectorParamsUI();
+    int renders = 0;
+
+    for (const Scenario& scenario : scenarios) {
+        host.params = defaults;
+        scenario.setParams(scenario.width, scenario.height);
+
+        for (int bytesPerPixel : depths) {
+            host.format = bytesPerPixel == 4 ? PF_PixelFormat_ARGB32 :
+                bytesPerPixel == 8 ? PF_PixelFormat_ARGB64 : PF_PixelFormat_ARGB128;
+            TestWorld input(scenario.width, scenario.height, bytesPerPixel);
+            fillInput(input, bytesPerPixel, [&](int x, int y) {
+                return scenario.sparse ? sparseAlpha(x, y) : denseAlpha(x, y, scenario.width, scenario.height);
+            });
+            host.input = &input.world;
+            host.in_data.width = scenario.width;
+            host.in_data.height = scenario.height;
+
+            // The whole frame first, then the layer's own rect and offset rects
+            const PF_Rect frame = frameRect(bytesPerPixel);
+            std::vector<PF_Rect> rects(1, frame);
+            rects.push_back(PF_Rect{ 0, 0, scenario.width, scenario.height });
+            for (const PF_Rect& r : subRects(frame)) rects.push_back(r);
+            std::vector<char> reference;
+
+            for (const Threading& threading : threadings) {
+                applyThreading(threading);
+                for (size_t i = reference.empty() ? 0 : 1; i < rects.size(); i++) {
+                    std::vector<char> bytes = render(rects[i], bytesPerPixel);
+                    renders++;
+                    if (reference.empty()) {
+                        reference = bytes;
+                        continue;
+                    }
+                    PF_Rect window = intersect(rects[i], frame);
+                    int differing = differingPixels(reference, frame, bytes, window, bytesPerPixel);
+                    if (differing) {
+                        printf("FAIL %s %d bpc %s: rect (%d, %d)-(%d, %d) differs in %d pixels\n", scenario.name,
+                            bytesPerPixel * 2, threading.name, (int)window.left, (int)window.top,
+                            (int)window.right, (int)window.bottom, differing);
+                        failures++;
+                    }
+                }
+            }
+            host.input = nullptr;
+        }
+        printf("%s done\n", scenario.name);
+    }
+
+    teardownHost();
+    printf("%d renders, %d mismatches\n", renders, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
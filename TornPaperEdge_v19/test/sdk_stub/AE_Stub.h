@@ -0,0 +1,424 @@
+/*
+    AE_Stub.h
+
+    The parts of the After Effects SDK the plugin uses, declared just far
+    enough to build it without the SDK and drive it from a test host. Types
+    keep the SDK's names and fields; suites are handed out by the host through
+    stub_acquire_suite(). Nothing here is meant to match the SDK's layout.
+*/
+
+#pragma once
+
+#ifndef AE_STUB_H
+#define AE_STUB_H
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+typedef int32_t A_long;
+typedef uint32_t A_u_long;
+typedef unsigned char A_u_char;
+typedef unsigned short A_u_short;
+typedef short A_short;
+typedef int32_t A_Err;
+typedef char A_char;
+typedef unsigned char A_Boolean;
+typedef int64_t A_intptr_t;
+typedef uint64_t A_u_longlong;
+
+typedef int32_t PF_Err;
+typedef int32_t PF_Cmd;
+typedef double PF_FpLong;
+typedef float PF_FpShort;
+typedef int32_t PF_Fixed;
+typedef int32_t PF_ParamIndex;
+typedef int32_t PF_ParamValue;
+typedef void* PF_ProgPtr;
+typedef void* PF_Handle;
+
+#define TRUE 1
+#define FALSE 0
+#define DllExport extern
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+enum {
+    PF_Err_NONE = 0,
+    PF_Err_OUT_OF_MEMORY = 4,
+    PF_Err_INTERNAL_STRUCT_DAMAGED = 512,
+    PF_Err_INVALID_INDEX,
+    PF_Err_UNRECOGNIZED_PARAM_TYPE,
+    PF_Err_INVALID_CALLBACK,
+    PF_Err_BAD_CALLBACK_PARAM,
+    PF_Interrupt_CANCEL,
+    PF_Err_CANNOT_PARSE_KEYFRAME_TEXT
+};
+
+enum {
+    PF_Cmd_ABOUT = 0, PF_Cmd_GLOBAL_SETUP, PF_Cmd_UNUSED_0, PF_Cmd_GLOBAL_SETDOWN, PF_Cmd_PARAMS_SETUP,
+    PF_Cmd_SEQUENCE_SETUP, PF_Cmd_SEQUENCE_RESETUP, PF_Cmd_SEQUENCE_FLATTEN, PF_Cmd_SEQUENCE_SETDOWN,
+    PF_Cmd_DO_DIALOG, PF_Cmd_FRAME_SETUP, PF_Cmd_RENDER, PF_Cmd_FRAME_SETDOWN, PF_Cmd_USER_CHANGED_PARAM,
+    PF_Cmd_UPDATE_PARAMS_UI, PF_Cmd_EVENT, PF_Cmd_GET_EXTERNAL_DEPENDENCIES, PF_Cmd_COMPLETELY_GENERAL,
+    PF_Cmd_QUERY_DYNAMIC_FLAGS, PF_Cmd_AUDIO_RENDER, PF_Cmd_AUDIO_SETUP, PF_Cmd_AUDIO_SETDOWN,
+    PF_Cmd_ARBITRARY_CALLBACK, PF_Cmd_SMART_PRE_RENDER, PF_Cmd_SMART_RENDER, PF_Cmd_RESERVED1,
+    PF_Cmd_RESERVED2, PF_Cmd_RESERVED3, PF_Cmd_GET_FLATTENED_SEQUENCE_DATA, PF_Cmd_TRANSLATE_PARAMS_TO_PREFS,
+    PF_Cmd_RESERVED4, PF_Cmd_SMART_RENDER_GPU, PF_Cmd_GPU_DEVICE_SETUP, PF_Cmd_GPU_DEVICE_SETDOWN
+};
+
+enum { PF_Stage_DEVELOP = 0 };
+#define PF_VERSION(a, b, c, d, e) (((a) << 19) | ((b) << 15) | ((c) << 11) | ((d) << 9) | (e))
+
+// ------------------------------------------------------------
+// Pixels and worlds
+// ------------------------------------------------------------
+
+struct PF_Pixel { A_u_char alpha, red, green, blue; };
+typedef PF_Pixel PF_Pixel8;
+typedef PF_Pixel PF_UnionablePixel;
+struct PF_Pixel16 { A_u_short alpha, red, green, blue; };
+struct PF_PixelFloat { PF_FpShort alpha, red, green, blue; };
+typedef PF_PixelFloat PF_Pixel32;
+typedef PF_Pixel* PF_PixelPtr;
+
+struct PF_Rect { A_long left, top, right, bottom; };
+typedef PF_Rect PF_LRect;
+typedef PF_Rect PF_UnionableRect;
+struct PF_RationalScale { A_long num; A_u_long den; };
+
+enum { PF_WorldFlag_DEEP = 1, PF_WorldFlag_WRITEABLE = 2 };
+
+struct PF_EffectWorld {
+    A_long reserved0;
+    A_long reserved1;
+    A_long world_flags;
+    PF_PixelPtr data;
+    A_long rowbytes;
+    A_long width;
+    A_long height;
+    PF_UnionableRect extent_hint;
+    void* platform_ref;
+    A_long reserved_long1;
+    void* reserved_long4;
+    PF_RationalScale pix_aspect_ratio;
+    void* reserved_long2;
+    A_long origin_x;
+    A_long origin_y;
+    A_long reserved_long3;
+    A_long dephault;
+};
+typedef PF_EffectWorld PF_LayerDef;
+#define PF_WORLD_IS_DEEP(W) (((W)->world_flags & PF_WorldFlag_DEEP) != 0)
+
+typedef A_long PF_PixelFormat;
+enum {
+    PF_PixelFormat_ARGB32 = 0x61726762,
+    PF_PixelFormat_ARGB64 = 0x61726763,
+    PF_PixelFormat_ARGB128 = 0x61726764,
+    PF_PixelFormat_INVALID = 0x3f3f3f3f
+};
+
+// ------------------------------------------------------------
+// Params
+// ------------------------------------------------------------
+
+struct PF_SliderDef {
+    PF_ParamValue value;
+    char value_str[32];
+    char value_desc[32];
+    PF_ParamValue valid_min, valid_max, slider_min, slider_max, dephault;
+};
+struct PF_FloatSliderDef {
+    PF_FpLong value;
+    PF_FpLong phase;
+    char value_desc[32];
+    PF_FpShort valid_min, valid_max, slider_min, slider_max, dephault;
+    short precision;
+    short display_flags;
+    A_long fs_flags;
+    PF_FpShort curve_tolerance;
+};
+struct PF_ColorDef { PF_Pixel value; PF_Pixel dephault; };
+struct PF_PointDef {
+    PF_Fixed x_value, y_value;
+    char reserved[3];
+    A_Boolean restrict_bounds;
+    PF_Fixed x_dephault, y_dephault;
+};
+struct PF_CheckBoxDef {
+    PF_ParamValue value;
+    A_Boolean dephault;
+    char reserved;
+    short reserved1;
+    const char* u_nameptr;
+};
+struct PF_PopupDef { PF_ParamValue value; short num_choices; short dephault; const char* u_namesptr; };
+struct PF_AngleDef { PF_Fixed value; PF_Fixed dephault; PF_Fixed valid_min, valid_max; };
+
+union PF_ParamDefUnion {
+    PF_LayerDef ld;
+    PF_SliderDef sd;
+    PF_FloatSliderDef fs_d;
+    PF_ColorDef cd;
+    PF_PointDef td;
+    PF_CheckBoxDef bd;
+    PF_PopupDef pd;
+    PF_AngleDef ad;
+};
+
+enum {
+    PF_Param_LAYER = 0, PF_Param_SLIDER, PF_Param_FIX_SLIDER, PF_Param_ANGLE, PF_Param_CHECKBOX,
+    PF_Param_COLOR, PF_Param_POINT, PF_Param_POPUP, PF_Param_FLOAT_SLIDER = 10,
+    PF_Param_GROUP_START = 13, PF_Param_GROUP_END
+};
+enum { PF_PUI_DISABLED = 1 << 5 };
+enum { PF_ParamFlag_CANNOT_TIME_VARY = 1 << 1, PF_ParamFlag_SUPERVISE = 1 << 3, PF_ParamFlag_START_COLLAPSED = 1 << 5 };
+enum { PF_Precision_INTEGER = 0, PF_Precision_TENTHS, PF_Precision_HUNDREDTHS, PF_Precision_THOUSANDTHS };
+
+struct PF_ParamDef {
+    union { A_long id; A_long change_flags; } uu;
+    A_long ui_flags;
+    short ui_width, ui_height;
+    A_long param_type;
+    char name[32];
+    A_long flags;
+    A_long unused;
+    PF_ParamDefUnion u;
+};
+typedef PF_ParamDef* PF_ParamList[];
+
+// ------------------------------------------------------------
+// Command data
+// ------------------------------------------------------------
+
+struct SPBasicSuite { int dummy; };
+
+struct PF_InteractCallbacks {
+    PF_Err (*checkout_param)(PF_ProgPtr, PF_ParamIndex, A_long, A_long, A_u_long, PF_ParamDef*);
+    PF_Err (*checkin_param)(PF_ProgPtr, PF_ParamDef*);
+    PF_Err (*add_param)(PF_ProgPtr, PF_ParamIndex, PF_ParamDef*);
+    PF_Err (*abort)(PF_ProgPtr);
+    PF_Err (*progress)(PF_ProgPtr, A_long, A_long);
+};
+
+struct PF_InData {
+    PF_InteractCallbacks inter;
+    void* utils;
+    PF_ProgPtr effect_ref;
+    A_long quality;
+    A_long version;
+    A_long serial_num;
+    A_long appl_id;
+    A_long num_params;
+    A_long reserved;
+    A_long what_cpu, what_fpu;
+    A_long current_time, time_step, total_time, local_time_step;
+    A_u_long time_scale;
+    A_long field;
+    PF_Fixed shutter_angle;
+    A_long width, height;
+    PF_Rect extent_hint;
+    A_long output_origin_x, output_origin_y;
+    PF_RationalScale downsample_x, downsample_y, pixel_aspect_ratio;
+    A_long in_flags;
+    PF_Handle global_data, sequence_data, frame_data;
+    A_long start_sampL, dur_sampL, total_sampL;
+    SPBasicSuite* pica_basicP;
+    A_long pre_effect_source_origin_x, pre_effect_source_origin_y;
+    PF_Fixed shutter_phase;
+};
+
+struct PF_OutData {
+    A_u_long my_version;
+    A_long name[8];
+    PF_Handle global_data, sequence_data, frame_data;
+    A_long width, height;
+    void* dummy_;
+    A_long out_flags;
+    char return_msg[256];
+    A_long start_sampL, dur_sampL;
+    A_long dest_snd;
+    A_long out_flags2;
+    A_long num_params;
+};
+
+// ------------------------------------------------------------
+// Smart render
+// ------------------------------------------------------------
+
+struct PF_RenderRequest {
+    PF_LRect rect;
+    A_long field;
+    A_long channel_mask;
+    A_Boolean preserve_rgb_of_zero_alpha;
+    char unused[3];
+    A_long reserved[4];
+};
+struct PF_CheckoutResult {
+    PF_LRect result_rect, max_result_rect;
+    PF_RationalScale par;
+    A_long solid, reservedB[3];
+    A_long ref_width, ref_height;
+    A_long emit_time;
+};
+
+struct PF_PreRenderInput {
+    PF_RenderRequest output_request;
+    short bitdepth;
+    const void* gpu_data;
+    A_long what_gpu;
+    A_u_long device_index;
+};
+typedef void (*PF_DeletePreRenderDataFunc)(void*);
+struct PF_PreRenderOutput {
+    PF_LRect result_rect, max_result_rect;
+    A_Boolean solid, reserved;
+    A_long flags;
+    void* pre_render_data;
+    PF_DeletePreRenderDataFunc delete_pre_render_data_func;
+};
+struct PF_PreRenderCallbacks {
+    PF_Err (*checkout_layer)(PF_ProgPtr, PF_ParamIndex, A_long, const PF_RenderRequest*, A_long, A_long,
+        A_u_long, PF_CheckoutResult*);
+    PF_Err (*GuidMixInPtr)(PF_ProgPtr, A_u_long, const void*);
+};
+struct PF_PreRenderExtra { PF_PreRenderInput* input; PF_PreRenderOutput* output; PF_PreRenderCallbacks* cb; };
+
+struct PF_SmartRenderInput {
+    PF_RenderRequest output_request;
+    short bitdepth;
+    void* pre_render_data;
+    const void* gpu_data;
+    A_long what_gpu;
+    A_u_long device_index;
+};
+struct PF_SmartRenderCallbacks {
+    PF_Err (*checkout_layer_pixels)(PF_ProgPtr, A_long, PF_EffectWorld**);
+    PF_Err (*checkin_layer_pixels)(PF_ProgPtr, A_long);
+    PF_Err (*checkout_output)(PF_ProgPtr, PF_EffectWorld**);
+};
+struct PF_SmartRenderExtra { PF_SmartRenderInput* input; PF_SmartRenderCallbacks* cb; };
+
+enum { PF_RenderOutputFlag_RETURNS_EXTRA_PIXELS = 1, PF_RenderOutputFlag_GPU_RENDER_POSSIBLE = 2 };
+
+enum {
+    PF_OutFlag_NONE = 0, PF_OutFlag_KEEP_RESOURCE_OPEN = 1 << 0, PF_OutFlag_WIDE_TIME_INPUT = 1 << 1,
+    PF_OutFlag_NON_PARAM_VARY = 1 << 2, PF_OutFlag_SEQUENCE_DATA_NEEDS_FLATTENING = 1 << 4,
+    PF_OutFlag_I_DO_DIALOG = 1 << 5, PF_OutFlag_USE_OUTPUT_EXTENT = 1 << 6, PF_OutFlag_SEND_DO_DIALOG = 1 << 7,
+    PF_OutFlag_DISPLAY_ERROR_MESSAGE = 1 << 8, PF_OutFlag_I_EXPAND_BUFFER = 1 << 9,
+    PF_OutFlag_PIX_INDEPENDENT = 1 << 10, PF_OutFlag_I_WRITE_INPUT_BUFFER = 1 << 11,
+    PF_OutFlag_I_SHRINK_BUFFER = 1 << 12, PF_OutFlag_WORKS_IN_PLACE = 1 << 13, PF_OutFlag_CUSTOM_UI = 1 << 15,
+    PF_OutFlag_REFRESH_UI = 1 << 17, PF_OutFlag_NOP_RENDER = 1 << 18, PF_OutFlag_I_USE_SHUTTER_ANGLE = 1 << 19,
+    PF_OutFlag_I_USE_AUDIO = 1 << 20, PF_OutFlag_I_AM_OBSOLETE = 1 << 21, PF_OutFlag_FORCE_RERENDER = 1 << 22,
+    PF_OutFlag_PiPL_OVERRIDES_OUTDATA_OUTFLAGS = 1 << 23, PF_OutFlag_I_HAVE_EXTERNAL_DEPENDENCIES = 1 << 24,
+    PF_OutFlag_DEEP_COLOR_AWARE = 1 << 25, PF_OutFlag_SEND_UPDATE_PARAMS_UI = 1 << 26
+};
+enum {
+    PF_OutFlag2_NONE = 0, PF_OutFlag2_SUPPORTS_QUERY_DYNAMIC_FLAGS = 1 << 0, PF_OutFlag2_I_USE_3D_CAMERA = 1 << 1,
+    PF_OutFlag2_PARAM_GROUP_START_COLLAPSED_FLAG = 1 << 3, PF_OutFlag2_SUPPORTS_SMART_RENDER = 1 << 10,
+    PF_OutFlag2_FLOAT_COLOR_AWARE = 1 << 12, PF_OutFlag2_I_USE_TIMECODE = 1 << 16,
+    PF_OutFlag2_AUTOMATIC_WIDE_TIME_INPUT = 1 << 20, PF_OutFlag2_SUPPORTS_THREADED_RENDERING = 1 << 27
+};
+
+// ------------------------------------------------------------
+// Suites
+// ------------------------------------------------------------
+
+struct PF_WorldSuite2 {
+    PF_Err (*PF_NewWorld)(PF_ProgPtr, A_long, A_long, A_Boolean, PF_PixelFormat, PF_EffectWorld*);
+    PF_Err (*PF_DisposeWorld)(PF_ProgPtr, PF_EffectWorld*);
+    PF_Err (*PF_GetPixelFormat)(const PF_EffectWorld*, PF_PixelFormat*);
+};
+#define kPFWorldSuite "PF World Suite"
+#define kPFWorldSuiteVersion2 2
+
+struct PF_ParamUtilsSuite3 {
+    PF_Err (*PF_UpdateParamUI)(PF_ProgPtr, PF_ParamIndex, const PF_ParamDef*);
+};
+
+typedef PF_Err (*PF_IteratePixel8Func)(void*, A_long, A_long, PF_Pixel8*, PF_Pixel8*);
+struct PF_Iterate8Suite2 {
+    PF_Err (*iterate)(PF_InData*, A_long, A_long, PF_EffectWorld*, const PF_Rect*, void*, PF_IteratePixel8Func,
+        PF_EffectWorld*);
+    PF_Err (*iterate_generic)(A_long, void*, PF_Err (*)(void*, A_long, A_long, A_long));
+};
+#define kPFIterate8Suite "PF Iterate8 Suite"
+#define kPFIterate8SuiteVersion2 2
+struct PF_Iterate16Suite2 { int dummy; };
+struct PF_IterateFloatSuite2 { int dummy; };
+
+// Defined by the test host
+extern "C" void* stub_acquire_suite(const char* name);
+
+struct AEGP_SuiteHandler {
+    explicit AEGP_SuiteHandler(SPBasicSuite* pica);
+    PF_Iterate8Suite2* Iterate8Suite2();    // throws when the host has no iterate suite
+    PF_WorldSuite2* WorldSuite2();
+    PF_ParamUtilsSuite3* ParamUtilsSuite3();
+};
+
+template<typename S>
+struct AEFX_SuiteScoper {
+    S* s;
+    AEFX_SuiteScoper(const PF_InData*, const char* name, int, PF_OutData* = nullptr, const char* = nullptr) {
+        s = (S*)stub_acquire_suite(name);
+        if (!s) throw (PF_Err)PF_Err_BAD_CALLBACK_PARAM;
+    }
+    const S* operator->() const { return s; }
+    S* get() const { return s; }
+};
+
+// ------------------------------------------------------------
+// Macros
+// ------------------------------------------------------------
+
+#define ERR(FUNC) do { if (!err) { err = (FUNC); } } while (0)
+#define AEFX_CLR_STRUCT(S) memset(&(S), 0, sizeof(S))
+#define PF_SPRINTF sprintf
+
+#define PF_ABORT(IN_DATA) (*(IN_DATA)->inter.abort)((IN_DATA)->effect_ref)
+#define PF_PROGRESS(IN_DATA, CURR, TOTAL) (*(IN_DATA)->inter.progress)((IN_DATA)->effect_ref, (CURR), (TOTAL))
+#define PF_CHECKOUT_PARAM(IN_DATA, PARAM, TIME, STEP, SCALE, PARAM_DEF) \
+    (*(IN_DATA)->inter.checkout_param)((IN_DATA)->effect_ref, (PARAM), (TIME), (STEP), (SCALE), (PARAM_DEF))
+#define PF_CHECKIN_PARAM(IN_DATA, PARAM_DEF) (*(IN_DATA)->inter.checkin_param)((IN_DATA)->effect_ref, (PARAM_DEF))
+#define PF_ADD_PARAM(IN_DATA, INDEX, DEF) (*(IN_DATA)->inter.add_param)((IN_DATA)->effect_ref, (INDEX), (DEF))
+
+#define PF_ADD_TOPIC(NAME, ID) do { \
+    def.param_type = PF_Param_GROUP_START; strncpy(def.name, NAME, 31); def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_END_TOPIC(ID) do { \
+    def.param_type = PF_Param_GROUP_END; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_FLOAT_SLIDERX(NAME, VMIN, VMAX, SMIN, SMAX, DFLT, PREC, DISP, FLAGS, ID) do { \
+    def.param_type = PF_Param_FLOAT_SLIDER; strncpy(def.name, NAME, 31); \
+    def.u.fs_d.valid_min = VMIN; def.u.fs_d.valid_max = VMAX; \
+    def.u.fs_d.slider_min = SMIN; def.u.fs_d.slider_max = SMAX; \
+    def.u.fs_d.value = def.u.fs_d.dephault = DFLT; def.u.fs_d.precision = PREC; \
+    def.u.fs_d.display_flags = DISP; def.flags |= FLAGS; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_SLIDER(NAME, VMIN, VMAX, SMIN, SMAX, DFLT, ID) do { \
+    def.param_type = PF_Param_SLIDER; strncpy(def.name, NAME, 31); \
+    def.u.sd.valid_min = VMIN; def.u.sd.valid_max = VMAX; def.u.sd.slider_min = SMIN; def.u.sd.slider_max = SMAX; \
+    def.u.sd.value = def.u.sd.dephault = DFLT; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_COLOR(NAME, R, G, B, ID) do { \
+    def.param_type = PF_Param_COLOR; strncpy(def.name, NAME, 31); \
+    def.u.cd.value.red = R; def.u.cd.value.green = G; def.u.cd.value.blue = B; def.u.cd.value.alpha = 255; \
+    def.u.cd.dephault = def.u.cd.value; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_POINT(NAME, X, Y, RESTRICT, ID) do { \
+    def.param_type = PF_Param_POINT; strncpy(def.name, NAME, 31); \
+    def.u.td.x_value = def.u.td.x_dephault = (X) << 16; def.u.td.y_value = def.u.td.y_dephault = (Y) << 16; \
+    def.u.td.restrict_bounds = RESTRICT; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_CHECKBOXX(NAME, DFLT, FLAGS, ID) do { \
+    def.param_type = PF_Param_CHECKBOX; strncpy(def.name, NAME, 31); \
+    def.u.bd.value = def.u.bd.dephault = DFLT; def.flags |= FLAGS; def.uu.id = ID; \
+    ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+#define PF_ADD_POPUP(NAME, CHOICES, DFLT, STRING, ID) do { \
+    def.param_type = PF_Param_POPUP; strncpy(def.name, NAME, 31); \
+    def.u.pd.num_choices = CHOICES; def.u.pd.value = def.u.pd.dephault = DFLT; def.u.pd.u_namesptr = STRING; \
+    def.uu.id = ID; ERR(PF_ADD_PARAM(in_data, -1, &def)); } while (0)
+
+#endif // AE_STUB_H
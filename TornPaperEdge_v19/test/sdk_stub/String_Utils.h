@@ -0,0 +1,2 @@
+// Stand-in for the After Effects SDK header of the same name
+#include "AE_Stub.h"